@@ -72,6 +72,8 @@ namespace JetProxyExample
 
     hbk::jet::SetStateCbResult JetObjectProxy::setFromJet(const Json::Value& request)
 	{
+        // Written by hand on purpose: Shows an object without type description that checks values and appends to a vector.
+        // See JetObjectProxyWithType for the same with a hbk::jetproxy::PropertyTable.
         Properties properties = m_properties;
         Json::Value::Members members = request.getMemberNames();
         for (const std::string& member : members)
@@ -27,6 +27,7 @@
 #include "json/value.h"
 
 #include "jetproxy/JsonSchema.hpp"
+#include "jetproxy/PropertyTable.hpp"
 #include "jetproxy/StringEnum.hpp"
 #include "JetObjectProxyWithSubObjectType.hpp"
 
@@ -54,19 +55,37 @@ namespace JetProxyExample
     {
     }
 
+    const hbk::jetproxy::PropertyTable < JetObjectProxyWithSubObjectType::Properties >& JetObjectProxyWithSubObjectType::propertyTable()
+    {
+        static const hbk::jetproxy::PropertyTable < Properties > table({
+            hbk::jetproxy::property < &Properties::boolProperty >(BOOL_PROPERTY, "A bool value."),
+            hbk::jetproxy::property < &Properties::intProperty >(INT_PROPERTY, "An int value."),
+            hbk::jetproxy::property < &Properties::floatProperty >(FLOAT_PROPERTY, "A float value."),
+            hbk::jetproxy::property < &Properties::floatArrayProperty >(FLOAT_ARRAY_PROPERTY, "A float array value.")
+        });
+        return table;
+    }
+
+    // the sub object has a state of its own, hence a table of its own
+    const hbk::jetproxy::PropertyTable < JetObjectProxyWithSubObjectType::SubObjectProperties >& JetObjectProxyWithSubObjectType::subObjectPropertyTable()
+    {
+        static const hbk::jetproxy::PropertyTable < SubObjectProperties > table({
+            hbk::jetproxy::property < &SubObjectProperties::boolProperty >(BOOL_PROPERTY, "A Bool Property"),
+            hbk::jetproxy::property < &SubObjectProperties::intProperty >(INT_PROPERTY, "Offset Factor")
+        });
+        return table;
+    }
+
     void JetObjectProxyWithSubObjectType::composeProperties(Json::Value& composition) const
     {
-        composition[BOOL_PROPERTY] = m_properties.boolProperty;
-        composition[INT_PROPERTY] = m_properties.intProperty;
-        composition[FLOAT_PROPERTY] = m_properties.floatProperty;
+        propertyTable().compose(m_properties, composition);
     }
 
 
     Json::Value JetObjectProxyWithSubObjectType::composeSubObjectProperties() const
     {
         Json::Value composition;
-        composition[BOOL_PROPERTY] = m_properties.subObject.boolProperty;
-        composition[INT_PROPERTY] = m_properties.subObject.intProperty;
+        subObjectPropertyTable().compose(m_properties.subObject, composition);
         return composition;
 
     }
@@ -74,53 +93,19 @@ namespace JetProxyExample
 
     hbk::jet::SetStateCbResult JetObjectProxyWithSubObjectType::setFromJet(const Json::Value& request)
     {
-        Properties properties = m_properties;
-        Json::Value::Members members = request.getMemberNames();
-        for (const std::string& member : members)
-        {
-            if (member == BOOL_PROPERTY)
-            {
-                properties.boolProperty = request[BOOL_PROPERTY].asBool();
-            }
-            else if (member == INT_PROPERTY)
-            {
-                properties.intProperty = request[INT_PROPERTY].asInt();
-            }
-            else if (member == FLOAT_PROPERTY)
-            {
-                properties.floatProperty = request[FLOAT_PROPERTY].asFloat();
-            }
-            else if (member == FLOAT_ARRAY_PROPERTY)
-            {
-                int i = 0;
-                for (const auto& val : request[FLOAT_ARRAY_PROPERTY])
-                {
-                    if (i < 32)
-                    {
-                        properties.floatArrayProperty[i] = val.asFloat();
-                        ++i;
-                    }
-                }
-            }
+        // only the requested properties are written
+        if (propertyTable().set(request, m_properties) > 0) {
+            notifyAll();
         }
-
-        setProperties(properties);
         // Return Value empty because everything is okay.
         return Json::Value();
     }
 
     Json::Value JetObjectProxyWithSubObjectType::setSubObjectFromJet(const Json::Value& request)
     {
-        Properties properties = m_properties;
-        Json::Value::Members members = request.getMemberNames();
-        for (const std::string& member : members) {
-            if (member ==BOOL_PROPERTY) {
-                properties.subObject.boolProperty = request[BOOL_PROPERTY].asBool();
-            } else if (member == INT_PROPERTY) {
-                properties.subObject.intProperty = request[INT_PROPERTY].asInt();
-            }
+        if (subObjectPropertyTable().set(request, m_properties.subObject) > 0) {
+            notifyAll();
         }
-        setProperties(properties);
         // Return Value empty because everything is okay.
         return Json::Value();
     }
@@ -132,23 +117,20 @@ namespace JetProxyExample
         // Notify changes to Jet
         notify();
         // Notify the the sub State as well...
-        m_jetPeer.notifyState(m_path + "/" + SUB_OBJECT, composeSubObjectProperties());
+        m_subObject->notify(composeSubObjectProperties());
     }
 
     // is needed for working with Types
     Json::Value JetObjectProxyWithSubObjectType::composePropertiesTypes()
     {
-        Json::Value type;
-
-        type[BOOL_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.boolProperty)>("A bool value.");
-        type[INT_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.intProperty)>("An int value.");
-        type[FLOAT_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.floatProperty)>("A float value.");
-        type[FLOAT_ARRAY_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonArrayType<float>("A float array value.", sizeof(m_properties.floatArrayProperty) / sizeof(float));
+        Json::Value type = propertyTable().composeTypes();
 
             // Struct Object creates per default an Object
         type[SUB_OBJECT] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.subObject)>("A Sub Object.");
-        type[SUB_OBJECT][BOOL_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.subObject.boolProperty)>("A Bool Property");
-        type[SUB_OBJECT][INT_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.subObject.intProperty)>("Offset Factor");
+        const Json::Value subObjectTypes = subObjectPropertyTable().composeTypes();
+        for (auto iter = subObjectTypes.begin(); iter != subObjectTypes.end(); ++iter) {
+            type[SUB_OBJECT][iter.name()] = *iter;
+        }
 
         return type;
     }
@@ -172,7 +154,7 @@ namespace JetProxyExample
 
     void JetObjectProxyWithSubObjectType::notifyAll()
     {
-        m_jetPeer.notifyState(m_path, compose());
-        m_jetPeer.notifyState(m_path + "/" + SUB_OBJECT, composeSubObjectProperties());
+        notify();
+        m_subObject->notify(composeSubObjectProperties());
     }
 } // namespace MsBridge
@@ -32,6 +32,7 @@
 
 #include "jetproxy/ProxyJetStates.hpp"
 #include "jetproxy/JetProxy.hpp"
+#include "jetproxy/PropertyTable.hpp"
 
 namespace JetProxyExample
 {
@@ -111,6 +112,9 @@ namespace JetProxyExample
 
 	private:
 
+		static const hbk::jetproxy::PropertyTable < Properties >& propertyTable();
+		static const hbk::jetproxy::PropertyTable < SubObjectProperties >& subObjectPropertyTable();
+
 		virtual void composeProperties(Json::Value& composition) const override;
 
 		virtual Json::Value composeAll() const override;
@@ -27,6 +27,7 @@
 #include "json/value.h"
 
 #include "jetproxy/JsonSchema.hpp"
+#include "jetproxy/PropertyTable.hpp"
 #include "jetproxy/StringEnum.hpp"
 #include "JetObjectProxyWithType.hpp"
 
@@ -55,60 +56,33 @@ namespace JetProxyExample
     {
     }
 
+    const hbk::jetproxy::PropertyTable < JetObjectProxyWithType::Properties >& JetObjectProxyWithType::propertyTable()
+    {
+        // one table describes composition, setting from jet and the type description
+        static const hbk::jetproxy::PropertyTable < Properties > table({
+            hbk::jetproxy::property < &Properties::boolProperty >(BOOL_PROPERTY, "A bool value."),
+            hbk::jetproxy::property < &Properties::intProperty >(INT_PROPERTY, "An int value."),
+            hbk::jetproxy::property < &Properties::floatProperty >(FLOAT_PROPERTY, "A float value."),
+            hbk::jetproxy::property < &Properties::enumProperty >(CUSTOM_DATATYPE_PROPERTY, "Setting a custom data type.", JetProxyExample::CustomDefinedDataType::MY_ENUM_DATA_TYPE.c_str()),
+            hbk::jetproxy::property < &Properties::floatArrayProperty >(FLOAT_ARRAY_PROPERTY, "A float array value."),
+            hbk::jetproxy::property < &Properties::floatVectorProperty >(FLOAT_VECTOR_PROPERTY, "A float vector value.")
+        });
+        return table;
+    }
+
     void JetObjectProxyWithType::composeProperties(Json::Value& composition) const
     {
-        composition[BOOL_PROPERTY] = m_properties.boolProperty;
-        composition[INT_PROPERTY] = m_properties.intProperty;
-        composition[FLOAT_PROPERTY] = m_properties.floatProperty;
-        composition[CUSTOM_DATATYPE_PROPERTY] =  m_properties.enumProperty;
-        composition[FLOAT_ARRAY_PROPERTY] =  hbk::jetproxy::JetProxy::composeArray(m_properties.floatArrayProperty, sizeof(m_properties.floatArrayProperty) / sizeof(float));
-        composition[FLOAT_VECTOR_PROPERTY] = hbk::jetproxy::JetProxy::composeVector(m_properties.floatVectorProperty);
+        propertyTable().compose(m_properties, composition);
     }
 
 
     hbk::jet::SetStateCbResult JetObjectProxyWithType::setFromJet(const Json::Value& request)
     {
-        Properties properties;
-        properties.enumProperty = JetProxyExample::CustomDefinedDataType::HBK;
-        Json::Value::Members members = request.getMemberNames();
-        for (std::string& member : members)
-        {
-            if (member.compare(BOOL_PROPERTY) == 0)
-            {
-                properties.boolProperty = request[BOOL_PROPERTY].asBool();
-            }
-            else if (member.compare(INT_PROPERTY) == 0)
-            {
-                properties.intProperty = request[INT_PROPERTY].asInt();
-            }
-            else if (member.compare(FLOAT_PROPERTY) == 0)
-            {
-                properties.floatProperty = request[FLOAT_PROPERTY].asFloat();
-            }
-            else if (member.compare(FLOAT_ARRAY_PROPERTY) == 0)
-            {
-                int i = 0;
-                for (const auto& val : request[FLOAT_ARRAY_PROPERTY])
-                {
-                    if (i < 32)
-                    {
-                        properties.floatArrayProperty[i] = val.asFloat();
-                        ++i;
-                    }
-                }
-            }
-            else if (member.compare(FLOAT_VECTOR_PROPERTY) == 0)
-            {
-                int i = 0;
-                for (const auto& val : request[FLOAT_VECTOR_PROPERTY])
-                {
-                    properties.floatVectorProperty.push_back(val.asFloat());
-                    ++i;
-                }
-            }
+        // only the requested properties are written
+        if (propertyTable().set(request, m_properties) > 0) {
+            //Needed to notify the jet that the change is valid
+            notify();
         }
-
-        setProperties(properties);
         // Return Value empty because everything is okay.
         return Json::Value();
     }
@@ -124,16 +98,7 @@ namespace JetProxyExample
     // is needed for working with Types
     Json::Value JetObjectProxyWithType::composePropertiesTypes()
     {
-        Json::Value type;
-
-        type[BOOL_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.boolProperty)>("A bool value.");
-        type[INT_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.intProperty)>("An int value.");
-        type[FLOAT_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.floatProperty)>("A float value.");
-        type[CUSTOM_DATATYPE_PROPERTY] = hbk::jetproxy::JsonSchema::createCustomizedType(JetProxyExample::CustomDefinedDataType::MY_ENUM_DATA_TYPE, "Setting a custom data type.");
-        type[FLOAT_ARRAY_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonArrayType<float>("A float array value.", sizeof(m_properties.floatArrayProperty) / sizeof(float));
-        type[FLOAT_VECTOR_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonVectorType<float>("A float vector value.");
-
-        return type;
+        return propertyTable().composeTypes();
     }
 
 
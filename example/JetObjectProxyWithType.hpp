@@ -31,7 +31,7 @@
 
 #include "jetproxy/ProxyJetStates.hpp"
 #include "jetproxy/JetProxy.hpp"
-#include "jetproxy/JetProxy.hpp"
+#include "jetproxy/PropertyTable.hpp"
 #include "CustomDefinedDataTypes.hpp"
 
 namespace JetProxyExample
@@ -85,6 +85,8 @@ namespace JetProxyExample
 
 	private:
 
+		static const hbk::jetproxy::PropertyTable < Properties >& propertyTable();
+
 		virtual void composeProperties(Json::Value& composition) const override;
         hbk::jet::SetStateCbResult setFromJet(const Json::Value& request) override;
 
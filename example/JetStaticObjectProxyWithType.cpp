@@ -27,6 +27,7 @@
 #include "json/value.h"
 
 #include "jetproxy/JsonSchema.hpp"
+#include "jetproxy/PropertyTable.hpp"
 #include "jetproxy/StringEnum.hpp"
 #include "JetStaticObjectProxyWithType.hpp"
 
@@ -48,47 +49,29 @@ namespace JetProxyExample
         setProperties(props);
     }
 
+    const hbk::jetproxy::PropertyTable < JetStaticObjectProxyWithType::Properties >& JetStaticObjectProxyWithType::propertyTable()
+    {
+        static const hbk::jetproxy::PropertyTable < Properties > table({
+            hbk::jetproxy::property < &Properties::boolProperty >(BOOL_PROPERTY, "A bool value."),
+            hbk::jetproxy::property < &Properties::intProperty >(INT_PROPERTY, "An int value."),
+            hbk::jetproxy::property < &Properties::floatProperty >(FLOAT_PROPERTY, "A float value."),
+            hbk::jetproxy::property < &Properties::floatArrayProperty >(FLOAT_ARRAY_PROPERTY, "A float array value.")
+        });
+        return table;
+    }
+
     void JetStaticObjectProxyWithType::composeProperties(Json::Value& composition) const
     {
-        composition[BOOL_PROPERTY] = m_properties.boolProperty;
-        composition[INT_PROPERTY] = m_properties.intProperty;
-        composition[FLOAT_PROPERTY] = m_properties.floatProperty;
-        composition[FLOAT_ARRAY_PROPERTY] =  hbk::jetproxy::JetProxy::composeArray(&m_properties.floatArrayProperty[0], m_properties.floatArrayProperty.size());
+        propertyTable().compose(m_properties, composition);
     }
 
 
     hbk::jet::SetStateCbResult JetStaticObjectProxyWithType::setFromJet(const Json::Value& request)
     {
-        Properties properties;
-        Json::Value::Members members = request.getMemberNames();
-        for (const std::string& member : members)
-        {
-            if (member.compare(BOOL_PROPERTY) == 0)
-            {
-                properties.boolProperty = request[BOOL_PROPERTY].asBool();
-            }
-            else if (member.compare(INT_PROPERTY) == 0)
-            {
-                properties.intProperty = request[INT_PROPERTY].asInt();
-            }
-            else if (member.compare(FLOAT_PROPERTY) == 0)
-            {
-                properties.floatProperty = request[FLOAT_PROPERTY].asFloat();
-            }
-            else if (member.compare(FLOAT_ARRAY_PROPERTY) == 0)
-            {
-                size_t i = 0;
-                for (const auto& val : request[FLOAT_ARRAY_PROPERTY])
-                {
-                    if (i < properties.floatArrayProperty.size())
-                    {
-                        properties.floatArrayProperty[i] = val.asFloat();
-                        ++i;
-                    }
-                }
-            }
+        // only the requested properties are written
+        if (propertyTable().set(request, m_properties) > 0) {
+            notify();
         }
-        setProperties(properties);
         // Return Value empty because everything is okay.
         return Json::Value();
     }
@@ -103,14 +86,7 @@ namespace JetProxyExample
     // is needed for working with Types
     Json::Value JetStaticObjectProxyWithType::composePropertiesTypes()
     {
-        Json::Value type;
-
-        type[BOOL_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.boolProperty)>("A bool value.");
-        type[INT_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.intProperty)>("An int value.");
-        type[FLOAT_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonSchemaType<decltype(m_properties.floatProperty)>("A float value.");
-        type[FLOAT_ARRAY_PROPERTY] = hbk::jetproxy::JsonSchema::createJsonArrayType<float>("A float array value.", sizeof(m_properties.floatArrayProperty) / sizeof(float));
-
-        return type;
+        return propertyTable().composeTypes();
     }
 
     void JetStaticObjectProxyWithType::restoreDefaults()
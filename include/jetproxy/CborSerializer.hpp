@@ -0,0 +1,77 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "json/value.h"
+
+namespace hbk::jetproxy {
+
+/// Encodes json documents as CBOR (RFC 8949) and back.
+///
+/// Used for the binary format of configuration files. The encoding is a lot more compact than indented json and is parsed faster.
+/// Documents start with the self-describe tag 55799 (bytes 0xd9 0xd9 0xf7), which tells them from json text.
+///
+/// Integers keep their signedness, reals are stored as single precision if this is lossless, double precision otherwise.
+/// Byte strings and indefinite lengths are not supported, other tags are ignored when decoding.
+class CborSerializer
+{
+public:
+    /// Appends the encoding of value to result
+    /// \param withHeader Prepend the self-describe tag
+    static void encode(const Json::Value& value, std::string& result, bool withHeader = true);
+
+    /// Appends the self-describe tag. Used when composing a document piece by piece.
+    static void encodeHeader(std::string& result);
+
+    /// Appends the header of a map with size members. Keys and values are to be appended afterwards.
+    static void encodeMapHeader(std::size_t size, std::string& result);
+
+    /// Appends a text string
+    static void encodeString(std::string_view text, std::string& result);
+
+    /// \throws std::runtime_error if data is no valid or supported CBOR document
+    static Json::Value decode(std::string_view data);
+
+    /// Called with the key and the encoding of the value of a member
+    using MemberCallback = std::function < void (std::string_view key, std::string_view value) >;
+
+    /// Walks the members of the map at the top level of a document without decoding their values.
+    /// Each value may be decoded by decode() later on.
+    /// \throws std::runtime_error if data is no valid or supported CBOR document or no map
+    static void forEachMember(std::string_view data, const MemberCallback& callback);
+
+    /// \return true if data starts with the self-describe tag
+    static bool hasHeader(std::string_view data);
+
+private:
+    class Decoder;
+};
+}
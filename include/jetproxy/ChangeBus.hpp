@@ -0,0 +1,88 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <shared_mutex>
+#include <string>
+
+namespace hbk::jetproxy {
+
+/// Tells about changes of the jet states of this process without a round trip through the jet daemon.
+///
+/// The object value states of jet proxies and their sub objects (see ProxyJetStates) announce each published change and
+/// each set request from jet on the default bus. Notifications that were suppressed because nothing changed are not announced.
+/// The jet path of the changed state is announced. Use ProxyRegistry::findOwner() to get the jet proxy a state belongs to.
+///
+/// Listeners are called in the thread that publishes, usually the event loop thread of the jet peer of the state.
+/// As long as there is no subscription, announcing costs an atomic load.
+class ChangeBus
+{
+public:
+    using Listener = std::function < void(const std::string& path) >;
+    using SubscriptionId = std::uint64_t;
+
+    ChangeBus();
+
+    ChangeBus(const ChangeBus& src) = delete;
+    ChangeBus& operator= (const ChangeBus& src) = delete;
+
+    /// The bus all jet states of the process announce their changes on
+    static ChangeBus& getDefault();
+
+    /// \param prefix Only changes of jet paths starting with prefix are delivered. Empty for all changes.
+    /// \return Id to unsubscribe with
+    SubscriptionId subscribe(const std::string& prefix, Listener listener);
+
+    /// Waits for listeners being called at the moment.
+    /// \warning Not to be called from within a listener.
+    void unsubscribe(SubscriptionId id);
+
+    /// Calls the listeners of all matching subscriptions
+    void announce(const std::string& path) const;
+
+    /// \return Number of subscriptions
+    std::size_t getSubscriptionCount() const;
+
+private:
+    struct Subscription {
+        std::string prefix;
+        Listener listener;
+    };
+
+    /// Subscription id is the key
+    using Subscriptions = std::map < SubscriptionId, Subscription >;
+
+    mutable std::shared_mutex m_mutex;
+    Subscriptions m_subscriptions;
+    SubscriptionId m_lastId;
+    /// Size of m_subscriptions, read without lock
+    std::atomic < std::size_t > m_count;
+};
+}
@@ -0,0 +1,76 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ios>
+#include <streambuf>
+
+namespace hbk::jetproxy {
+
+/// Passes the bytes written through it on to another stream buffer and computes their length and CRC-32C on the way
+/// (see SnapshotHeader::crc32c()).
+///
+/// Files are checksummed while being written, their content does not have to be kept in memory.
+class ChecksumStreamBuffer : public std::streambuf
+{
+public:
+    explicit ChecksumStreamBuffer(std::streambuf& target);
+
+    /// Passes the remaining bytes on
+    ~ChecksumStreamBuffer() override;
+
+    ChecksumStreamBuffer(const ChecksumStreamBuffer& src) = delete;
+    ChecksumStreamBuffer& operator= (const ChecksumStreamBuffer& src) = delete;
+
+    /// \return Number of bytes passed on so far. Flush the stream before.
+    std::uint64_t getLength() const
+    {
+        return m_length;
+    }
+
+    /// \return CRC-32C of the bytes passed on so far. Flush the stream before.
+    std::uint32_t getChecksum() const
+    {
+        return m_checksum;
+    }
+
+protected:
+    int_type overflow(int_type character) override;
+
+    int sync() override;
+
+private:
+    /// Checksums the buffered bytes and passes them on
+    /// \return false if the target did not take all of them
+    bool passOn();
+
+    std::streambuf& m_target;
+    std::array < char, 16 * 1024 > m_buffer;
+    std::uint64_t m_length;
+    std::uint32_t m_checksum;
+};
+}
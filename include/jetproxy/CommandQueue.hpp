@@ -0,0 +1,158 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "hbk/sys/eventloop.h"
+#include "hbk/sys/notifier.h"
+#include "jet/peerasync.hpp"
+
+namespace hbk::jetproxy {
+
+/// Marshals commands from any thread into the event loop that serves a jet peer.
+///
+/// jet proxies are not thread-safe. Threads other than the event loop thread have to post their mutations
+/// (e.g. setting properties and the resulting notifications) as commands instead of calling the jet proxy directly.
+/// Commands are executed in the event loop thread in the order they were posted.
+///
+/// Commands refer to their jet proxies without synchronization. Hence jet proxies of a jet peer with a command queue
+/// are to be destroyed in the event loop thread (e.g. by a posted command) or while the event loop is not running.
+///
+/// Posting is lock-free: Commands are appended to an intrusive multi producer single consumer queue.
+/// The event loop is woken up only if the queue was drained before.
+/// If there is a NotificationDispatcher for the jet peer, all commands executed in one iteration of the event loop form one batch.
+class CommandQueue
+{
+public:
+    using Command = std::function < void() >;
+
+    /// \throws std::runtime_error if there is a command queue for this jet peer already
+    CommandQueue(hbk::sys::EventLoop& eventloop, hbk::jet::PeerAsync& peer);
+
+    /// Remaining commands are executed
+    ~CommandQueue();
+
+    CommandQueue(const CommandQueue& src) = delete;
+    CommandQueue& operator= (const CommandQueue& src) = delete;
+
+    /// Called on every post, dispatch and destruction of a jet proxy.
+    /// Each thread caches the result, the cache is dropped when a command queue is created or destroyed.
+    /// \return The command queue of the jet peer or nullptr if there is none
+    static CommandQueue* get(const hbk::jet::PeerAsync& peer);
+
+    /// Thread-safe and lock-free. The command is executed in the event loop thread.
+    void post(Command command);
+
+    /// Executes the command at once if called from the event loop thread, posts it otherwise
+    void dispatch(Command command);
+
+    /// Thread-safe. The command is executed in a later iteration of the event loop, after the events that got pending meanwhile
+    /// (e.g. jet requests) were handled. Used to split long running work into slices that keep the jet peer responsive.
+    void defer(Command command);
+
+    /// \return true if called from the thread that executes the commands
+    bool isEventLoopThread() const;
+
+    /// \return true while the event loop thread executes posted or deferred commands
+    bool isExecuting() const;
+
+    /// Executes the commands posted so far to the command queues whose event loop thread is the calling thread.
+    /// For event loop threads waiting for other event loops, which in turn might wait for commands posted to them.
+    /// \return false if the calling thread is not the event loop thread of any command queue
+    static bool executeForThisThread();
+
+    /// \return Number of commands executed so far
+    std::uint64_t getExecutedCount() const
+    {
+        return m_executedCount;
+    }
+
+private:
+    struct Node {
+        std::atomic < Node* > next;
+        Command command;
+    };
+
+    using CommandQueues = std::unordered_map < const hbk::jet::PeerAsync*, CommandQueue* >;
+
+    /// Results of get() of the calling thread, valid for one generation of s_commandQueues
+    struct CachedCommandQueues {
+        std::uint64_t generation = 0;
+        CommandQueues commandQueues;
+    };
+
+    void push(Node* node);
+
+    /// To be called by the consumer only
+    /// \return nullptr if the queue is empty or a producer did not finish appending yet
+    Node* pop();
+
+    /// Called by the event loop after commands were posted
+    void executeHandler();
+
+    /// Executes all commands that are completely appended
+    void execute();
+
+    /// Called by the event loop after commands were deferred
+    void executeDeferredHandler();
+
+    /// Executes the commands deferred so far
+    /// \return false if there were none
+    bool executeDeferred();
+
+    hbk::jet::PeerAsync& m_peer;
+    hbk::sys::Notifier m_notifier;
+
+    /// Producers append here
+    std::atomic < Node* > m_head;
+    /// The consumer takes from here
+    Node* m_tail;
+    /// Keeps the queue linked when it is empty
+    Node m_stub;
+    /// Set if the event loop has been woken up and did not start to execute yet
+    std::atomic < bool > m_wakeUpPending;
+    std::atomic < std::thread::id > m_consumerThread;
+    std::atomic < bool > m_executing;
+    std::atomic < std::uint64_t > m_executedCount;
+
+    hbk::sys::Notifier m_deferredNotifier;
+    std::mutex m_deferredCommandsMutex;
+    std::vector < Command > m_deferredCommands;
+
+    /// Lookups do not block each other
+    static std::shared_mutex s_commandQueuesMutex;
+    static CommandQueues s_commandQueues;
+    /// Incremented whenever s_commandQueues changes
+    static std::atomic < std::uint64_t > s_commandQueuesGeneration;
+};
+}
@@ -0,0 +1,88 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json/value.h"
+
+namespace hbk::jetproxy {
+
+/// Read only view on a configuration file as written by ProxyRegistry, json or CBOR.
+///
+/// The file is memory mapped and only its top level is scanned for the offsets of the configurations of the jet proxies.
+/// A configuration is parsed when it is asked for. Memory use does not depend on the size of the configurations but on the number of jet proxies.
+/// A SnapshotHeader is skipped, its checksum is not verified.
+/// Files are replaced by renaming, hence the mapping stays valid while the file is saved again.
+/// The journal of the file is not looked at (see ProxyRegistry::appendToJournal()).
+class ConfigIndex
+{
+public:
+    /// \throws std::runtime_error if the file can not be mapped or has no object at the top level
+    explicit ConfigIndex(const std::string& fileName);
+
+    ~ConfigIndex();
+
+    ConfigIndex(const ConfigIndex&) = delete;
+    ConfigIndex& operator=(const ConfigIndex&) = delete;
+
+    /// \return true if there is a configuration for the jet path
+    bool contains(const std::string& path) const;
+
+    /// Parses the configuration of a jet path, the others are not touched
+    /// \return null value if there is no configuration for the jet path
+    /// \throws std::runtime_error if the configuration is invalid
+    Json::Value find(const std::string& path) const;
+
+    /// \return jet paths with a configuration, sorted
+    std::vector < std::string > getPaths() const;
+
+    std::size_t size() const;
+
+private:
+    /// Location of the encoded configuration in the file
+    struct Entry {
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    void indexJson(std::string_view data);
+
+    void indexCbor(std::string_view data);
+
+    std::string m_fileName;
+    void* m_mapping;
+    std::size_t m_mappingSize;
+    /// Mapping without SnapshotHeader
+    std::string_view m_content;
+    bool m_cbor;
+    /// a map keeps the order the json reader uses
+    std::map < std::string, Entry > m_entries;
+};
+}
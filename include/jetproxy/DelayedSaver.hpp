@@ -24,32 +24,85 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "hbk/sys/eventloop.h"
+#include "hbk/sys/notifier.h"
 #include "hbk/sys/timer.h"
 #include "jet/peerasync.hpp"
 
+#include "ChangeBus.hpp"
+#include "ProxyRegistry.hpp"
+
 namespace hbk::jetproxy {
-    /// Implements an automatic, rate limited mechanism to save all jetproxies created within this process upon any change on matching jet states.
+    /// Implements an automatic, rate limited mechanism to save all jetproxies of a registry upon any change on matching jet states.
+    /// By default, changes are taken from a fetch through the jet daemon (see Source).
     class DelayedSaver
     {
     public:
         using Matchers = std::vector < hbk::jet::matcher_t >;
+
+        /// Where changes of the matching jet states are taken from
+        enum class Source {
+            /// Opt-in. The ChangeBus of the process, hence changes of jet proxies on all jet peers of the process are seen (see ProxyShards).
+            /// Nothing goes through the jet daemon. Changes of sub objects count for the jet proxy above.
+            /// Changes caused by restoring jet proxies from file do not count unless the content differs from the file (see ProxyRegistry::isRestoring()).
+            /// Only startsWith, equals and contains of the matchers are supported, start() fails if any other field is used.
+            Local,
+            /// Default. A fetch through the jet daemon. Sees states of other processes as well but each change causes a notification to be received and parsed.
+            /// Only changes of states carrying the persistent flag count.
+            /// Changes caused by a restore do count: Their notifications come back from the jet daemon after the restore finished,
+            /// ProxyRegistry::isRestoring() can not tell them apart. The resulting save writes nothing if the content equals the file.
+            Fetch
+        };
         
-        DelayedSaver(hbk::sys::EventLoop& eventloop, hbk::jet::PeerAsync& peer);
+        /// \param registry The jet proxies of this registry are saved
+        DelayedSaver(hbk::sys::EventLoop& eventloop, hbk::jet::PeerAsync& peer, ProxyRegistry& registry = ProxyRegistry::getDefault());
         
         /// stop() is being called
         ~DelayedSaver();
         
         /// @param one or more fetch conditions that acivate the delayed save mechanism.
-        /// @param configFile name of the file to write to.
-        /// @return -1 When there is no machter or configFile is empty
+        /// @param configFile name of the file to write to, name of the directory with setSharded().
+        /// @return -1 When there is no machter, configFile is empty or a matcher is not supported by the source (see Source::Local)
         int start(const Matchers &matchers, const std::string& configFile);
+
+        /// @param source Source::Fetch by default
+        /// @warning To be called before start()
+        void setSource(Source source);
         
         /// @param delay The desired delay in milliseconds
         /// @warning Will not affected running delay! Change takes effect on next notification from a selected matcher.
         void setDelay(std::chrono::milliseconds delay);
+
+        /// Each change restarts the delay. To keep continuous changes from postponing the save forever, the save is done
+        /// at latest maxDelay after the first change that is not saved yet.
+        /// @param maxDelay 0 to wait for a quiet period of the delay without any deadline (default)
+        /// @warning Will not affect running delay! Change takes effect on next notification from a selected matcher.
+        void setMaxDelay(std::chrono::milliseconds maxDelay);
+
+        /// @return How long the oldest change that is not saved yet has been waiting, 0 if there is none.
+        std::chrono::milliseconds getPendingDuration() const;
+
+        /// Instead of rewriting the complete file, the changed jet proxies are appended to the journal of the file (see ProxyRegistry::appendToJournal()).
+        /// Once the journal grew beyond compactionSize, it is folded into the file by a background thread.
+        /// @param compactionSize 0 to rewrite the complete file on each save (default)
+        void setJournal(std::uintmax_t compactionSize);
+
+        /// Only composing is done in the event loop, the file is written by a background thread (see ProxyRegistry::saveToFileAsync()).
+        /// The save when stopping is done at once.
+        void setAsync(bool async);
+
+        /// configFile names a directory. Each jet proxy is saved to a file of its own inside it (see ProxyRegistry::saveToDirectory()).
+        /// A save writes the files of the changed jet proxies only. Journal and asynchronous saves do not apply.
+        void setSharded(bool sharded);
         
         /// If there is an delayed save in flight, we save at once by cancelling the delay timer
         void stop();
@@ -58,12 +111,39 @@ namespace hbk::jetproxy {
         
         /// @param fired false when stopped to force immediate save, true if delay has elapsed.
         void saveDelayedHandler(bool fired);
-        
-        bool m_doSaveOnChange;
+
+        static void logSaveDurations(const ProxyRegistry::SaveDurations& durations);
+
+        /// Remembers the changed jet path
+        void record(const std::string& path);
+
+        /// (Re)arms the timer for the changes recorded
+        void arm();
+
+        /// Called from the event loop after changes were announced on the ChangeBus
+        void localChangesHandler();
+
+        std::atomic < bool > m_doSaveOnChange;
+        Source m_source;
         std::string m_configFile;
         std::chrono::milliseconds m_delay;
+        std::chrono::milliseconds m_maxDelay;
         hbk::jet::PeerAsync &m_peer;
+        ProxyRegistry& m_registry;
         hbk::sys::Timer m_delayedSaveTimer;
+        hbk::sys::Notifier m_localChangesNotifier;
         std::vector < hbk::jet::fetchId_t > m_fetchIds;
+        std::vector < ChangeBus::SubscriptionId > m_subscriptions;
+        std::uintmax_t m_compactionSize;
+        bool m_async;
+        bool m_sharded;
+        /// jet paths of the states that changed since the last save
+        std::set < std::string > m_changedPaths;
+        /// time of the first change in m_changedPaths
+        std::chrono::steady_clock::time_point m_pendingSince;
+        /// jet paths announced on the ChangeBus, yet to be checked for persistence
+        std::set < std::string > m_announcedPaths;
+        mutable std::mutex m_changedPathsMutex;
+        std::future < int > m_compaction;
     };
 }
@@ -63,6 +63,12 @@ namespace hbk::jetproxy {
         ~Event();
 
         /// @brief Add the state to jet.
+        /// If there is a NotificationDispatcher for the jet peer, this is asynchronous: The state is added and removed
+        /// from the event loop after Trigger() returned. Message and severity are taken when Trigger() is called,
+        /// the event may even be sent after it was destroyed.
+        /// The event overtakes pending values and introspection of the dispatcher, also with its default of no limit per
+        /// iteration (see NotificationDispatcher::setMaxPerIteration()), because the lanes are checked before each item.
+        /// Without dispatcher, the state is added and removed before Trigger() returns.
         void Trigger();
 
         std::string getPath() const
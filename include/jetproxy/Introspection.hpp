@@ -24,6 +24,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -37,6 +38,7 @@
 #include "SelectionValueHandler.hpp"
 #include "IntrospectionVariableHandler.hpp"
 #include "NumericVariableHandler.hpp"
+#include "PublishedState.hpp"
 
 
 namespace hbk::jetproxy {
@@ -103,7 +105,7 @@ public:
             // This is the first introspecton entry created. Now we need the jet state to present the introspection.
             m_peer.addStateAsync(m_introspectionPath, compose(), hbk::jet::responseCallback_t(), hbk::jet::stateCallback_t());
         } else {
-            m_peer.notifyState(m_introspectionPath, compose());
+            notify();
         }
     }
 
@@ -120,7 +122,7 @@ public:
             // This is the first introspecton entry created. Now we need the jet state to present the introspection.
             m_peer.addStateAsync(m_introspectionPath, compose(), hbk::jet::responseCallback_t(), hbk::jet::stateCallback_t());
         } else {
-            m_peer.notifyState(m_introspectionPath, compose());
+            notify();
         }
     }
 
@@ -160,8 +162,12 @@ private:
     /// @return The complete introspection object or an empty object when there is no introspection
     Json::Value compose() const;
 
+    /// Publishes the introspection. If there is a NotificationDispatcher for the jet peer, it is published with lowest priority.
+    void notify() const;
+
     hbk::jet::PeerAsync& m_peer;
     std::string m_introspectionPath;
+    std::shared_ptr < PublishedState > m_published;
     EnumValueHandlers m_enumValueHandlers;
     SelectionValueHandlers m_selectionValueHandlers;
     IntrospectionVariableHandlers m_introspectionVariableHandlers;
@@ -24,14 +24,20 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "jet/peerasync.hpp"
 
+#include "jetproxy/CommandQueue.hpp"
 #include "jetproxy/JsonSchema.hpp"
 #include "ProxyJetStates.hpp"
+#include "ProxyRegistry.hpp"
 #include "Method.hpp"
 #include "objectmodel/ObjectModelConstants.hpp"
 
@@ -54,8 +60,15 @@ namespace hbk::jetproxy
 
     class JetProxy
     {
+        /// composes the jet proxies when publishing deferred notifications
+        friend class NotificationDispatcher;
+        /// saves and restores the jet proxies
+        friend class ProxyRegistry;
+
     public:
 
+        /// \warning If there is a CommandQueue for the jet peer, destroy the jet proxy in the event loop thread or while the event loop is not running.
+        /// Posted commands, restores and saves executed by the event loop refer to the jet proxy without synchronization.
         virtual ~JetProxy();
 
         /// Used by the factory to create a dynamic object of any type.
@@ -137,7 +150,11 @@ namespace hbk::jetproxy
             return m_path;
         }
 
-        /// Saves complete configuration of all existing jet proxies to json file.
+        /// \return The registry this jet proxy was created in
+        ProxyRegistry& getRegistry() const;
+
+        /// Saves complete configuration of all jet proxies of the default registry to json file.
+        /// See ProxyRegistry::saveToFile()
         /// Existing file is overwritten.
         /// Each jet proxy configuration is saved under its jet path.
         /// \code
@@ -155,9 +172,13 @@ namespace hbk::jetproxy
         ///   ...
         /// }
         /// \endcode
+        ///
+        /// Each jet proxy is composed in the event loop thread of its jet peer if there is a CommandQueue for the jet peer.
+        /// Hence this works across several jet peers with their own event loops (see ProxyShards).
         static int saveAllToFile(const std::string& fileName);
 
-        /// Read saved configuration and configure all jet proxies with matching jet path.
+        /// Read saved configuration and configure all jet proxies of the default registry with matching jet path.
+        /// See ProxyRegistry::restoreFromFile()
         ///
         /// If the requested configuration file does not exist or is invalid,
         /// default values are loaded for all jet proxies.
@@ -166,9 +187,22 @@ namespace hbk::jetproxy
         ///
         /// File entries for which no existing jet proxies are found are ignored.
         /// They are not created! Only existing jet proxies are configured.
+        ///
+        /// Each jet proxy is configured in the event loop thread of its jet peer if there is a CommandQueue for the jet peer.
         static int restoreAllFromFile(const std::string& fileName);
 
-        /// Load default settings for all jet proxies
+        /// Saves each persistent jet proxy of the default registry to a file of its own inside directory.
+        /// Only the files of changed jet proxies are written.
+        /// See ProxyRegistry::saveToDirectory()
+        static int saveAllToDirectory(const std::string& directory);
+
+        /// Configures all jet proxies of the default registry from the files written by saveAllToDirectory().
+        /// A damaged file sets its jet proxy to default values only.
+        /// See ProxyRegistry::restoreFromDirectory()
+        static int restoreAllFromDirectory(const std::string& directory);
+
+        /// Load default settings for all jet proxies of the default registry
+        /// See ProxyRegistry::restoreDefaults()
         /// They are not created! Only existing jet proxies are configured
         /// \warning If operation fails on a jetproxy, the problem will belogged.
         /// Operation will not be aborted but will continue with the remaining jet proxies.
@@ -179,6 +213,11 @@ namespace hbk::jetproxy
         /// \warning The method is also resonsible to notify all affected jet states.
         virtual void restoreDefaults() = 0;
 
+        /// jet paths of the jet proxies to be restored before this one, e.g. the selection variable a value is checked against.
+        /// Paths without jet proxy in the same registry are ignored (see ProxyRegistry::restoreFromFile()).
+        /// The default implementation returns the targets of all references of this jet proxy.
+        virtual std::vector < std::string > getRestoreDependencies() const;
+
         std::string getRoleLevel() const;
 
         void setRoleLevel(RoleLevel roleLevel);
@@ -187,13 +226,40 @@ namespace hbk::jetproxy
 
         void setPersistent(bool);
 
+        /// Limits the rate of notifications of the object value state.
+        /// Changes within the interval are conflated, the latest composition is published when the interval has elapsed.
+        /// The first notification is published immediately.
+        /// \warning Takes effect only if there is a NotificationDispatcher for the jet peer. A message is logged if there is none yet.
+        /// \param minInterval Minimum time between two notifications. 0 for no limit.
+        void setMinPublishInterval(std::chrono::milliseconds minInterval);
+
+        /// \return Number of notifications of the object value state that were suppressed because nothing changed
+        std::uint64_t getSuppressedNotificationCount() const;
+
+        /// jet proxies are not thread-safe. Threads other than the event loop thread mutate a jet proxy by posting commands.
+        /// The command is executed in the event loop thread that serves the jet peer.
+        /// Commands posted to one jet proxy are executed in the order they were posted.
+        /// The command is dropped if this jet proxy is destroyed before the command gets executed (see ~JetProxy() for the thread to destroy in).
+        /// Without a CommandQueue for the jet peer, the command is executed at once.
+        void post(CommandQueue::Command command) const;
+
+        /// Like post() but the command is executed at once if called from the event loop thread
+        void dispatch(CommandQueue::Command command) const;
+
     protected:
 
+        /// The jet proxy is registered in the default registry (see ProxyRegistry::getDefault())
         /// \param fixed If true, the jet proxy can not be removed by external clients
         /// \throws std::exception
         JetProxy(hbk::jet::PeerAsync& jetPeer, const std::string& type, const std::string& path, bool fixed, RoleLevel roleLevel = RoleLevel::USER, bool persistent = true);
 
+        /// \param registry The jet proxy is registered here. Has to outlive the jet proxy.
+        /// \param fixed If true, the jet proxy can not be removed by external clients
+        /// \throws std::exception
+        JetProxy(ProxyRegistry& registry, hbk::jet::PeerAsync& jetPeer, const std::string& type, const std::string& path, bool fixed, RoleLevel roleLevel = RoleLevel::USER, bool persistent = true);
+
         /// move constructable is usefull to move an existing object into a container
+        /// The registration is handed over to the new object. Handles of the registry remain valid.
         JetProxy(JetProxy&& other) noexcept;
         /// jet proxies may not be copied!
         JetProxy(JetProxy& src) = delete;
@@ -201,11 +267,16 @@ namespace hbk::jetproxy
         JetProxy& operator=(const JetProxy&) = delete;
 
 
-        /// The current state of the object is notified to jet
+        /// The current state of the object is notified to jet.
+        /// Nothing is notified if the composition did not change since the last notification.
+        /// If there is a NotificationDispatcher for the jet peer, composition and notification are deferred.
         void notify() const;
 
         /// Composes complete root object
         /// This should create a Json document with each member of the Object
+        ///
+        /// References, role level, persistence, fixed and type are taken from a cache.
+        /// Only the properties are composed each time.
         virtual Json::Value compose() const;
 
         /// Composes all properties of the root object.
@@ -256,8 +327,10 @@ namespace hbk::jetproxy
 
     private:
 
-        /// jet path is the key
-        using JetProxies = std::unordered_map<std::string, JetProxy*>;
+        /// Composes the members that are common to all jet proxies
+        Json::Value composeBase() const;
+
+
         using References = std::vector<std::string>;
 
         /// Reference id is the key. "this" is source of the reference, value is the target of the reference
@@ -266,9 +339,24 @@ namespace hbk::jetproxy
         /// Reference id is the key. value is the source of the reference, "this" is target of the reference
         std::map<std::string, References> m_referencesBySource;
 
-        /// Collection of all existing jet proxies.
+        /// Result of composeBase(). Invalidated by the setters of references, role level and persistence.
+        /// compose() copies it once and adds the properties to the copy.
+        mutable Json::Value m_baseComposition;
+        mutable bool m_baseCompositionValid;
+
+        /// Serialized composeAll() as written to the configuration file by the ProxyRegistry.
+        /// Reset by notify() and setPersistent(), hence only changed jet proxies are composed on the next save.
+        mutable std::shared_ptr < const std::string > m_savedComposition;
+        /// Invalidation count of the object value state when m_savedComposition was composed. A set request from jet invalidates the state.
+        mutable std::uint64_t m_savedCompositionInvalidationCount;
+        mutable ProxyRegistry::Format m_savedCompositionFormat;
+
+        /// Collection of jet proxies this one is registered in.
         /// It is used for:
         /// - Save/Restore complete configuration
-        static JetProxies m_jetProxies;
+        ProxyRegistry& m_registry;
+
+        /// Commands posted to this jet proxy are dropped when this expires
+        std::shared_ptr < const bool > m_lifetime;
     };
 } // namespace hbk::jetproxy
@@ -0,0 +1,74 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "json/value.h"
+
+#include "SnapshotFiles.hpp"
+
+namespace hbk::jetproxy {
+
+/// Journal of a configuration file (see ProxyRegistry::appendToJournal()).
+///
+/// Changes are appended as records instead of writing the whole file. Each record is one line of json:
+/// \code
+/// { "path" : <jet proxy path>, "config" : <the configuration as in the file or null if the entry was removed> }
+/// \endcode
+/// Records are replayed on top of the file and removed from the front of the journal once they got folded into the file.
+/// Appending and trimming have to be excluded from each other by the caller.
+class Journal
+{
+public:
+    /// \return Name of the journal of fileName
+    static std::string getFileName(const std::string& fileName);
+
+    /// \return Size of the journal of fileName in bytes, 0 if there is none
+    static std::uintmax_t getSize(const std::string& fileName);
+
+    /// \param records The configuration of each jet path, null if the entry was removed
+    /// \return One record per line
+    static std::string format(const Json::Value& records);
+
+    /// Appends records created by format() to the journal of fileName. Only the appended records are synced.
+    /// A record torn by a power loss is not continued.
+    /// \return 0 on success, -1 on error
+    static int append(const std::string& fileName, std::string records, SnapshotFiles::Durability durability);
+
+    /// Reads the first size bytes of the journal of fileName. Invalid records are ignored.
+    /// \return The last configuration recorded for each jet path, null for removed ones
+    static Json::Value read(const std::string& fileName, std::uintmax_t size);
+
+    /// Replays the first size bytes of the journal of fileName on top of config. Invalid records are ignored.
+    static void replay(const std::string& fileName, std::uintmax_t size, Json::Value& config);
+
+    /// Removes the first size bytes of the journal of fileName. Records appended behind them are kept.
+    /// \param trimmed true if the journal got trimmed, also if only syncing the directory failed afterwards
+    /// \return 0 on success, -1 on error
+    static int trim(const std::string& fileName, std::uintmax_t size, SnapshotFiles::Durability durability, bool& trimmed);
+};
+}
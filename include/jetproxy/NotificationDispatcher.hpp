@@ -0,0 +1,220 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "json/value.h"
+
+#include "hbk/sys/eventloop.h"
+#include "hbk/sys/notifier.h"
+#include "hbk/sys/timer.h"
+#include "jet/peerasync.hpp"
+
+#include "PublishedState.hpp"
+
+namespace hbk::jetproxy {
+
+class JetProxy;
+
+/// Coalesces the notifications of all jet states published by one jet peer.
+///
+/// While a dispatcher exists for a jet peer, JetProxy::notify() and ProxyJetStates::notify() do not notify at once.
+/// Instead, the state is marked dirty and each dirty state is published once per iteration of the event loop.
+/// The latest value wins. Jet proxies are composed when publishing, hence repeated notifications cost one composition only.
+///
+/// Use Batch for bulk updates across many jet proxies.
+///
+/// States with a minimum publish interval (see PublishedState::setMinInterval()) are published at most once per interval.
+/// Changes within the interval are conflated, the latest value is published when the interval has elapsed.
+/// All rate limited states share one timer.
+///
+/// Outgoing traffic is sorted into lanes of different priority (see Priority).
+/// Before anything gets published, the lanes of higher priority are drained.
+/// A jet path always uses the same lane, hence the order of the traffic of each path is kept.
+class NotificationDispatcher
+{
+public:
+    /// Lanes of outgoing traffic, highest priority first
+    enum class Priority {
+        Event = 0,          ///< Events and alarms. Not held back by a Batch.
+        Value = 1,          ///< Values of jet proxies and their sub states
+        Introspection = 2   ///< Introspection of jet proxies
+    };
+
+    /// While at least one batch exists, notifications are collected.
+    /// They are published when the last batch gets destroyed.
+    /// Traffic with Priority::Event is not held back.
+    class Batch
+    {
+    public:
+        explicit Batch(NotificationDispatcher& dispatcher);
+        ~Batch();
+
+        Batch(const Batch& src) = delete;
+        Batch& operator= (const Batch& src) = delete;
+
+    private:
+        NotificationDispatcher& m_dispatcher;
+    };
+
+    /// \throws std::runtime_error if there is a dispatcher for this jet peer already
+    NotificationDispatcher(hbk::sys::EventLoop& eventloop, hbk::jet::PeerAsync& peer);
+
+    /// Pending notifications are published, including those held back by a minimum publish interval
+    ~NotificationDispatcher();
+
+    NotificationDispatcher(const NotificationDispatcher& src) = delete;
+    NotificationDispatcher& operator= (const NotificationDispatcher& src) = delete;
+
+    /// Called on every notification. Each thread caches the result, the cache is dropped when a dispatcher is created or destroyed.
+    /// \return The dispatcher of the jet peer or nullptr if there is none
+    static NotificationDispatcher* get(const hbk::jet::PeerAsync& peer);
+
+    /// A pending notification of the same state is replaced by this one
+    void enqueue(const std::weak_ptr < PublishedState >& state, const Json::Value& value, Priority priority = Priority::Value);
+
+    /// The proxy is composed when the notification is published
+    void enqueue(const std::weak_ptr < PublishedState >& state, const JetProxy& proxy);
+
+    /// The operation is executed from the event loop before the pending notifications of the same priority.
+    /// Operations are never coalesced, they are executed in the order they were posted.
+    void post(Priority priority, std::function < void() > operation);
+
+    /// A pending notification of the proxy is dropped. To be called when the proxy is destroyed.
+    void cancel(const JetProxy& proxy);
+
+    /// A pending notification of from is to be composed by to. To be called when a proxy is moved.
+    void replace(const JetProxy& from, const JetProxy& to);
+
+    /// Publishes all pending notifications at once.
+    /// Notifications of states with a minimum publish interval that did not elapse yet are held back until it elapses.
+    void flush();
+
+    /// Limits the outgoing traffic per iteration of the event loop. The remainder is published in the following iterations.
+    /// This keeps the event loop responsive during bulk updates.
+    /// \param count Maximum number of notifications and operations per iteration. 0 for no limit (default).
+    void setMaxPerIteration(std::size_t count);
+
+    /// \return Number of notifications that were merged into an already pending one
+    std::uint64_t getCoalescedCount() const;
+
+private:
+    struct Pending {
+        std::weak_ptr < PublishedState > state;
+        /// If set, this proxy is composed when publishing. Otherwise value is published.
+        const JetProxy* proxy;
+        Json::Value value;
+    };
+
+    /// jet path is the key
+    using PendingNotifications = std::unordered_map < std::string, Pending >;
+    using Operations = std::deque < std::function < void() > >;
+    using Dispatchers = std::unordered_map < const hbk::jet::PeerAsync*, NotificationDispatcher* >;
+
+    struct Lane {
+        /// Executed before the notifications of the lane
+        Operations operations;
+        /// Paths in the order of their first notification
+        std::deque < std::string > order;
+        PendingNotifications pending;
+    };
+
+    static constexpr std::size_t LANE_COUNT = 3;
+
+    using Clock = std::chrono::steady_clock;
+    /// Earliest deadline on top
+    using Deadline = std::pair < Clock::time_point, std::string >;
+    using Deadlines = std::priority_queue < Deadline, std::vector < Deadline >, std::greater < Deadline > >;
+
+    void enqueue(const std::string& path, Priority priority, Pending&& pending);
+
+    /// Requests flushHandler to be called from the event loop. Expects m_mutex to be locked.
+    /// \return true if the notifier is to be notified
+    bool requestFlush(Priority priority);
+
+    /// Publishes or executes pending traffic, highest priority first.
+    /// Higher priority lanes are checked again before each item.
+    /// \param budget Maximum number of items, 0 for no limit
+    /// \param lowest Lanes with lower priority are not drained
+    /// \return true if there is traffic left in the drained lanes
+    bool drain(std::size_t budget, Priority lowest);
+
+    /// Holds the notification back if the minimum publish interval of the state did not elapse yet
+    void publishOrDelay(const std::string& path, Pending&& pending);
+
+    static void publish(const Pending& pending);
+
+    /// Called once per iteration of the event loop if there is anything to publish
+    void flushHandler();
+
+    /// Publishes all held back notifications whose minimum publish interval elapsed
+    void rateLimitHandler(bool fired);
+
+    /// Arms the timer for the earliest deadline. Expects m_mutex to be locked.
+    void armRateLimitTimer();
+
+    hbk::jet::PeerAsync& m_peer;
+    hbk::sys::Notifier m_flushNotifier;
+    hbk::sys::Timer m_rateLimitTimer;
+
+    mutable std::mutex m_mutex;
+    /// Index is the priority
+    std::array < Lane, LANE_COUNT > m_lanes;
+    /// Notifications held back until the minimum publish interval of their state elapsed
+    PendingNotifications m_delayed;
+    Deadlines m_deadlines;
+    /// Deadline the timer is armed for. Default constructed if not armed.
+    Clock::time_point m_armedDeadline;
+    unsigned int m_batchDepth;
+    bool m_flushRequested;
+    std::size_t m_maxPerIteration;
+    std::uint64_t m_coalescedCount;
+
+    /// Results of get() of the calling thread, valid for one generation of s_dispatchers
+    struct CachedDispatchers {
+        std::uint64_t generation = 0;
+        Dispatchers dispatchers;
+    };
+
+    static std::mutex s_dispatchersMutex;
+    static Dispatchers s_dispatchers;
+    /// Incremented whenever s_dispatchers changes
+    static std::atomic < std::uint64_t > s_dispatchersGeneration;
+};
+}
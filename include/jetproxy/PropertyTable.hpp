@@ -0,0 +1,421 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "json/value.h"
+
+#include "JsonSchema.hpp"
+
+namespace hbk::jetproxy {
+
+/// Converts a property of type T from and to json and describes its type.
+/// Specialize this template for property types that are not supported here.
+template < typename T, typename Enable = void >
+struct PropertyTraits;
+
+/// bool, integral, floating point and enum types
+template < typename T >
+struct PropertyTraits < T, std::enable_if_t < std::is_arithmetic_v < T > || std::is_enum_v < T > > >
+{
+    using Number = std::conditional_t < std::is_enum_v < T >, std::underlying_type < T >, std::common_type < T > >;
+    using ValueType = typename Number::type;
+
+    static Json::Value compose(const T& value)
+    {
+        const ValueType number = static_cast < ValueType >(value);
+        if constexpr (std::is_same_v < ValueType, bool >) {
+            return Json::Value(number);
+        } else if constexpr (std::is_floating_point_v < ValueType >) {
+            return Json::Value(static_cast < double >(number));
+        } else if constexpr (std::is_signed_v < ValueType > && (sizeof(ValueType) > sizeof(Json::Int))) {
+            return Json::Value(static_cast < Json::Int64 >(number));
+        } else if constexpr (std::is_signed_v < ValueType >) {
+            return Json::Value(static_cast < Json::Int >(number));
+        } else if constexpr (sizeof(ValueType) > sizeof(Json::UInt)) {
+            return Json::Value(static_cast < Json::UInt64 >(number));
+        } else {
+            return Json::Value(static_cast < Json::UInt >(number));
+        }
+    }
+
+    static bool isValid(const Json::Value& value)
+    {
+        if constexpr (std::is_same_v < ValueType, bool >) {
+            return value.isBool();
+        } else if constexpr (std::is_floating_point_v < ValueType >) {
+            return value.isNumeric();
+        } else if constexpr (std::is_signed_v < ValueType >) {
+            if (!value.isInt64()) {
+                return false;
+            }
+            const Json::Int64 number = value.asInt64();
+            return (number >= static_cast < Json::Int64 >(std::numeric_limits < ValueType >::min())) &&
+                (number <= static_cast < Json::Int64 >(std::numeric_limits < ValueType >::max()));
+        } else {
+            if (!value.isUInt64()) {
+                return false;
+            }
+            return value.asUInt64() <= static_cast < Json::UInt64 >(std::numeric_limits < ValueType >::max());
+        }
+    }
+
+    static void set(const Json::Value& value, T& property)
+    {
+        if constexpr (std::is_same_v < ValueType, bool >) {
+            property = static_cast < T >(value.asBool());
+        } else if constexpr (std::is_floating_point_v < ValueType >) {
+            property = static_cast < T >(value.asDouble());
+        } else if constexpr (std::is_signed_v < ValueType >) {
+            property = static_cast < T >(value.asInt64());
+        } else {
+            property = static_cast < T >(value.asUInt64());
+        }
+    }
+
+    static Json::Value composeType(const std::string& description)
+    {
+        return JsonSchema::createJsonSchemaType < ValueType >(description);
+    }
+};
+
+template < >
+struct PropertyTraits < std::string >
+{
+    static Json::Value compose(const std::string& value)
+    {
+        return value;
+    }
+
+    static bool isValid(const Json::Value& value)
+    {
+        return value.isString();
+    }
+
+    static void set(const Json::Value& value, std::string& property)
+    {
+        property = value.asString();
+    }
+
+    static Json::Value composeType(const std::string& description)
+    {
+        return JsonSchema::createJsonSchemaType < std::string >(description);
+    }
+};
+
+/// Arrays have a fixed number of elements. Surplus elements of a request are ignored.
+template < typename T, std::size_t N >
+struct PropertyTraits < T[N] >
+{
+    static Json::Value compose(const T (&value)[N])
+    {
+        Json::Value arrayValue = Json::arrayValue;
+        for (const auto& element : value) {
+            arrayValue.append(PropertyTraits < T >::compose(element));
+        }
+        return arrayValue;
+    }
+
+    static bool isValid(const Json::Value& value)
+    {
+        if (!value.isArray()) {
+            return false;
+        }
+        for (const auto& element : value) {
+            if (!PropertyTraits < T >::isValid(element)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void set(const Json::Value& value, T (&property)[N])
+    {
+        std::size_t i = 0;
+        for (const auto& element : value) {
+            if (i >= N) {
+                break;
+            }
+            PropertyTraits < T >::set(element, property[i]);
+            ++i;
+        }
+    }
+
+    static Json::Value composeType(const std::string& description)
+    {
+        return JsonSchema::createJsonArrayType < T >(description, N);
+    }
+};
+
+template < typename T, std::size_t N >
+struct PropertyTraits < std::array < T, N > >
+{
+    static Json::Value compose(const std::array < T, N >& value)
+    {
+        Json::Value arrayValue = Json::arrayValue;
+        for (const auto& element : value) {
+            arrayValue.append(PropertyTraits < T >::compose(element));
+        }
+        return arrayValue;
+    }
+
+    static bool isValid(const Json::Value& value)
+    {
+        return PropertyTraits < T[N] >::isValid(value);
+    }
+
+    static void set(const Json::Value& value, std::array < T, N >& property)
+    {
+        std::size_t i = 0;
+        for (const auto& element : value) {
+            if (i >= N) {
+                break;
+            }
+            PropertyTraits < T >::set(element, property[i]);
+            ++i;
+        }
+    }
+
+    static Json::Value composeType(const std::string& description)
+    {
+        return JsonSchema::createJsonArrayType < T >(description, N);
+    }
+};
+
+/// Vectors have a variable number of elements. A request replaces all elements.
+template < typename T >
+struct PropertyTraits < std::vector < T > >
+{
+    static Json::Value compose(const std::vector < T >& value)
+    {
+        Json::Value arrayValue = Json::arrayValue;
+        for (const auto& element : value) {
+            arrayValue.append(PropertyTraits < T >::compose(element));
+        }
+        return arrayValue;
+    }
+
+    static bool isValid(const Json::Value& value)
+    {
+        return PropertyTraits < T[1] >::isValid(value);
+    }
+
+    static void set(const Json::Value& value, std::vector < T >& property)
+    {
+        property.resize(value.size());
+        std::size_t i = 0;
+        for (const auto& element : value) {
+            PropertyTraits < T >::set(element, property[i]);
+            ++i;
+        }
+    }
+
+    static Json::Value composeType(const std::string& description)
+    {
+        return JsonSchema::createJsonVectorType < T >(description);
+    }
+};
+
+/// Describes one property of a properties struct: Its name on jet, the member it is stored in and its type.
+template < typename Properties >
+struct PropertyDescriptor
+{
+    const char* name;
+    const char* description;
+    /// If set, this type name is used in the type description instead of the one derived from the member
+    const char* customType;
+    Json::Value (*compose)(const Properties& properties);
+    bool (*isValid)(const Json::Value& value);
+    void (*set)(const Json::Value& value, Properties& properties);
+    Json::Value (*composeType)(const std::string& description);
+};
+
+namespace detail {
+    template < typename Member >
+    struct MemberPointer;
+
+    template < typename Class, typename T >
+    struct MemberPointer < T Class::* >
+    {
+        using Properties = Class;
+        using Type = T;
+    };
+
+    template < auto member >
+    struct PropertyAccess
+    {
+        using Properties = typename MemberPointer < decltype(member) >::Properties;
+        using Traits = PropertyTraits < typename MemberPointer < decltype(member) >::Type >;
+
+        static Json::Value compose(const Properties& properties)
+        {
+            return Traits::compose(properties.*member);
+        }
+
+        static void set(const Json::Value& value, Properties& properties)
+        {
+            Traits::set(value, properties.*member);
+        }
+    };
+}
+
+/// Creates the descriptor of a property
+/// \code
+/// property < &Properties::intProperty >("intProperty", "An int value.")
+/// \endcode
+template < auto member >
+constexpr PropertyDescriptor < typename detail::PropertyAccess < member >::Properties > property(const char* name, const char* description, const char* customType = nullptr)
+{
+    using Access = detail::PropertyAccess < member >;
+    return { name, description, customType, &Access::compose, &Access::Traits::isValid, &Access::set, &Access::Traits::composeType };
+}
+
+/// Finds property names in constant time.
+/// Uses a perfect hash that is calculated once on construction.
+/// This is done at runtime, not at compile time: The names may be defined in other translation units
+/// and custom types are std::string constants (see example/CustomDefinedDataTypes.hpp),
+/// neither can be read by a constant expression. Searching the seed takes a few hashes per name.
+class PropertyIndex
+{
+public:
+    static constexpr std::size_t NOT_FOUND = static_cast < std::size_t >(-1);
+
+    /// \throws std::runtime_error on duplicate names
+    explicit PropertyIndex(const std::vector < const char* >& names);
+
+    /// \return position of the name as given on construction or NOT_FOUND
+    std::size_t find(const std::string& name) const;
+
+private:
+    static std::uint32_t hash(const char* name, std::size_t length, std::uint32_t seed);
+
+    std::vector < const char* > m_names;
+    std::uint32_t m_seed;
+    /// position of the names, NOT_FOUND for empty slots
+    std::vector < std::size_t > m_slots;
+};
+
+/// Generates composition, validation and setting from jet and the type description of a properties struct
+/// from a table of property descriptors.
+/// The table is built once at runtime, usually as a function local static. See PropertyIndex for why it is not constexpr.
+///
+/// Validation is stricter than the Json::Value::as...() conversions of hand-written setFromJet():
+/// Integral and enum members reject fractional numbers (3.5 for an int) and numbers out of their range,
+/// bool members accept true and false only. Enum members are set like their underlying type.
+///
+/// \code
+/// static const PropertyTable < Properties > s_propertyTable({
+///     property < &Properties::boolProperty >(BOOL_PROPERTY, "A bool value."),
+///     property < &Properties::intProperty >(INT_PROPERTY, "An int value.")
+/// });
+/// \endcode
+template < typename Properties >
+class PropertyTable
+{
+public:
+    using Descriptor = PropertyDescriptor < Properties >;
+
+    PropertyTable(std::initializer_list < Descriptor > descriptors)
+        : m_descriptors(descriptors)
+        , m_index(names(m_descriptors))
+    {
+    }
+
+    /// Adds all properties to the composition
+    void compose(const Properties& properties, Json::Value& composition) const
+    {
+        for (const auto& descriptor : m_descriptors) {
+            composition[descriptor.name] = descriptor.compose(properties);
+        }
+    }
+
+    /// Validates all properties of the request first. Afterwards, only the requested properties are written.
+    /// Unknown members of the request are ignored.
+    /// \throws std::runtime_error if a requested property has an invalid value. Nothing is written in this case.
+    /// \return Number of properties written
+    std::size_t set(const Json::Value& request, Properties& properties) const
+    {
+        if (!request.isObject()) {
+            return 0;
+        }
+        std::vector < std::pair < const Descriptor*, const Json::Value* > > requested;
+        requested.reserve(request.size());
+        for (auto iter = request.begin(); iter != request.end(); ++iter) {
+            const std::size_t position = m_index.find(iter.name());
+            if (position == PropertyIndex::NOT_FOUND) {
+                continue;
+            }
+            const Descriptor& descriptor = m_descriptors[position];
+            if (!descriptor.isValid(*iter)) {
+                throw std::runtime_error("Invalid value for property '" + iter.name() + "'");
+            }
+            requested.emplace_back(&descriptor, &(*iter));
+        }
+
+        for (const auto& iter : requested) {
+            iter.first->set(*iter.second, properties);
+        }
+        return requested.size();
+    }
+
+    /// Is to be used by composePropertiesTypes()
+    Json::Value composeTypes() const
+    {
+        Json::Value types;
+        for (const auto& descriptor : m_descriptors) {
+            if (descriptor.customType) {
+                types[descriptor.name] = JsonSchema::createCustomizedType(descriptor.customType, descriptor.description);
+            } else {
+                types[descriptor.name] = descriptor.composeType(descriptor.description);
+            }
+        }
+        return types;
+    }
+
+private:
+    static std::vector < const char* > names(const std::vector < Descriptor >& descriptors)
+    {
+        std::vector < const char* > result;
+        result.reserve(descriptors.size());
+        for (const auto& descriptor : descriptors) {
+            result.push_back(descriptor.name);
+        }
+        return result;
+    }
+
+    std::vector < Descriptor > m_descriptors;
+    PropertyIndex m_index;
+};
+}
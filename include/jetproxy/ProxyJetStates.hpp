@@ -24,6 +24,8 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -34,6 +36,7 @@
 
 #include "Introspection.hpp"
 #include "Method.hpp"
+#include "PublishedState.hpp"
 
 #include "EnumValueHandler.hpp"
 #include "IntrospectionVariableHandler.hpp"
@@ -58,6 +61,30 @@ public:
     ProxyJetStates(ProxyJetStates&& src) = default;
     ProxyJetStates& operator= (ProxyJetStates&& src) = delete;
 
+    /// Publishes the value of the object value state.
+    /// The notification is suppressed if the value equals the one published last.
+    /// If there is a NotificationDispatcher for the jet peer, the value is published by the dispatcher later on.
+    void notify(const Json::Value& value);
+
+    /// \return Number of notifications of this state that were suppressed because nothing changed
+    std::uint64_t getSuppressedNotificationCount() const;
+
+    /// \return Number of notifications suppressed by all states of this process
+    static std::uint64_t getTotalSuppressedNotificationCount();
+
+    /// Limits the rate of notifications of the object value state.
+    /// Changes within the interval are conflated, the latest value is published when the interval has elapsed.
+    /// The first notification is published immediately.
+    /// \warning Takes effect only if there is a NotificationDispatcher for the jet peer. A message is logged if there is none yet.
+    /// \param minInterval Minimum time between two notifications. 0 for no limit.
+    void setMinPublishInterval(std::chrono::milliseconds minInterval);
+
+    /// Used by the NotificationDispatcher to publish deferred notifications
+    std::weak_ptr < PublishedState > getPublishedState() const
+    {
+        return m_published;
+    }
+
     /// \param methodName To be appended to path of the function block value path
     void addMethod(const std::string& methodName, const hbk::jet::methodCallback_t& callback, const Method::MethodDescription& description);
 
@@ -100,6 +127,8 @@ public:
 private:
     hbk::jet::PeerAsync& m_jetPeer;
     std::string m_path;
+    /// Shared with the state callback, hence it survives moving this object.
+    std::shared_ptr < PublishedState > m_published;
     std::vector < std::unique_ptr < Method > > m_methods;
     Introspection m_introspection;
 };
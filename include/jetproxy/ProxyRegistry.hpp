@@ -0,0 +1,608 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "json/value.h"
+
+#include "SnapshotFiles.hpp"
+
+namespace hbk::jetproxy {
+
+class CommandQueue;
+class ConfigIndex;
+class JetProxy;
+
+/// Registry of jet proxies organized as a tree of jet path segments.
+///
+/// Each registry is saved and restored on its own. Several services or device models in one process
+/// use a registry each to be persisted independently. Jet proxies are created into the default registry
+/// unless another one is given to the constructor of JetProxy.
+///
+/// "/fb/scaler1" is stored below "/fb" which allows to iterate over a subtree
+/// without looking at the jet proxies outside of it.
+/// Lookups share the lock, they do not block each other.
+class ProxyRegistry
+{
+public:
+    /// Refers to the jet proxy that was registered under a path.
+    /// A handle survives moves of the jet proxy.
+    /// It does not resolve to a jet proxy that got registered under the same path later on.
+    struct Handle {
+        std::string path;
+        /// 0 if invalid
+        std::uint64_t generation = 0;
+    };
+
+    using Operation = std::function < void(JetProxy&) >;
+
+    /// How hard a save makes sure that the written file survives a power loss
+    using Durability = SnapshotFiles::Durability;
+
+    /// Encoding of configuration files. Restoring detects the format of the file on its own.
+    enum class Format {
+        /// Indented json text
+        JSON,
+        /// Compact binary encoding, see CborSerializer
+        CBOR
+    };
+
+    /// Time spent in the phases of the last save
+    struct SaveDurations {
+        /// Composing the jet proxies or reading the existing file
+        std::chrono::microseconds compose{0};
+        /// Serializing and writing the temporary file
+        std::chrono::microseconds write{0};
+        /// Syncing the temporary file
+        std::chrono::microseconds syncFile{0};
+        /// Renaming the temporary file and syncing the directory
+        std::chrono::microseconds rename{0};
+        /// true if nothing was written because the file has this content already
+        bool skipped = false;
+    };
+
+    /// Called from the thread of asynchronous saves when the file was written.
+    /// \param result 0 on success, -1 on error
+    using Completion = std::function < void(int result, const SaveDurations& durations) >;
+
+    ProxyRegistry();
+
+    /// Waiting asynchronous saves are executed before
+    ~ProxyRegistry();
+
+    ProxyRegistry(const ProxyRegistry& src) = delete;
+    ProxyRegistry& operator= (const ProxyRegistry& src) = delete;
+
+    /// The registry used by JetProxy::saveAllToFile(), JetProxy::restoreAllFromFile() and JetProxy::restoreAllDefaults()
+    static ProxyRegistry& getDefault();
+
+    /// Saves complete configuration of all jet proxies of this registry to json file.
+    /// Existing file is overwritten. The records of its journal are covered and get dropped.
+    /// The file is synced according to setDurability(). See getLastSaveDurations() for the time spent.
+    /// Each jet proxy configuration is saved under its jet path.
+    /// \code
+    /// {
+    ///   <jet proxy path ("/fb/scaler1")> :
+    ///   {
+    ///     "connections" : <the connections>,
+    ///     "properties" : <the properties>
+    ///   }
+    ///   <another jet proxy path> :
+    ///   {
+    ///     "connections" : <the connections>,
+    ///     "properties" : <the properties>
+    ///   }
+    ///   ...
+    /// }
+    /// \endcode
+    ///
+    /// Each jet proxy is composed in the event loop thread of its jet peer if there is a CommandQueue for the jet peer.
+    /// Hence this works across several jet peers with their own event loops (see ProxyShards).
+    ///
+    /// jet proxies are written sorted by jet path, hence the same configuration always results in the same file.
+    /// If the file holds this content from the last save already, nothing is written (see getSkippedWriteCount()).
+    /// \return 0 on success, -1 on error
+    int saveToFile(const std::string& fileName) const;
+
+    /// Like saveToFile() but only composing is done before returning.
+    /// Serializing, writing and syncing the file is done by a background thread afterwards.
+    /// Hence the event loop is not blocked by file I/O when called from the event loop thread.
+    ///
+    /// At most one save is in flight. A save that is still waiting gets replaced by a newer one for the same file.
+    /// The completions of both are called when the newer one was written.
+    ///
+    /// A save is skipped if a newer configuration was written by another operation on the file meanwhile.
+    /// \warning Skipped means lost for changes that reached the file through the journal only.
+    /// Do not mix asynchronous saves with compactJournal() on the same file unless all changes go to the journal.
+    /// \param completion Optional, called from the background thread
+    /// \return 0 if the save got queued
+    int saveToFileAsync(const std::string& fileName, Completion completion = Completion()) const;
+
+    /// Blocks until all asynchronous saves are done
+    void waitForAsyncSaves() const;
+
+    /// Saves the configuration of the jet proxies in the subtree of prefix only.
+    /// The other entries of an existing file are kept, entries of the subtree are replaced.
+    /// Only the jet proxies of the subtree are composed.
+    /// A file that exists but can not be read is left untouched.
+    /// \return 0 on success, -1 on error
+    int saveSubtreeToFile(const std::string& fileName, const std::string& prefix) const;
+
+    /// Alternative to saveToFile(). Each persistent jet proxy is saved to a file of its own inside directory (see getShardFileName()).
+    /// A shard has the layout of the file written by saveToFile() with the entry of its jet proxy only.
+    ///
+    /// Only shards whose content differs from what was written last are written, getWriteCount() and getSkippedWriteCount() count shards.
+    /// With incremental save (see setIncrementalSave()), unchanged jet proxies are neither composed nor serialized again.
+    /// Shards of jet proxies that are gone or not persistent anymore are removed.
+    /// All shards written are synced before they replace the old ones, the directory is synced once afterwards.
+    ///
+    /// A change of a jet proxy hence writes its shard only and a damaged shard loses the configuration of its jet proxy only.
+    /// The directory is created if it does not exist. Journals and generations do not apply.
+    /// \return 0 on success, -1 on error
+    int saveToDirectory(const std::string& directory) const;
+
+    /// Jet paths are percent-encoded, "/fb/scaler1" is saved to "%2Ffb%2Fscaler1.config".
+    /// Names exceeding NAME_MAX are shortened to their beginning, '~' and a hash of the complete jet path.
+    /// The jet path of such a shard is taken from its content when restoring.
+    /// \return Name of the shard of the jet proxy with this path within directory (see saveToDirectory() and ShardDirectory)
+    static std::string getShardFileName(const std::string& directory, const std::string& path);
+
+    /// With incremental save, saveToFile() keeps the serialized configuration of each jet proxy.
+    /// On the next save, only jet proxies that changed since are composed again, the others are taken from this cache.
+    /// No json document of the complete configuration is built, the serialized parts are written one after the other.
+    ///
+    /// A jet proxy counts as changed after JetProxy::notify(), JetProxy::setPersistent() or a set request from jet on its object value state.
+    /// \warning Changes of persistent configuration that are not notified are not saved!
+    void setIncrementalSave(bool incremental);
+
+    /// Applies to saving files and appending to journals. Durability::FILE is the default.
+    void setDurability(Durability durability);
+
+    /// Format of files written by saves and compaction. Format::JSON is the default.
+    /// Journals stay json text.
+    void setFormat(Format format);
+
+    Format getFormat() const;
+
+    /// Number of files kept for each configuration file. 1, the default, keeps the latest file only.
+    ///
+    /// With more than one generation, each file starts with a SnapshotHeader. The latest file is named as requested,
+    /// older ones get the suffixes ".1", ".2" and so on. Restoring verifies the checksums and takes the latest intact generation
+    /// without parsing the others. A damaged write hence does not lose the configuration.
+    /// Journal records that were folded into a damaged generation are lost.
+    void setGenerations(unsigned int count);
+
+    unsigned int getGenerations() const;
+
+    /// \return Name of the file of a generation, 0 is the latest one (see setGenerations())
+    static std::string getGenerationFileName(const std::string& fileName, unsigned int generation);
+
+    /// Writes the configuration of a file, in any format and with its journal replayed, as indented json for debugging.
+    /// \return 0 on success, -1 on error
+    int exportToJson(const std::string& fileName, const std::string& jsonFileName) const;
+
+    Durability getDurability() const;
+
+    /// \return Durations of the phases of the last successful save, compaction included
+    SaveDurations getLastSaveDurations() const;
+
+    /// \return Number of jet proxies composed by saves with incremental save
+    std::uint64_t getComposedCount() const;
+
+    /// \return Number of jet proxies taken from the cache by saves with incremental save
+    std::uint64_t getReusedCount() const;
+
+    /// \return Number of files written by saves and compactions
+    std::uint64_t getWriteCount() const;
+
+    /// Saves and compactions do not write if the content equals what they wrote last and the file was not touched since.
+    /// \return Number of writes skipped for this reason
+    std::uint64_t getSkippedWriteCount() const;
+
+    /// Appends the configuration of the jet proxies with the given jet paths to the journal of fileName (see getJournalFileName()).
+    /// Costs depend on the number of changed jet proxies, not on the size of the model.
+    ///
+    /// Each record is one line of json:
+    /// \code
+    /// { "path" : <jet proxy path>, "config" : <the configuration as in the file or null if the entry was removed> }
+    /// \endcode
+    /// The jet path of a state of a sub object is mapped to the jet proxy owning it.
+    /// Jet proxies that are gone or not persistent are recorded as removed.
+    /// restoreFromFile() replays the journal on top of the file. saveToFile() folds it into the file.
+    /// \return 0 on success, -1 on error
+    int appendToJournal(const std::string& fileName, const std::vector < std::string >& paths) const;
+
+    /// Folds the journal into the file and removes the replayed records from the journal.
+    /// Only files are touched, no jet proxy is composed. Hence this may be executed in a background thread
+    /// while records are still appended.
+    /// \return 0 on success, -1 on error
+    int compactJournal(const std::string& fileName) const;
+
+    static std::string getJournalFileName(const std::string& fileName);
+
+    /// \return Size of the journal of fileName in bytes, 0 if there is none
+    static std::uintmax_t getJournalSize(const std::string& fileName);
+
+    /// Read saved configuration and configure all jet proxies of this registry with matching jet path.
+    ///
+    /// The journal of the file is replayed on top of it (see appendToJournal()).
+    ///
+    /// The file is not read as a whole. It is scanned by a ConfigIndex and the configuration of each jet proxy is parsed right before
+    /// it gets applied and dropped afterwards. Peak memory hence does not depend on the size of the file.
+    ///
+    /// If the requested configuration file does not exist or is invalid and there is no journal,
+    /// default values are loaded for all jet proxies.
+    ///
+    /// If restoration of a single jet proxy fails or its entry in the file is invalid, it is set to default values.
+    ///
+    /// Jet proxies are restored after the jet proxies they depend on (see JetProxy::getRestoreDependencies()).
+    /// Jet proxies that are independent of each other form a layer. The entries of a layer are parsed in parallel (see setRestoreThreads()),
+    /// then applied by the event loops of the jet peers. Jet proxies with cyclic dependencies are restored last.
+    ///
+    /// File entries for which no existing jet proxies are found are ignored.
+    /// They are not created! Only existing jet proxies are configured.
+    ///
+    /// Each jet proxy is configured in the event loop thread of its jet peer if there is a CommandQueue for the jet peer.
+    /// \return 0 on success, -1 if defaults were loaded because the file could not be read
+    int restoreFromFile(const std::string& fileName);
+
+    /// Like restoreFromFile() but only the jet proxies in the subtree of prefix are touched.
+    /// Defaults are loaded for the subtree only if the file could not be read.
+    int restoreFromFile(const std::string& fileName, const std::string& prefix);
+
+    /// Like restoreFromFile() but reads the shards written by saveToDirectory().
+    /// The shards are parsed in parallel (see setRestoreThreads()), then applied layer by layer.
+    /// Jet proxies with a damaged shard are set to default values, the others are restored from their shards.
+    /// \return 0 on success, -1 if defaults were loaded because the directory could not be read
+    int restoreFromDirectory(const std::string& directory);
+
+    /// Like restoreFromDirectory() but only the jet proxies in the subtree of prefix are touched. Shards outside the subtree are not read.
+    int restoreFromDirectory(const std::string& directory, const std::string& prefix);
+
+    /// Called with the number of jet proxies restored so far and the number of jet proxies to restore
+    using RestoreProgress = std::function < void(std::size_t restored, std::size_t total) >;
+    /// Called once when a time-sliced restore is done, with the result of restoreFromFile()
+    using RestoreCompletion = std::function < void(int result) >;
+
+    /// Limits the work of a time-sliced restore per iteration of an event loop.
+    /// A slice ends after count jet proxies or after duration, whichever comes first. Each slice restores at least one jet proxy.
+    /// Defaults are 100 jet proxies and 10ms.
+    void setRestoreSlice(std::size_t count, std::chrono::microseconds duration);
+
+    /// Number of threads parsing the entries of the configuration file during restoreFromFile(). 1, the default, parses in the calling thread.
+    void setRestoreThreads(unsigned int threads);
+
+    /// Like restoreFromFile() but returns at once. The event loops of the jet peers restore their jet proxies in slices
+    /// (see setRestoreSlice()) and handle pending jet requests in between. Jet proxies of jet peers without CommandQueue are restored before returning.
+    ///
+    /// Dependencies between jet proxies are not taken into account, the event loops might not run yet to ask for them.
+    /// progress is called after each slice, completion once after the last one. Both are called from the thread that finished the slice, never concurrently.
+    /// The jet peers of the jet proxies must outlive the restore. Jet proxies that are destroyed meanwhile in their event loop thread are skipped.
+    /// \return 0 if the restore was started, -1 if defaults were loaded because the file could not be read. completion is called in both cases.
+    int restoreFromFileSliced(const std::string& fileName, const std::string& prefix, RestoreProgress progress = RestoreProgress(), RestoreCompletion completion = RestoreCompletion());
+
+    /// Tells whether a change announced on the ChangeBus is caused by restoreFromFile(), restoreFromFileSliced() or restoreFromDirectory().
+    /// A jet proxy counts as restoring from its entry being applied until the notifications caused by it were published by its event loop.
+    /// Other jet proxies, e.g. those outside the subtree of the restore, are not affected. States of sub objects count for the jet proxy above.
+    ///
+    /// When the restore is done, the jet proxies whose content differs from their entry are announced again,
+    /// e.g. those that rejected their entry and restored their defaults. A DelayedSaver ignores the rest, hence a restore does not cause the file to be written back.
+    /// \return true if the jet proxy owning the state with this jet path is being configured by a restore
+    bool isRestoring(const std::string& path) const;
+
+    /// Load default settings for all jet proxies of this registry
+    /// \warning If operation fails on a jetproxy, the problem will belogged.
+    /// Operation will not be aborted but will continue with the remaining jet proxies.
+    int restoreDefaults();
+
+    /// Load default settings for the jet proxies in the subtree of prefix
+    int restoreDefaults(const std::string& prefix);
+
+    /// \return true if path is in the subtree of prefix. Same rules as forEach().
+    static bool isInSubtree(const std::string& path, const std::string& prefix);
+
+    /// \throws std::runtime_error if the path is in use already
+    void insert(const std::string& path, JetProxy& jetProxy);
+
+    /// Nothing happens if another jet proxy is registered under this path
+    /// \return 1 if the jet proxy was unregistered, 0 otherwise
+    std::size_t erase(const std::string& path, const JetProxy& jetProxy);
+
+    /// To be called when a registered jet proxy was moved. Handles remain valid.
+    /// Nothing happens if from is not registered under this path.
+    void replace(const std::string& path, const JetProxy& from, JetProxy& to);
+
+    /// \return nullptr if there is no jet proxy with this path
+    JetProxy* find(const std::string& path) const;
+
+    /// States of sub objects belong to the jet proxy above them.
+    /// \return The jet proxy with this path or the nearest one above it. nullptr if there is none.
+    JetProxy* findOwner(const std::string& path) const;
+
+    /// \return An invalid handle if there is no jet proxy with this path
+    Handle getHandle(const std::string& path) const;
+
+    /// \return nullptr if the jet proxy of the handle was unregistered
+    JetProxy* resolve(const Handle& handle) const;
+
+    /// Calls the operation for all jet proxies in the subtree of prefix. Parents come before their children, siblings are sorted by name.
+    /// The prefix is compared segment by segment: "/fb" covers "/fb" and "/fb/scaler1" but not "/fbx".
+    /// An empty prefix covers all jet proxies.
+    /// \warning The operation is called while holding the lock. It may not register or unregister jet proxies.
+    void forEach(const std::string& prefix, const Operation& operation) const;
+
+    /// \return Number of registered jet proxies
+    std::size_t size() const;
+
+private:
+    struct Node {
+        /// Segment is the key
+        std::map < std::string, std::unique_ptr < Node >, std::less < > > children;
+        JetProxy* jetProxy = nullptr;
+        std::uint64_t generation = 0;
+    };
+
+    /// \return nullptr if there is no such node
+    const Node* findNode(std::string_view path) const;
+
+    /// See findOwner(). Expects m_mutex to be locked.
+    JetProxy* lookupOwner(std::string_view path) const;
+
+    static void forEach(const Node& node, const Operation& operation);
+
+    /// Executes the operation for each jet proxy in the event loop thread of its jet peer and waits until all are done.
+    /// The jet proxies of different jet peers are processed in parallel.
+    /// Jet proxies of jet peers without CommandQueue are processed in the calling thread.
+    /// Jet proxies destroyed in their event loop thread before their turn are skipped (see ~JetProxy()).
+    /// If the operation throws, the remaining jet proxies of that jet peer are skipped. The exception is rethrown in the calling thread
+    /// after all jet peers are done, it does not reach the event loop.
+    /// While waiting, an event loop thread executes the commands posted to it (see CommandQueue::executeForThisThread()).
+    /// Hence event loops may do this at the same time without waiting for each other forever.
+    /// \warning The event loops of all jet peers with CommandQueue have to be running.
+    /// \warning Do not call while holding a lock an event loop might wait for, e.g. m_compactionMutex.
+    void forEachInEventLoop(const std::string& prefix, const Operation& operation) const;
+
+    /// Calls the given operation for each jet proxy to visit while holding the lock
+    using Enumeration = std::function < void(const Operation&) >;
+
+    /// Like above but visits the jet proxies given by enumerate
+    void forEachInEventLoop(const Enumeration& enumerate, const Operation& operation) const;
+
+    /// Reads what restoreFromFile() needs and reports file entries without jet proxy.
+    /// Loads defaults for the subtree of prefix if neither the file nor a journal could be read.
+    /// \param journal The last record of the journal for each jet path, null for removed ones
+    /// \return 0 on success, -1 if defaults were loaded
+    int openConfig(const std::string& fileName, const std::string& prefix, std::shared_ptr < const ConfigIndex >& index, Json::Value& journal);
+
+    /// Configures one jet proxy from the journal or the file. Restores its defaults on failure.
+    /// \return false if the content of the jet proxy differs from its entry afterwards
+    static bool restoreJetProxy(JetProxy& jetProxy, const ConfigIndex* index, const Json::Value& journal);
+
+    /// Sets the configuration or restores the defaults if it failed to parse or to be set.
+    /// Any exception is caught, a failing jet proxy must not stop the restore of the others.
+    /// \param error Set if the configuration could not be parsed
+    /// \return false if the content of the jet proxy differs from config afterwards
+    static bool applyConfig(JetProxy& jetProxy, const Json::Value& config, const std::exception_ptr& error);
+
+    /// Jet proxies in restore order. The jet proxies of a layer depend on jet proxies of earlier layers only.
+    using RestoreLayers = std::vector < std::vector < Handle > >;
+
+    /// \return The jet proxies in the subtree of prefix with a configuration in index or journal
+    RestoreLayers getRestoreLayers(const std::string& prefix, const ConfigIndex* index, const Json::Value& journal) const;
+
+    /// Parses the configurations of the jet proxies of a layer, then applies them
+    /// \param deviations The jet paths of the jet proxies whose content differs from their entry afterwards are appended
+    void restoreLayer(const std::vector < Handle >& layer, const ConfigIndex* index, const Json::Value& journal, std::vector < std::string >& deviations) const;
+
+    /// Announces the deviations on the ChangeBus when a restore is done
+    static void announceDeviations(const std::vector < std::string >& deviations);
+
+    /// From now on, changes of the jet proxy with this path are caused by a restore (see isRestoring())
+    void markRestoring(const std::string& path) const;
+
+    /// Reverts markRestoring() for each of the paths
+    void unmarkRestoring(const std::vector < std::string >& paths) const;
+
+    /// Shared by the slices of a time-sliced restore
+    struct SlicedRestore;
+
+    /// Restores the jet proxies of one jet peer from position on until the slice is used up
+    /// \return Position of the first jet proxy of the next slice
+    static std::size_t restoreSlice(SlicedRestore& restore, std::size_t peerIndex, std::size_t position);
+
+    /// Defers the next slice to the event loop of the jet peer
+    static void deferSlice(const std::shared_ptr < SlicedRestore >& restore, CommandQueue& commandQueue, std::size_t peerIndex, std::size_t position);
+
+    /// \return The compositions of all persistent jet proxies in the subtree of prefix. jet path is the key.
+    Json::Value compose(const std::string& prefix) const;
+
+    /// Serialized configuration. jet path is the key.
+    using Compositions = std::map < std::string, std::shared_ptr < const std::string > >;
+    using Writer = std::function < void(std::ostream&) >;
+
+    /// Describes when a configuration was taken. Tells which journal records it covers.
+    struct Position {
+        /// Configurations taken later have a higher sequence
+        std::uint64_t sequence = 0;
+        /// Size of the journal, relative to the current journal file
+        std::uintmax_t journalSize = 0;
+        /// Size of the journal, counted from the first record ever appended. Survives trimming.
+        std::uintmax_t journalOffset = 0;
+    };
+
+    /// What happened to a file and its journal
+    struct FileState {
+        /// Bytes removed from the front of the journal
+        std::uintmax_t trimmedJournal = 0;
+        /// Sequence of the configuration in the file
+        std::uint64_t writtenSequence = 0;
+        /// Of the SnapshotHeader last written, 0 if unknown
+        std::uint64_t snapshotSequence = 0;
+        /// Digest of the content last written, SnapshotHeader excluded
+        bool written = false;
+        std::uint64_t contentLength = 0;
+        std::uint32_t contentChecksum = 0;
+        /// Of the file after it was written last. A file changed by others is written again.
+        std::uintmax_t fileSize = 0;
+        std::filesystem::file_time_type fileTime;
+    };
+
+    struct SaveRequest {
+        std::string fileName;
+        Writer write;
+        Position position;
+        SaveDurations durations;
+        std::vector < Completion > completions;
+    };
+
+    /// \return The composition serialized as an entry of the configuration file
+    static std::string serializeComposition(const Json::Value& composition, Format format);
+
+    /// \return The serialized composition cached by the jet proxy, composed again if it changed since
+    /// \param composed false if taken from the cache
+    static std::shared_ptr < const std::string > getSavedComposition(const JetProxy& jetProxy, Format format, bool& composed);
+
+    /// Like compose() but uses the compositions cached by the jet proxies
+    Compositions composeSaved(const std::string& prefix) const;
+
+    /// Like composeSaved() but without incremental save each composition is composed and serialized anew
+    Compositions composeSerialized(const std::string& prefix) const;
+
+    /// The writers own the configuration. They may be executed in any thread.
+    static Writer createWriter(Json::Value config, Format format);
+
+    static Writer createWriter(Compositions compositions, Format format);
+
+    /// Composes all jet proxies as done by saveToFile()
+    Writer composeWriter(SaveDurations& durations) const;
+
+    /// Writes to a temporary file that is renamed to fileName afterwards
+    /// \param durations Write, sync and rename are measured
+    /// \return 0 on success, -1 on error
+    /// \param generations Older files are moved one generation up before the new one replaces the latest
+    int writeFile(const std::string& fileName, const Writer& write, unsigned int generations, SaveDurations& durations) const;
+
+    /// Syncs the temporary file written for fileName and renames it to fileName
+    /// \param durations Sync and rename are measured
+    /// \return 0 on success, -1 on error
+    /// \param generations Older files are moved one generation up before the new one replaces the latest
+    int replaceFile(const std::string& fileName, unsigned int generations, SaveDurations& durations) const;
+
+    /// \return true if the content was written to fileName last and the file was not touched since
+    bool isWritten(const std::string& fileName, std::uint64_t contentLength, std::uint32_t contentChecksum) const;
+
+    /// To be called before taking the configuration to write
+    Position getPosition(const std::string& fileName) const;
+
+    /// \return A sequence higher than those returned before, shared with Position::sequence
+    std::uint64_t getSequence() const;
+
+    /// \return Size of the journal up to the position, relative to the current journal file. 0 if trimmed meanwhile.
+    std::uintmax_t getUntrimmedJournalSize(const std::string& fileName, const Position& position) const;
+
+    /// Writes the file unless a newer configuration was written already and trims the journal records covered.
+    /// Nothing is written if the file holds this content already (see getSkippedWriteCount()).
+    /// m_compactionMutex has to be locked.
+    int commit(const std::string& fileName, const Writer& write, const Position& position, SaveDurations& durations) const;
+
+    /// Executes asynchronous saves one after the other
+    void saveWorker() const;
+
+    /// \return The content of the file with the journal replayed on top of it
+    /// \throws std::runtime_error if neither a valid file nor a journal exists
+    Json::Value readConfig(const std::string& fileName) const;
+
+    /// Removes the journal records up to offset (see Position::journalOffset) after they got folded into the file
+    int trimJournal(const std::string& fileName, std::uintmax_t offset) const;
+
+    /// Like getJournalSize() but waits for a running append
+    std::uintmax_t lockJournalSize(const std::string& fileName) const;
+
+    mutable std::shared_mutex m_mutex;
+    Node m_root;
+    std::size_t m_size;
+    std::uint64_t m_lastGeneration;
+
+    /// Appending to and trimming of journals exclude each other
+    mutable std::mutex m_journalMutex;
+    /// Only one operation writes the file at a time. Not held while waiting for event loops, they might save themselves.
+    mutable std::mutex m_compactionMutex;
+    /// Shards last written by saveToDirectory(). Directory is the key. Guarded by m_compactionMutex
+    mutable std::map < std::string, Compositions > m_writtenShards;
+    /// Sequence of the compositions last written by saveToDirectory(). Directory is the key. Guarded by m_compactionMutex
+    mutable std::map < std::string, std::uint64_t > m_writtenShardsSequences;
+
+    std::atomic < bool > m_incrementalSave;
+    std::atomic < Durability > m_durability;
+    std::atomic < Format > m_format;
+    std::atomic < std::size_t > m_restoreSliceCount;
+    std::atomic < std::chrono::microseconds > m_restoreSliceDuration;
+    std::atomic < unsigned int > m_restoreThreads;
+    /// jet paths of the jet proxies being configured by restores, see isRestoring(). Guarded by m_restoringMutex
+    mutable std::multiset < std::string > m_restoringPaths;
+    mutable std::mutex m_restoringMutex;
+    /// Size of m_restoringPaths, read without lock
+    mutable std::atomic < std::size_t > m_restoringCount;
+    std::atomic < unsigned int > m_generations;
+    mutable std::atomic < std::uint64_t > m_composedCount;
+    mutable std::atomic < std::uint64_t > m_reusedCount;
+    mutable std::atomic < std::uint64_t > m_writeCount;
+    mutable std::atomic < std::uint64_t > m_skippedWriteCount;
+    mutable std::mutex m_saveDurationsMutex;
+    mutable SaveDurations m_lastSaveDurations;
+
+    /// Guarded by m_journalMutex
+    mutable std::uint64_t m_lastSequence;
+    /// File name is the key. Guarded by m_journalMutex
+    mutable std::map < std::string, FileState > m_fileStates;
+
+    mutable std::mutex m_saveRequestsMutex;
+    mutable std::condition_variable m_saveRequestsCondition;
+    mutable std::deque < SaveRequest > m_saveRequests;
+    mutable bool m_saveInFlight;
+    mutable bool m_stopSaveWorker;
+    /// Started with the first asynchronous save
+    mutable std::thread m_saveWorker;
+};
+}
@@ -0,0 +1,111 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "hbk/sys/eventloop.h"
+#include "jet/peerasync.hpp"
+
+#include "CommandQueue.hpp"
+#include "NotificationDispatcher.hpp"
+
+namespace hbk::jetproxy {
+
+/// Spreads jet proxies across several jet peers, each with its own event loop and thread.
+///
+/// Compose, setFromJet and serialization of jet proxies on different shards run on different cores.
+/// Each shard has a CommandQueue and a NotificationDispatcher.
+/// Hence JetProxy::saveAllToFile(), JetProxy::restoreAllFromFile() and the DelayedSaver
+/// process each jet proxy in the event loop thread of its shard.
+///
+/// Jet proxies are assigned to a shard by the hash of their path or explicitly by shard index.
+class ProxyShards
+{
+public:
+    /// Connects all jet peers and starts the event loop threads
+    /// \param count Number of shards
+    /// \param address Address of the jet daemon or name of the unix domain socket
+    /// \param port Port of the jet daemon, 0 for unix domain socket
+    /// \throws std::runtime_error if count is 0
+    ProxyShards(std::size_t count, const std::string& address, unsigned int port);
+
+    /// Stops all event loops
+    ~ProxyShards();
+
+    /// Stops all event loops and joins their threads.
+    /// Jet proxies of the shards are to be destroyed afterwards or in the event loop thread of their shard (see ~JetProxy()).
+    void stop();
+
+    ProxyShards(const ProxyShards& src) = delete;
+    ProxyShards& operator= (const ProxyShards& src) = delete;
+
+    std::size_t getCount() const
+    {
+        return m_shards.size();
+    }
+
+    /// \return Index of the shard a jet proxy with this path is assigned to
+    std::size_t getIndex(const std::string& path) const;
+
+    /// \return jet peer of the shard the path is assigned to
+    hbk::jet::PeerAsync& getPeer(const std::string& path);
+
+    /// \throws std::out_of_range
+    hbk::jet::PeerAsync& getPeer(std::size_t index);
+
+    /// \throws std::out_of_range
+    hbk::sys::EventLoop& getEventLoop(std::size_t index);
+
+    /// \throws std::out_of_range
+    CommandQueue& getCommandQueue(std::size_t index);
+
+    /// Creates a jet proxy on the shard the path is assigned to.
+    /// The jet proxy type is to be constructible from (hbk::jet::PeerAsync&, path, args...)
+    template < typename ObjectType, typename... Args >
+    std::unique_ptr < ObjectType > createObject(const std::string& path, Args&&... args)
+    {
+        return std::make_unique < ObjectType >(getPeer(path), path, std::forward < Args >(args)...);
+    }
+
+private:
+    struct Shard {
+        Shard(const std::string& address, unsigned int port);
+
+        hbk::sys::EventLoop eventloop;
+        hbk::jet::PeerAsync peer;
+        NotificationDispatcher dispatcher;
+        CommandQueue commandQueue;
+        std::thread thread;
+    };
+
+    std::vector < std::unique_ptr < Shard > > m_shards;
+};
+}
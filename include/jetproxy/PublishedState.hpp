@@ -0,0 +1,109 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "json/value.h"
+
+#include "jet/peerasync.hpp"
+
+namespace hbk::jetproxy {
+
+/// Publishes the value of a jet state and remembers what was published last.
+/// Notifications that carry no change are suppressed.
+class PublishedState
+{
+public:
+    /// \param initialValue The value the state was created with
+    /// \param announceChanges Each published change is announced on the default ChangeBus
+    PublishedState(hbk::jet::PeerAsync& peer, const std::string& path, const Json::Value& initialValue, bool announceChanges = false);
+
+    PublishedState(const PublishedState& src) = delete;
+    PublishedState& operator= (const PublishedState& src) = delete;
+
+    /// \return false if the notification was suppressed because the value did not change
+    bool publish(const Json::Value& value);
+
+    /// The current value of the state is unknown. The next notification won't be suppressed.
+    void invalidate();
+
+    /// \return How often invalidate() was called. Tells whether the state was set from jet.
+    std::uint64_t getInvalidationCount() const
+    {
+        return m_invalidationCount;
+    }
+
+    const std::string& getPath() const
+    {
+        return m_path;
+    }
+
+    /// Is honored by the NotificationDispatcher only, publish() does not limit the rate.
+    /// \param minInterval Minimum time between two notifications. 0 for no limit.
+    void setMinInterval(std::chrono::milliseconds minInterval)
+    {
+        m_minInterval = minInterval;
+    }
+
+    std::chrono::milliseconds getMinInterval() const
+    {
+        return m_minInterval;
+    }
+
+    /// \return Time when the next notification may be published
+    std::chrono::steady_clock::time_point getEarliestPublishTime() const
+    {
+        return m_lastPublishTime + m_minInterval;
+    }
+
+    std::uint64_t getSuppressedCount() const
+    {
+        return m_suppressedCount;
+    }
+
+    /// \return Number of notifications suppressed by all states of this process
+    static std::uint64_t getTotalSuppressedCount()
+    {
+        return s_totalSuppressedCount;
+    }
+
+private:
+    hbk::jet::PeerAsync& m_peer;
+    std::string m_path;
+    bool m_announceChanges;
+    bool m_valid;
+    Json::Value m_value;
+    std::uint64_t m_suppressedCount;
+    std::uint64_t m_invalidationCount;
+    std::chrono::milliseconds m_minInterval;
+    std::chrono::steady_clock::time_point m_lastPublishTime;
+
+    static inline std::atomic < std::uint64_t > s_totalSuppressedCount = 0;
+};
+}
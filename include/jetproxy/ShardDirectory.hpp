@@ -0,0 +1,74 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "json/value.h"
+
+namespace hbk::jetproxy {
+
+/// Directory with a file for each persistent jet proxy (see ProxyRegistry::saveToDirectory()).
+///
+/// A shard has the layout of a configuration file with the entry of its jet proxy only.
+/// Jet paths are percent-encoded, "/fb/scaler1" is saved to "%2Ffb%2Fscaler1.config".
+/// Names exceeding NAME_MAX are shortened to their beginning, '~' and a hash of the complete jet path.
+/// The jet path of such a shard is taken from its content when reading it.
+class ShardDirectory
+{
+public:
+    /// A file found in the directory
+    struct Entry {
+        std::string fileName;
+        /// The jet path or only its beginning if shortened
+        std::string path;
+        /// true if the name got shortened, the complete jet path is inside the shard only
+        bool shortened = false;
+        /// true if this is the temporary file of a shard left behind by an interrupted save
+        bool tmp = false;
+    };
+
+    /// \return Name of the shard of the jet proxy with this path within directory
+    static std::string getFileName(const std::string& directory, const std::string& path);
+
+    /// Reverts getFileName()
+    /// \param name File name without directory
+    /// \param path The jet path or only its beginning if shortened
+    /// \param shortened true if the name got shortened, the complete jet path is inside the shard only
+    /// \return false if name is not the name of a shard
+    static bool decodeName(const std::string& name, std::string& path, bool& shortened);
+
+    /// \return The shards and their temporary files in directory, other files are skipped
+    /// \param ec Set if the directory could not be read
+    static std::vector < Entry > list(const std::string& directory, std::error_code& ec);
+
+    /// \param path The jet path of the shard, empty if its name got shortened. Set to the one inside the shard then.
+    /// \return The configuration of the jet proxy in the shard
+    /// \throws std::runtime_error if the shard can not be read or has no entry for the jet path
+    static Json::Value read(const std::string& directory, const std::string& fileName, std::string& path);
+};
+}
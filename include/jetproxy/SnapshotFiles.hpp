@@ -0,0 +1,106 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+
+#include "json/value.h"
+
+namespace hbk::jetproxy {
+
+struct SnapshotHeader;
+
+/// The files a ProxyRegistry saves a configuration to and the generations kept of them (see ProxyRegistry::setGenerations()).
+///
+/// A file is written to a temporary file next to it first. The temporary file is synced and renamed to the final name,
+/// older files are moved one generation up before. With more than one generation, each file starts with a SnapshotHeader
+/// that tells the latest intact generation without parsing any of them.
+class SnapshotFiles
+{
+public:
+    /// How hard a save makes sure that the written file survives a power loss
+    enum class Durability {
+        /// The file is replaced atomically but nothing is synced. A power loss might bring back the last file.
+        NONE,
+        /// The written file and its directory are synced. Nothing else is flushed.
+        FILE,
+        /// Like FILE. Additionally the whole file system is synced as ::sync() does.
+        FULL
+    };
+
+    using Writer = std::function < void(std::ostream&) >;
+
+    /// Appended to the name of a file while it is being written
+    static constexpr char TMP_SUFFIX[] = ".tmp";
+
+    /// \return Name of the file of a generation, 0 is the latest one
+    static std::string getGenerationFileName(const std::string& fileName, unsigned int generation);
+
+    /// \return Directory the file is in, "." if it has none
+    static std::string getDirectory(const std::string& fileName);
+
+    /// Executes write on stream and computes length and CRC-32C of what it wrote on the way (see ChecksumStreamBuffer)
+    /// Sets the failbit of stream if writing failed.
+    static void write(std::ostream& stream, const Writer& write, std::uint64_t& length, std::uint32_t& checksum);
+
+    /// Computes length and CRC-32C of the content of the file after offset, piece by piece
+    /// \return false if the file could not be opened
+    static bool readChecksum(const std::string& fileName, std::size_t offset, std::uint64_t& length, std::uint32_t& checksum);
+
+    /// \return Size of the SnapshotHeader, 0 if the file has none or could not be read
+    static std::size_t readHeader(const std::string& fileName, SnapshotHeader& header);
+
+    /// \return true if length and checksum of the content after the header match the header
+    static bool verify(const std::string& fileName, const SnapshotHeader& header, std::size_t headerSize);
+
+    /// \return The highest sequence found in the headers of the generations, 0 if none has a header
+    static std::uint64_t readLatestSequence(const std::string& fileName, unsigned int generations);
+
+    /// \return The file of the latest intact generation, fileName if only one generation is kept or none is intact.
+    /// If fileName is missing because a rotation got interrupted, the newest existing generation even without header
+    static std::string selectGeneration(const std::string& fileName, unsigned int generations);
+
+    /// Moves the older generations one up, the oldest is dropped, and renames the temporary file to fileName.
+    /// The temporary file has to be synced before.
+    /// \return 0 on success, -1 on error
+    static int replace(const std::string& fileName, unsigned int generations, Durability durability);
+
+    /// Syncs the file according to the durability
+    /// \return 0 on success, -1 on error
+    static int syncFile(const std::string& fileName, Durability durability);
+
+    /// Syncs the directory according to the durability. Makes the entries of created or renamed files durable.
+    /// \return 0 on success, -1 on error
+    static int syncDirectory(const std::string& directory, Durability durability);
+
+    /// Reads a configuration file in any format. A SnapshotHeader in front is skipped.
+    /// \throws std::runtime_error if the file does not exist or has no valid content
+    static Json::Value read(const std::string& fileName);
+};
+}
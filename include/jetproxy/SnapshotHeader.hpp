@@ -0,0 +1,64 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace hbk::jetproxy {
+
+/// Header in front of the configuration files of a ProxyRegistry that keeps several generations (see ProxyRegistry::setGenerations()).
+///
+/// It tells whether a file was written completely without parsing it. The header is a json comment,
+/// json files stay readable for json readers that accept comments:
+/// \code
+/// // snapshot sequence=<sequence> length=<bytes after the header> crc32c=<checksum of the bytes after the header>
+/// \endcode
+struct SnapshotHeader {
+    /// Increases with each file written
+    std::uint64_t sequence = 0;
+    std::uint64_t length = 0;
+    std::uint32_t checksum = 0;
+
+    /// Size of every header returned by create(). Numbers are padded with zeros.
+    /// A placeholder can be written in front of content of unknown size and be replaced once the content is written.
+    static const std::size_t SIZE;
+
+    /// \return The header line for content
+    static std::string create(std::uint64_t sequence, std::string_view content);
+
+    /// \return The header line for content with this length and checksum
+    static std::string create(std::uint64_t sequence, std::uint64_t length, std::uint32_t checksum);
+
+    /// \param header Filled if data starts with a header
+    /// \return Size of the header at the start of data, 0 if there is none
+    static std::size_t parse(std::string_view data, SnapshotHeader& header);
+
+    /// CRC-32C (Castagnoli). Pass the result of the previous call as crc to continue over several pieces.
+    static std::uint32_t crc32c(std::string_view data, std::uint32_t crc = 0);
+};
+}
@@ -0,0 +1,459 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "json/value.h"
+
+#include "jetproxy/CborSerializer.hpp"
+
+namespace hbk::jetproxy
+{
+    // major types
+    static const std::uint8_t UNSIGNED_INTEGER = 0;
+    static const std::uint8_t NEGATIVE_INTEGER = 1;
+    static const std::uint8_t TEXT_STRING = 3;
+    static const std::uint8_t ARRAY = 4;
+    static const std::uint8_t MAP = 5;
+    static const std::uint8_t TAG = 6;
+    static const std::uint8_t SIMPLE = 7;
+
+    static const char HEADER[] = "\xd9\xd9\xf7";
+    static const std::size_t HEADER_SIZE = sizeof(HEADER) - 1;
+
+    static const std::uint8_t SIMPLE_FALSE = 20;
+    static const std::uint8_t SIMPLE_TRUE = 21;
+    static const std::uint8_t SIMPLE_NULL = 22;
+    static const std::uint8_t SIMPLE_UNDEFINED = 23;
+    static const std::uint8_t HALF_FLOAT = 25;
+    static const std::uint8_t SINGLE_FLOAT = 26;
+    static const std::uint8_t DOUBLE_FLOAT = 27;
+
+    /// Limits recursion on malformed input
+    static const unsigned int MAX_DEPTH = 1000;
+
+    static void appendBigEndian(std::uint64_t value, unsigned int size, std::string& result)
+    {
+        for (unsigned int index = size; index > 0; --index) {
+            result += static_cast < char >((value >> ((index - 1) * 8)) & 0xff);
+        }
+    }
+
+    /// Initial byte with the argument in the shortest form
+    static void appendHead(std::uint8_t majorType, std::uint64_t argument, std::string& result)
+    {
+        const std::uint8_t type = static_cast < std::uint8_t >(majorType << 5);
+        if (argument < 24) {
+            result += static_cast < char >(type | argument);
+        } else if (argument <= std::numeric_limits < std::uint8_t >::max()) {
+            result += static_cast < char >(type | 24);
+            appendBigEndian(argument, 1, result);
+        } else if (argument <= std::numeric_limits < std::uint16_t >::max()) {
+            result += static_cast < char >(type | 25);
+            appendBigEndian(argument, 2, result);
+        } else if (argument <= std::numeric_limits < std::uint32_t >::max()) {
+            result += static_cast < char >(type | 26);
+            appendBigEndian(argument, 4, result);
+        } else {
+            result += static_cast < char >(type | 27);
+            appendBigEndian(argument, 8, result);
+        }
+    }
+
+    static void appendReal(double value, std::string& result)
+    {
+        const float single = static_cast < float >(value);
+        if ((static_cast < double >(single) == value) || (value != value)) {
+            std::uint32_t bits;
+            std::memcpy(&bits, &single, sizeof(bits));
+            result += static_cast < char >((SIMPLE << 5) | SINGLE_FLOAT);
+            appendBigEndian(bits, 4, result);
+        } else {
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            result += static_cast < char >((SIMPLE << 5) | DOUBLE_FLOAT);
+            appendBigEndian(bits, 8, result);
+        }
+    }
+
+    static void encodeValue(const Json::Value& value, std::string& result)
+    {
+        switch (value.type()) {
+        case Json::nullValue:
+            result += static_cast < char >((SIMPLE << 5) | SIMPLE_NULL);
+            break;
+        case Json::booleanValue:
+            result += static_cast < char >((SIMPLE << 5) | (value.asBool() ? SIMPLE_TRUE : SIMPLE_FALSE));
+            break;
+        case Json::intValue:
+        {
+            const Json::Int64 number = value.asInt64();
+            if (number < 0) {
+                // -1 - n is encoded as n
+                appendHead(NEGATIVE_INTEGER, static_cast < std::uint64_t >(-(number + 1)), result);
+            } else {
+                appendHead(UNSIGNED_INTEGER, static_cast < std::uint64_t >(number), result);
+            }
+            break;
+        }
+        case Json::uintValue:
+            appendHead(UNSIGNED_INTEGER, value.asUInt64(), result);
+            break;
+        case Json::realValue:
+            appendReal(value.asDouble(), result);
+            break;
+        case Json::stringValue:
+        {
+            const char* begin;
+            const char* end;
+            value.getString(&begin, &end);
+            CborSerializer::encodeString(std::string_view(begin, static_cast < std::size_t >(end - begin)), result);
+            break;
+        }
+        case Json::arrayValue:
+            appendHead(ARRAY, value.size(), result);
+            for (const auto& element : value) {
+                encodeValue(element, result);
+            }
+            break;
+        case Json::objectValue:
+            appendHead(MAP, value.size(), result);
+            for (Json::Value::const_iterator it = value.begin(); it != value.end(); ++it) {
+                const char* end;
+                const char* begin = it.memberName(&end);
+                CborSerializer::encodeString(std::string_view(begin, static_cast < std::size_t >(end - begin)), result);
+                encodeValue(*it, result);
+            }
+            break;
+        }
+    }
+
+    /// Reads one item after the other from a buffer
+    class CborSerializer::Decoder
+    {
+    public:
+        explicit Decoder(std::string_view data)
+            : m_data(data)
+        {
+        }
+
+        Json::Value decodeItem(unsigned int depth)
+        {
+            if (depth > MAX_DEPTH) {
+                throw std::runtime_error("CBOR nesting too deep");
+            }
+            const std::uint8_t initial = readByte();
+            const std::uint8_t majorType = static_cast < std::uint8_t >(initial >> 5);
+            const std::uint8_t additional = initial & 0x1f;
+
+            if (majorType == SIMPLE) {
+                return decodeSimple(additional);
+            }
+            const std::uint64_t argument = readArgument(additional);
+            switch (majorType) {
+            case UNSIGNED_INTEGER:
+                if (argument <= static_cast < std::uint64_t >(std::numeric_limits < Json::Int64 >::max())) {
+                    // the json reader does the same for positive numbers
+                    return Json::Value(static_cast < Json::Int64 >(argument));
+                }
+                return Json::Value(static_cast < Json::UInt64 >(argument));
+            case NEGATIVE_INTEGER:
+                if (argument > static_cast < std::uint64_t >(std::numeric_limits < Json::Int64 >::max())) {
+                    throw std::runtime_error("CBOR negative integer out of range");
+                }
+                return Json::Value(-1 - static_cast < Json::Int64 >(argument));
+            case TEXT_STRING:
+            {
+                const std::string_view text = readBytes(argument);
+                return Json::Value(text.data(), text.data() + text.size());
+            }
+            case ARRAY:
+            {
+                checkRemaining(argument);
+                Json::Value array(Json::arrayValue);
+                for (std::uint64_t index = 0; index < argument; ++index) {
+                    array.append(decodeItem(depth + 1));
+                }
+                return array;
+            }
+            case MAP:
+            {
+                checkRemaining(argument);
+                Json::Value object(Json::objectValue);
+                for (std::uint64_t index = 0; index < argument; ++index) {
+                    const std::string_view key = readKey();
+                    object[std::string(key)] = decodeItem(depth + 1);
+                }
+                return object;
+            }
+            case TAG:
+                // the self-describe tag and unknown tags do not change the content
+                return decodeItem(depth + 1);
+            default:
+                // byte strings
+                throw std::runtime_error("CBOR byte strings are not supported");
+            }
+        }
+
+        /// Same checks as decodeItem() without building the value
+        void skipItem(unsigned int depth)
+        {
+            if (depth > MAX_DEPTH) {
+                throw std::runtime_error("CBOR nesting too deep");
+            }
+            const std::uint8_t initial = readByte();
+            const std::uint8_t majorType = static_cast < std::uint8_t >(initial >> 5);
+            const std::uint8_t additional = initial & 0x1f;
+
+            if (majorType == SIMPLE) {
+                decodeSimple(additional);
+                return;
+            }
+            const std::uint64_t argument = readArgument(additional);
+            switch (majorType) {
+            case UNSIGNED_INTEGER:
+                break;
+            case NEGATIVE_INTEGER:
+                if (argument > static_cast < std::uint64_t >(std::numeric_limits < Json::Int64 >::max())) {
+                    throw std::runtime_error("CBOR negative integer out of range");
+                }
+                break;
+            case TEXT_STRING:
+                readBytes(argument);
+                break;
+            case ARRAY:
+                checkRemaining(argument);
+                for (std::uint64_t index = 0; index < argument; ++index) {
+                    skipItem(depth + 1);
+                }
+                break;
+            case MAP:
+                checkRemaining(argument);
+                for (std::uint64_t index = 0; index < argument; ++index) {
+                    readKey();
+                    skipItem(depth + 1);
+                }
+                break;
+            case TAG:
+                skipItem(depth + 1);
+                break;
+            default:
+                throw std::runtime_error("CBOR byte strings are not supported");
+            }
+        }
+
+        void readMembers(const MemberCallback& callback)
+        {
+            std::uint8_t initial = readByte();
+            while ((initial >> 5) == TAG) {
+                readArgument(initial & 0x1f);
+                initial = readByte();
+            }
+            if ((initial >> 5) != MAP) {
+                throw std::runtime_error("CBOR document is no map");
+            }
+            const std::uint64_t size = readArgument(initial & 0x1f);
+            checkRemaining(size);
+            for (std::uint64_t index = 0; index < size; ++index) {
+                const std::string_view key = readKey();
+                const std::size_t begin = m_position;
+                skipItem(1);
+                callback(key, m_data.substr(begin, m_position - begin));
+            }
+        }
+
+        bool atEnd() const
+        {
+            return m_position == m_data.size();
+        }
+
+    private:
+        std::uint8_t readByte()
+        {
+            if (m_position >= m_data.size()) {
+                throw std::runtime_error("CBOR document is truncated");
+            }
+            return static_cast < std::uint8_t >(m_data[m_position++]);
+        }
+
+        std::string_view readKey()
+        {
+            const std::uint8_t initial = readByte();
+            if ((initial >> 5) != TEXT_STRING) {
+                throw std::runtime_error("CBOR map key is not a text string");
+            }
+            return readBytes(readArgument(initial & 0x1f));
+        }
+
+        std::uint64_t readBigEndian(unsigned int size)
+        {
+            std::uint64_t value = 0;
+            for (unsigned int index = 0; index < size; ++index) {
+                value = (value << 8) | readByte();
+            }
+            return value;
+        }
+
+        std::uint64_t readArgument(std::uint8_t additional)
+        {
+            if (additional < 24) {
+                return additional;
+            }
+            switch (additional) {
+            case 24:
+                return readBigEndian(1);
+            case 25:
+                return readBigEndian(2);
+            case 26:
+                return readBigEndian(4);
+            case 27:
+                return readBigEndian(8);
+            default:
+                throw std::runtime_error("CBOR indefinite length is not supported");
+            }
+        }
+
+        std::string_view readBytes(std::uint64_t size)
+        {
+            checkRemaining(size);
+            const std::string_view bytes = m_data.substr(m_position, static_cast < std::size_t >(size));
+            m_position += static_cast < std::size_t >(size);
+            return bytes;
+        }
+
+        /// Each element takes at least one byte. Avoids huge allocations on malformed sizes.
+        void checkRemaining(std::uint64_t size) const
+        {
+            if (size > m_data.size() - m_position) {
+                throw std::runtime_error("CBOR document is truncated");
+            }
+        }
+
+        Json::Value decodeSimple(std::uint8_t additional)
+        {
+            switch (additional) {
+            case SIMPLE_FALSE:
+                return Json::Value(false);
+            case SIMPLE_TRUE:
+                return Json::Value(true);
+            case SIMPLE_NULL:
+            case SIMPLE_UNDEFINED:
+                return Json::Value();
+            case HALF_FLOAT:
+                return Json::Value(decodeHalf(static_cast < std::uint16_t >(readBigEndian(2))));
+            case SINGLE_FLOAT:
+            {
+                const std::uint32_t bits = static_cast < std::uint32_t >(readBigEndian(4));
+                float value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return Json::Value(static_cast < double >(value));
+            }
+            case DOUBLE_FLOAT:
+            {
+                const std::uint64_t bits = readBigEndian(8);
+                double value;
+                std::memcpy(&value, &bits, sizeof(value));
+                return Json::Value(value);
+            }
+            default:
+                throw std::runtime_error("CBOR simple value is not supported");
+            }
+        }
+
+        static double decodeHalf(std::uint16_t half)
+        {
+            const int exponent = (half >> 10) & 0x1f;
+            const int mantissa = half & 0x3ff;
+            double value;
+            if (exponent == 0) {
+                value = std::ldexp(mantissa, -24);
+            } else if (exponent != 31) {
+                value = std::ldexp(mantissa + 1024, exponent - 25);
+            } else if (mantissa == 0) {
+                value = std::numeric_limits < double >::infinity();
+            } else {
+                value = std::numeric_limits < double >::quiet_NaN();
+            }
+            return (half & 0x8000) ? -value : value;
+        }
+
+        std::string_view m_data;
+        std::size_t m_position = 0;
+    };
+
+    void CborSerializer::encode(const Json::Value& value, std::string& result, bool withHeader)
+    {
+        if (withHeader) {
+            encodeHeader(result);
+        }
+        encodeValue(value, result);
+    }
+
+    void CborSerializer::encodeHeader(std::string& result)
+    {
+        result.append(HEADER, HEADER_SIZE);
+    }
+
+    void CborSerializer::encodeMapHeader(std::size_t size, std::string& result)
+    {
+        appendHead(MAP, size, result);
+    }
+
+    void CborSerializer::encodeString(std::string_view text, std::string& result)
+    {
+        appendHead(TEXT_STRING, text.size(), result);
+        result.append(text.data(), text.size());
+    }
+
+    Json::Value CborSerializer::decode(std::string_view data)
+    {
+        Decoder decoder(data);
+        Json::Value value = decoder.decodeItem(0);
+        if (!decoder.atEnd()) {
+            throw std::runtime_error("CBOR document has trailing data");
+        }
+        return value;
+    }
+
+    void CborSerializer::forEachMember(std::string_view data, const MemberCallback& callback)
+    {
+        Decoder decoder(data);
+        decoder.readMembers(callback);
+        if (!decoder.atEnd()) {
+            throw std::runtime_error("CBOR document has trailing data");
+        }
+    }
+
+    bool CborSerializer::hasHeader(std::string_view data)
+    {
+        return data.substr(0, HEADER_SIZE) == std::string_view(HEADER, HEADER_SIZE);
+    }
+}
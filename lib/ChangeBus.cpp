@@ -0,0 +1,82 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+
+#include "jetproxy/ChangeBus.hpp"
+
+namespace hbk::jetproxy
+{
+    ChangeBus::ChangeBus()
+        : m_lastId(0)
+        , m_count(0)
+    {
+    }
+
+    ChangeBus& ChangeBus::getDefault()
+    {
+        static ChangeBus bus;
+        return bus;
+    }
+
+    ChangeBus::SubscriptionId ChangeBus::subscribe(const std::string& prefix, Listener listener)
+    {
+        std::unique_lock < std::shared_mutex > lock(m_mutex);
+        const SubscriptionId id = ++m_lastId;
+        m_subscriptions[id] = Subscription{prefix, std::move(listener)};
+        m_count = m_subscriptions.size();
+        return id;
+    }
+
+    void ChangeBus::unsubscribe(SubscriptionId id)
+    {
+        std::unique_lock < std::shared_mutex > lock(m_mutex);
+        m_subscriptions.erase(id);
+        m_count = m_subscriptions.size();
+    }
+
+    void ChangeBus::announce(const std::string& path) const
+    {
+        if (m_count == 0) {
+            return;
+        }
+        std::shared_lock < std::shared_mutex > lock(m_mutex);
+        for (const auto& iter : m_subscriptions) {
+            const Subscription& subscription = iter.second;
+            if (path.compare(0, subscription.prefix.size(), subscription.prefix) == 0) {
+                subscription.listener(path);
+            }
+        }
+    }
+
+    std::size_t ChangeBus::getSubscriptionCount() const
+    {
+        return m_count;
+    }
+}
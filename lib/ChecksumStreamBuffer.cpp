@@ -0,0 +1,83 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <streambuf>
+#include <string_view>
+
+#include "jetproxy/ChecksumStreamBuffer.hpp"
+#include "jetproxy/SnapshotHeader.hpp"
+
+namespace hbk::jetproxy {
+
+    ChecksumStreamBuffer::ChecksumStreamBuffer(std::streambuf& target)
+        : m_target(target)
+        , m_buffer()
+        , m_length(0)
+        , m_checksum(0)
+    {
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+    }
+
+    ChecksumStreamBuffer::~ChecksumStreamBuffer()
+    {
+        passOn();
+    }
+
+    ChecksumStreamBuffer::int_type ChecksumStreamBuffer::overflow(int_type character)
+    {
+        if (!passOn()) {
+            return traits_type::eof();
+        }
+        if (traits_type::eq_int_type(character, traits_type::eof())) {
+            return traits_type::not_eof(character);
+        }
+        *pptr() = traits_type::to_char_type(character);
+        pbump(1);
+        return character;
+    }
+
+    int ChecksumStreamBuffer::sync()
+    {
+        if (!passOn()) {
+            return -1;
+        }
+        return m_target.pubsync();
+    }
+
+    bool ChecksumStreamBuffer::passOn()
+    {
+        const std::streamsize count = pptr() - pbase();
+        if (count == 0) {
+            return true;
+        }
+        m_checksum = SnapshotHeader::crc32c(std::string_view(pbase(), static_cast < std::size_t >(count)), m_checksum);
+        m_length += static_cast < std::uint64_t >(count);
+        const std::streamsize passed = m_target.sputn(pbase(), count);
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+        return passed == count;
+    }
+}
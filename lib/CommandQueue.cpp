@@ -0,0 +1,268 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "hbk/sys/eventloop.h"
+#include "hbk/sys/notifier.h"
+#include "jet/peerasync.hpp"
+
+#include "jetproxy/CommandQueue.hpp"
+#include "jetproxy/NotificationDispatcher.hpp"
+
+namespace hbk::jetproxy
+{
+    std::shared_mutex CommandQueue::s_commandQueuesMutex;
+    CommandQueue::CommandQueues CommandQueue::s_commandQueues;
+    // starts above the generation of an empty cache
+    std::atomic < std::uint64_t > CommandQueue::s_commandQueuesGeneration(1);
+
+    CommandQueue::CommandQueue(hbk::sys::EventLoop& eventloop, hbk::jet::PeerAsync& peer)
+        : m_peer(peer)
+        , m_notifier(eventloop)
+        , m_head(&m_stub)
+        , m_tail(&m_stub)
+        , m_stub{nullptr, Command()}
+        , m_wakeUpPending(false)
+        , m_consumerThread(std::thread::id())
+        , m_executing(false)
+        , m_executedCount(0)
+        , m_deferredNotifier(eventloop)
+    {
+        {
+            std::unique_lock < std::shared_mutex > lock(s_commandQueuesMutex);
+            if (s_commandQueues.find(&m_peer) != s_commandQueues.end()) {
+                throw std::runtime_error("Could not create command queue. There is one for this jet peer already!");
+            }
+            s_commandQueues[&m_peer] = this;
+            s_commandQueuesGeneration.fetch_add(1, std::memory_order_release);
+        }
+        m_notifier.set(std::bind(&CommandQueue::executeHandler, this));
+        m_deferredNotifier.set(std::bind(&CommandQueue::executeDeferredHandler, this));
+    }
+
+    CommandQueue::~CommandQueue()
+    {
+        {
+            std::unique_lock < std::shared_mutex > lock(s_commandQueuesMutex);
+            s_commandQueues.erase(&m_peer);
+            s_commandQueuesGeneration.fetch_add(1, std::memory_order_release);
+        }
+        m_consumerThread = std::this_thread::get_id();
+        do {
+            execute();
+        } while (executeDeferred());
+    }
+
+    CommandQueue* CommandQueue::get(const hbk::jet::PeerAsync& peer)
+    {
+        // command queues are created and destroyed rarely, looking them up must not touch a mutex shared by all threads
+        thread_local CachedCommandQueues cached;
+        const std::uint64_t generation = s_commandQueuesGeneration.load(std::memory_order_acquire);
+        if (cached.generation != generation) {
+            cached.commandQueues.clear();
+            cached.generation = generation;
+        }
+        const auto cachedIter = cached.commandQueues.find(&peer);
+        if (cachedIter != cached.commandQueues.end()) {
+            return cachedIter->second;
+        }
+
+        CommandQueue* commandQueue = nullptr;
+        {
+            std::shared_lock < std::shared_mutex > lock(s_commandQueuesMutex);
+            const auto iter = s_commandQueues.find(&peer);
+            if (iter != s_commandQueues.end()) {
+                commandQueue = iter->second;
+            }
+        }
+        // a change since generation was loaded drops the cache on the next call
+        cached.commandQueues.emplace(&peer, commandQueue);
+        return commandQueue;
+    }
+
+    void CommandQueue::post(Command command)
+    {
+        push(new Node{nullptr, std::move(command)});
+        if (!m_wakeUpPending.exchange(true)) {
+            m_notifier.notify();
+        }
+    }
+
+    void CommandQueue::dispatch(Command command)
+    {
+        if (isEventLoopThread()) {
+            command();
+            ++m_executedCount;
+            return;
+        }
+        post(std::move(command));
+    }
+
+    void CommandQueue::defer(Command command)
+    {
+        bool wakeUp;
+        {
+            std::lock_guard < std::mutex > lock(m_deferredCommandsMutex);
+            wakeUp = m_deferredCommands.empty();
+            m_deferredCommands.push_back(std::move(command));
+        }
+        if (wakeUp) {
+            m_deferredNotifier.notify();
+        }
+    }
+
+    bool CommandQueue::isEventLoopThread() const
+    {
+        return m_consumerThread.load() == std::this_thread::get_id();
+    }
+
+    bool CommandQueue::isExecuting() const
+    {
+        return m_executing;
+    }
+
+    bool CommandQueue::executeForThisThread()
+    {
+        std::vector < CommandQueue* > commandQueues;
+        {
+            std::shared_lock < std::shared_mutex > lock(s_commandQueuesMutex);
+            for (const auto& iter : s_commandQueues) {
+                if (iter.second->isEventLoopThread()) {
+                    commandQueues.push_back(iter.second);
+                }
+            }
+        }
+        // without the lock, commands look up command queues themselves
+        for (auto* commandQueue : commandQueues) {
+            commandQueue->execute();
+        }
+        return !commandQueues.empty();
+    }
+
+    void CommandQueue::push(Node* node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+        // between exchange and store the queue is not linked. The consumer stops at previous until then.
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    CommandQueue::Node* CommandQueue::pop()
+    {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &m_stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            m_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next) {
+            m_tail = next;
+            return tail;
+        }
+        if (tail != m_head.load(std::memory_order_acquire)) {
+            // a producer did not finish appending
+            return nullptr;
+        }
+        // tail is the last node. Append the stub to be able to take it.
+        push(&m_stub);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            m_tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    void CommandQueue::executeHandler()
+    {
+        m_consumerThread = std::this_thread::get_id();
+        // commands posted from now on wake up the event loop again
+        m_wakeUpPending = false;
+        m_executing = true;
+        execute();
+        m_executing = false;
+    }
+
+    void CommandQueue::execute()
+    {
+        std::optional < NotificationDispatcher::Batch > batch;
+        NotificationDispatcher* dispatcher = NotificationDispatcher::get(m_peer);
+        if (dispatcher) {
+            batch.emplace(*dispatcher);
+        }
+
+        while (Node* node = pop()) {
+            std::unique_ptr < Node > command(node);
+            command->command();
+            ++m_executedCount;
+        }
+    }
+
+    void CommandQueue::executeDeferredHandler()
+    {
+        m_consumerThread = std::this_thread::get_id();
+        m_executing = true;
+        executeDeferred();
+        m_executing = false;
+    }
+
+    bool CommandQueue::executeDeferred()
+    {
+        std::vector < Command > commands;
+        {
+            std::lock_guard < std::mutex > lock(m_deferredCommandsMutex);
+            commands.swap(m_deferredCommands);
+        }
+        if (commands.empty()) {
+            return false;
+        }
+
+        std::optional < NotificationDispatcher::Batch > batch;
+        NotificationDispatcher* dispatcher = NotificationDispatcher::get(m_peer);
+        if (dispatcher) {
+            batch.emplace(*dispatcher);
+        }
+        // commands deferred by these are executed in the next iteration
+        for (auto& command : commands) {
+            command();
+            ++m_executedCount;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,259 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "json/reader.h"
+#include "json/value.h"
+
+#include "jetproxy/CborSerializer.hpp"
+#include "jetproxy/ConfigIndex.hpp"
+#include "jetproxy/SnapshotHeader.hpp"
+
+namespace hbk::jetproxy {
+
+    /// Skips white space and comments, the json reader allows both
+    static std::size_t skipWhitespace(std::string_view data, std::size_t position)
+    {
+        while (position < data.size()) {
+            const char character = data[position];
+            if ((character == ' ') || (character == '\t') || (character == '\n') || (character == '\r')) {
+                ++position;
+            } else if ((character == '/') && (data.substr(position, 2) == "//")) {
+                position = data.find('\n', position);
+                if (position == std::string_view::npos) {
+                    return data.size();
+                }
+            } else if ((character == '/') && (data.substr(position, 2) == "/*")) {
+                position = data.find("*/", position + 2);
+                if (position == std::string_view::npos) {
+                    throw std::runtime_error("unterminated comment");
+                }
+                position += 2;
+            } else {
+                break;
+            }
+        }
+        return position;
+    }
+
+    /// \param position Of the opening quote
+    /// \return Position after the closing quote
+    static std::size_t skipString(std::string_view data, std::size_t position)
+    {
+        for (++position; position < data.size(); ++position) {
+            if (data[position] == '\\') {
+                ++position;
+            } else if (data[position] == '"') {
+                return position + 1;
+            }
+        }
+        throw std::runtime_error("unterminated string");
+    }
+
+    /// Finds the end of a value by matching brackets. The value itself is checked when being parsed.
+    /// \return Position of the ',' or closing bracket after the value
+    static std::size_t skipValue(std::string_view data, std::size_t position)
+    {
+        std::size_t depth = 0;
+        while (position < data.size()) {
+            const char character = data[position];
+            if (character == '"') {
+                position = skipString(data, position);
+            } else if ((character == '{') || (character == '[')) {
+                ++depth;
+                ++position;
+            } else if ((character == '}') || (character == ']')) {
+                if (depth == 0) {
+                    return position;
+                }
+                --depth;
+                ++position;
+            } else if ((character == ',') && (depth == 0)) {
+                return position;
+            } else if (character == '/') {
+                const std::size_t next = skipWhitespace(data, position);
+                position = (next == position) ? position + 1 : next;
+            } else {
+                ++position;
+            }
+        }
+        throw std::runtime_error("unexpected end of file");
+    }
+
+    static Json::Value parseJson(std::string_view text)
+    {
+        Json::CharReaderBuilder builder;
+        std::unique_ptr < Json::CharReader > reader(builder.newCharReader());
+        Json::Value value;
+        std::string errors;
+        if (!reader->parse(text.data(), text.data() + text.size(), &value, &errors)) {
+            throw std::runtime_error(errors);
+        }
+        return value;
+    }
+
+    ConfigIndex::ConfigIndex(const std::string& fileName)
+        : m_fileName(fileName)
+        , m_mapping(nullptr)
+        , m_mappingSize(0)
+        , m_cbor(false)
+    {
+        const int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("could not open file '" + fileName + "' for reading");
+        }
+        struct stat status;
+        if (::fstat(fd, &status) < 0) {
+            ::close(fd);
+            throw std::runtime_error("could not open file '" + fileName + "' for reading");
+        }
+        if (status.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("Json file '" + fileName + "': Empty file for reading");
+        }
+        m_mappingSize = static_cast < std::size_t >(status.st_size);
+        m_mapping = ::mmap(nullptr, m_mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (m_mapping == MAP_FAILED) {
+            throw std::runtime_error("could not map file '" + fileName + "'");
+        }
+
+        m_content = std::string_view(static_cast < const char* >(m_mapping), m_mappingSize);
+        SnapshotHeader header;
+        m_content.remove_prefix(SnapshotHeader::parse(m_content, header));
+        m_cbor = CborSerializer::hasHeader(m_content);
+        try {
+            if (m_cbor) {
+                indexCbor(m_content);
+            } else {
+                indexJson(m_content);
+            }
+        } catch (const std::runtime_error& e) {
+            ::munmap(m_mapping, m_mappingSize);
+            throw std::runtime_error((m_cbor ? "CBOR file '" : "Json file '") + fileName + "' has invalid content: " + e.what());
+        }
+    }
+
+    ConfigIndex::~ConfigIndex()
+    {
+        ::munmap(m_mapping, m_mappingSize);
+    }
+
+    void ConfigIndex::indexJson(std::string_view data)
+    {
+        std::size_t position = skipWhitespace(data, 0);
+        if ((position == data.size()) || (data[position] != '{')) {
+            throw std::runtime_error("Not an object");
+        }
+        position = skipWhitespace(data, position + 1);
+        if ((position < data.size()) && (data[position] == '}')) {
+            return;
+        }
+        while (true) {
+            if ((position == data.size()) || (data[position] != '"')) {
+                throw std::runtime_error("member name expected");
+            }
+            const std::size_t keyEnd = skipString(data, position);
+            const std::string_view quotedKey = data.substr(position, keyEnd - position);
+            std::string key;
+            if (quotedKey.find('\\') == std::string_view::npos) {
+                key = quotedKey.substr(1, quotedKey.size() - 2);
+            } else {
+                key = parseJson(quotedKey).asString();
+            }
+
+            position = skipWhitespace(data, keyEnd);
+            if ((position == data.size()) || (data[position] != ':')) {
+                throw std::runtime_error("':' expected after member name");
+            }
+            position = skipWhitespace(data, position + 1);
+            const std::size_t valueBegin = position;
+            position = skipValue(data, position);
+            // the last one wins, as with the json reader
+            m_entries[key] = Entry { valueBegin, position - valueBegin };
+
+            if (data[position] == '}') {
+                return;
+            }
+            if (data[position] != ',') {
+                throw std::runtime_error("',' or '}' expected after member");
+            }
+            position = skipWhitespace(data, position + 1);
+        }
+    }
+
+    void ConfigIndex::indexCbor(std::string_view data)
+    {
+        CborSerializer::forEachMember(data, [this, data](std::string_view key, std::string_view value) {
+            m_entries[std::string(key)] = Entry { static_cast < std::size_t >(value.data() - data.data()), value.size() };
+        });
+    }
+
+    bool ConfigIndex::contains(const std::string& path) const
+    {
+        return m_entries.find(path) != m_entries.end();
+    }
+
+    Json::Value ConfigIndex::find(const std::string& path) const
+    {
+        const auto iter = m_entries.find(path);
+        if (iter == m_entries.end()) {
+            return Json::Value();
+        }
+        const std::string_view value = m_content.substr(iter->second.offset, iter->second.size);
+        try {
+            if (m_cbor) {
+                return CborSerializer::decode(value);
+            }
+            return parseJson(value);
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error((m_cbor ? "CBOR file '" : "Json file '") + m_fileName + "' has invalid content for '" + path + "': " + e.what());
+        }
+    }
+
+    std::vector < std::string > ConfigIndex::getPaths() const
+    {
+        std::vector < std::string > paths;
+        paths.reserve(m_entries.size());
+        for (const auto& entry : m_entries) {
+            paths.emplace_back(entry.first);
+        }
+        return paths;
+    }
+
+    std::size_t ConfigIndex::size() const
+    {
+        return m_entries.size();
+    }
+}
@@ -22,7 +22,12 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <algorithm>
 #include <chrono>
+#include <functional>
+#include <cstdint>
+#include <future>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <syslog.h>
@@ -30,9 +35,12 @@
 #include "json/value.h"
 
 #include "hbk/sys/eventloop.h"
+#include "hbk/sys/notifier.h"
 #include "hbk/sys/timer.h"
+#include "jetproxy/ChangeBus.hpp"
 #include "jetproxy/DelayedSaver.hpp"
 #include "jetproxy/JetProxy.hpp"
+#include "jetproxy/ProxyRegistry.hpp"
 #include "jet/defines.h"
 #include "jet/peerasync.hpp"
 
@@ -40,12 +48,20 @@
 
 namespace hbk::jetproxy {
     
-    DelayedSaver::DelayedSaver(hbk::sys::EventLoop& eventloop, hbk::jet::PeerAsync& peer)
+    DelayedSaver::DelayedSaver(hbk::sys::EventLoop& eventloop, hbk::jet::PeerAsync& peer, ProxyRegistry& registry)
         : m_doSaveOnChange(false)
+        , m_source(Source::Fetch)
         , m_delay(std::chrono::milliseconds(3000))
+        , m_maxDelay(std::chrono::milliseconds(0))
         , m_peer(peer)
+        , m_registry(registry)
         , m_delayedSaveTimer(eventloop)
+        , m_localChangesNotifier(eventloop)
+        , m_compactionSize(0)
+        , m_async(false)
+        , m_sharded(false)
     {
+        m_localChangesNotifier.set(std::bind(&DelayedSaver::localChangesHandler, this));
     }
     
     DelayedSaver::~DelayedSaver()
@@ -53,15 +69,120 @@ namespace hbk::jetproxy {
         stop();
     }
     
+    void DelayedSaver::logSaveDurations(const ProxyRegistry::SaveDurations& durations)
+    {
+        if (durations.skipped) {
+            syslog(LOG_DEBUG, "Configuration unchanged, nothing written");
+            return;
+        }
+        syslog(LOG_DEBUG, "Configuration saved: compose %lldus, write %lldus, sync %lldus, rename %lldus",
+               static_cast < long long >(durations.compose.count()),
+               static_cast < long long >(durations.write.count()),
+               static_cast < long long >(durations.syncFile.count()),
+               static_cast < long long >(durations.rename.count()));
+    }
+
     void DelayedSaver::saveDelayedHandler(bool fired) {
         if (!fired) {
             syslog(LOG_INFO, "Saving current configuration before shutting down...");
         } else {
             syslog(LOG_INFO, "Saving current configuration...");
         }
-        JetProxy::saveAllToFile(m_configFile);
+        std::vector < std::string > changedPaths;
+        {
+            std::lock_guard < std::mutex > lock(m_changedPathsMutex);
+            if (!m_changedPaths.empty()) {
+                const auto pending = std::chrono::duration_cast < std::chrono::milliseconds >(std::chrono::steady_clock::now() - m_pendingSince);
+                syslog(LOG_DEBUG, "Saving %zu changes pending for %lldms", m_changedPaths.size(), static_cast < long long >(pending.count()));
+            }
+            changedPaths.assign(m_changedPaths.begin(), m_changedPaths.end());
+            m_changedPaths.clear();
+        }
+        if (m_sharded) {
+            if (m_registry.saveToDirectory(m_configFile) == 0) {
+                logSaveDurations(m_registry.getLastSaveDurations());
+            }
+            return;
+        }
+        if (m_compactionSize == 0) {
+            if ((fired) && (m_async)) {
+                m_registry.saveToFileAsync(m_configFile, [](int result, const ProxyRegistry::SaveDurations& durations) {
+                    if (result == 0) {
+                        logSaveDurations(durations);
+                    }
+                });
+            } else if (m_registry.saveToFile(m_configFile) == 0) {
+                logSaveDurations(m_registry.getLastSaveDurations());
+            }
+            return;
+        }
+
+        if (changedPaths.empty()) {
+            return;
+        }
+        m_registry.appendToJournal(m_configFile, changedPaths);
+
+        if ((!fired) || (ProxyRegistry::getJournalSize(m_configFile) < m_compactionSize)) {
+            // when shutting down, the journal is replayed on next restore
+            return;
+        }
+        if ((m_compaction.valid()) && (m_compaction.wait_for(std::chrono::seconds(0)) != std::future_status::ready)) {
+            // still busy with the last compaction
+            return;
+        }
+        m_compaction = std::async(std::launch::async, [&registry = m_registry, configFile = m_configFile]() {
+            return registry.compactJournal(configFile);
+        });
     }
     
+    void DelayedSaver::record(const std::string& path)
+    {
+        std::lock_guard < std::mutex > lock(m_changedPathsMutex);
+        if (m_changedPaths.empty()) {
+            m_pendingSince = std::chrono::steady_clock::now();
+        }
+        m_changedPaths.insert(path);
+    }
+
+    void DelayedSaver::arm()
+    {
+        if (!m_doSaveOnChange) {
+            return;
+        }
+        std::chrono::milliseconds delay = m_delay;
+        if (m_maxDelay.count() > 0) {
+            // do not postpone beyond the deadline of the oldest pending change
+            std::lock_guard < std::mutex > lock(m_changedPathsMutex);
+            const auto remaining = std::chrono::duration_cast < std::chrono::milliseconds >(m_pendingSince + m_maxDelay - std::chrono::steady_clock::now());
+            delay = std::max(std::chrono::milliseconds(0), std::min(delay, remaining));
+        }
+        auto timeoutCb = [this](bool fired) {
+            saveDelayedHandler(fired);
+        };
+        m_delayedSaveTimer.set(delay, false, timeoutCb);
+    }
+
+    void DelayedSaver::localChangesHandler()
+    {
+        std::set < std::string > announcedPaths;
+        {
+            std::lock_guard < std::mutex > lock(m_changedPathsMutex);
+            announcedPaths.swap(m_announcedPaths);
+        }
+        bool changed = false;
+        for (const auto& path : announcedPaths) {
+            // states of sub objects belong to the jet proxy above
+            const JetProxy* owner = m_registry.findOwner(path);
+            if ((owner) && (owner->isPersistent())) {
+                record(path);
+                changed = true;
+            }
+        }
+        if (changed) {
+            arm();
+        }
+    }
+
     /// @param one or more fetch conditions that acivate the delayed save mechanism.
     int DelayedSaver::start(const Matchers& matchers, const std::string &configFile)
     {
@@ -74,6 +195,15 @@ namespace hbk::jetproxy {
             syslog(LOG_ERR, "Can not start delayed saver without a config file name");
             return -1;
         }
+
+        if (m_source == Source::Local) {
+            for (const auto& matcher : matchers) {
+                if ((!matcher.endsWith.empty()) || (!matcher.equalsNot.empty()) || (!matcher.containsAllOf.empty()) || (matcher.caseInsensitive)) {
+                    syslog(LOG_ERR, "Can not start delayed saver with local source. Matchers support startsWith, equals and contains only");
+                    return -1;
+                }
+            }
+        }
         
         m_configFile = configFile;
         
@@ -94,15 +224,43 @@ namespace hbk::jetproxy {
                     if (!persistent) {
                         return;
                     }
-                    auto timeoutCb = [this](bool fired) {
-                      saveDelayedHandler(fired);
-                    };
-                    m_delayedSaveTimer.set(m_delay, false, timeoutCb);
+                    record(notification[hbk::jet::PATH].asString());
+                    arm();
                 }
             }  catch (...) {
             }
         };
         
+        if (m_source == Source::Local) {
+            for (const auto& matcher : matchers) {
+                const std::string& prefix = matcher.equals.empty() ? matcher.startsWith : matcher.equals;
+                m_subscriptions.push_back(ChangeBus::getDefault().subscribe(prefix, [this, matcher](const std::string& path) {
+                    // Called from the thread that changed the state. Persistence is checked in our event loop.
+                    if (m_registry.isRestoring(path)) {
+                        // caused by a restore. Jet proxies that differ from the file are announced again when the restore is done
+                        return;
+                    }
+                    if ((path.compare(0, matcher.startsWith.size(), matcher.startsWith) != 0) ||
+                        ((!matcher.equals.empty()) && (path != matcher.equals)) ||
+                        ((!matcher.contains.empty()) && (path.find(matcher.contains) == std::string::npos))) {
+                        return;
+                    }
+                    bool first;
+                    {
+                        std::lock_guard < std::mutex > lock(m_changedPathsMutex);
+                        first = m_announcedPaths.empty();
+                        m_announcedPaths.insert(path);
+                    }
+                    if (first) {
+                        m_localChangesNotifier.notify();
+                    }
+                }));
+            }
+            // there is no initial notification of the current states
+            m_doSaveOnChange = true;
+            return 0;
+        }
+
         auto responseCb = [this](const Json::Value&) {
             // When registering a fetch, cjet notifies all matching state before giving the the response to the registration.
             // As a result we know everything that matches before this callback is called.
@@ -116,17 +274,64 @@ namespace hbk::jetproxy {
         return 0;
     }
     
+    void DelayedSaver::setSource(Source source)
+    {
+        m_source = source;
+    }
+
     void DelayedSaver::setDelay(std::chrono::milliseconds delay)
     {
         m_delay = delay;
     }
+
+    void DelayedSaver::setMaxDelay(std::chrono::milliseconds maxDelay)
+    {
+        m_maxDelay = maxDelay;
+    }
+
+    std::chrono::milliseconds DelayedSaver::getPendingDuration() const
+    {
+        std::lock_guard < std::mutex > lock(m_changedPathsMutex);
+        if (m_changedPaths.empty()) {
+            return std::chrono::milliseconds(0);
+        }
+        return std::chrono::duration_cast < std::chrono::milliseconds >(std::chrono::steady_clock::now() - m_pendingSince);
+    }
+
+    void DelayedSaver::setJournal(std::uintmax_t compactionSize)
+    {
+        m_compactionSize = compactionSize;
+    }
+
+    void DelayedSaver::setAsync(bool async)
+    {
+        m_async = async;
+    }
+
+    void DelayedSaver::setSharded(bool sharded)
+    {
+        m_sharded = sharded;
+    }
     
     /// If there is an deleayed save in flight, we save at once by canceling the delay timer
     void DelayedSaver::stop()
     {
+        for (auto subscriptionId : m_subscriptions) {
+            ChangeBus::getDefault().unsubscribe(subscriptionId);
+        }
+        m_subscriptions.clear();
+        // changes that were announced but not handled by the event loop yet
+        localChangesHandler();
+        m_doSaveOnChange = false;
         for (auto fetchId : m_fetchIds) {
             m_peer.removeFetchAsync(fetchId);
         }
         m_delayedSaveTimer.cancel();
+        if (m_compaction.valid()) {
+            m_compaction.wait();
+        }
+        if (m_async) {
+            m_registry.waitForAsyncSaves();
+        }
     }
 }
@@ -31,6 +31,7 @@
 
 #include "jetproxy/JsonSchema.hpp"
 #include "jetproxy/Event.hpp"
+#include "jetproxy/NotificationDispatcher.hpp"
 
 #include "objectmodel/ObjectModelConstants.hpp"
 
@@ -83,6 +84,16 @@ namespace hbk::jetproxy {
 
     void Event::Trigger()
     {
+        NotificationDispatcher* dispatcher = NotificationDispatcher::get(m_jetPeer);
+        if ((dispatcher) && (!m_delayedDeletion)) {
+            // overtakes pending notifications of values and introspection
+            dispatcher->post(NotificationDispatcher::Priority::Event, [&peer = m_jetPeer, path = m_path, state = m_state]() {
+                peer.addStateAsync(path, state, hbk::jet::responseCallback_t(), hbk::jet::stateCallback_t());
+                peer.removeStateAsync(path);
+            });
+            return;
+        }
+
         m_jetPeer.addStateAsync(m_path, m_state, hbk::jet::responseCallback_t(), hbk::jet::stateCallback_t());
         m_stateExists = true;
 
@@ -23,6 +23,7 @@
 // THE SOFTWARE.
 
 #include <cstddef>
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -32,6 +33,8 @@
 #include "jetproxy/AnalogVariableHandler.hpp"
 #include "jetproxy/EnumValueHandler.hpp"
 #include "jetproxy/Introspection.hpp"
+#include "jetproxy/NotificationDispatcher.hpp"
+#include "jetproxy/PublishedState.hpp"
 #include "jetproxy/SelectionValueHandler.hpp"
 
 #include "objectmodel/ObjectModelConstants.hpp"
@@ -48,6 +51,7 @@ Introspection::Introspection(hbk::jet::PeerAsync &peer, const std::string &jetPr
         m_introspectionPath.pop_back();
     }
     m_introspectionPath += jetProxyPath;
+    m_published = std::make_shared < PublishedState >(m_peer, m_introspectionPath, Json::Value());
 }
 
 Introspection::~Introspection()
@@ -67,7 +71,7 @@ void Introspection::insertNodeIntrospection(const std::string& nodeName, const s
         // This is the first introspecton entry created. Now we need the jet state to present the introspection.
         m_peer.addStateAsync(m_introspectionPath, compose(), hbk::jet::responseCallback_t(), hbk::jet::stateCallback_t());
     } else {
-        m_peer.notifyState(m_introspectionPath, compose());
+        notify();
     }
 }
 
@@ -92,7 +96,7 @@ void Introspection::setEnumVariant(const std::string &nodeName, const EnumValueH
         // This is the first introspecton entry created. Now we need the jet state to present the introspection.
         m_peer.addStateAsync(m_introspectionPath, compose(), hbk::jet::responseCallback_t(), hbk::jet::stateCallback_t());
     } else {
-        m_peer.notifyState(m_introspectionPath, compose());
+        notify();
     }
 }
 
@@ -108,7 +112,7 @@ void Introspection::setSelectionValues(const std::string &nodeName, const Select
         // This is the first introspecton entry created. Now we need the jet state to present the introspection.
         m_peer.addStateAsync(m_introspectionPath, compose(), hbk::jet::responseCallback_t(), hbk::jet::stateCallback_t());
     } else {
-        m_peer.notifyState(m_introspectionPath, compose());
+        notify();
     }
 }
 
@@ -141,7 +145,17 @@ void Introspection::setAnalogValueIntrospection(const std::string& nodeName, con
 
 void Introspection::update() const
 {
-    m_peer.notifyState(m_introspectionPath, compose());
+    notify();
+}
+
+void Introspection::notify() const
+{
+    NotificationDispatcher* dispatcher = NotificationDispatcher::get(m_peer);
+    if (dispatcher) {
+        dispatcher->enqueue(m_published, compose(), NotificationDispatcher::Priority::Introspection);
+    } else {
+        m_published->publish(compose());
+    }
 }
 
 Json::Value Introspection::compose() const
@@ -22,23 +22,23 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
-#include <cstdio>
-#include <exception>
-#include <fstream>
-#include <iostream>
-#include <filesystem>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <memory>
-#include <stdexcept>
 #include <string>
-#include <unistd.h>
 #include <utility>
+#include <vector>
 
 #include "json/value.h"
-#include "json/writer.h"
 
 #include "jet/peerasync.hpp"
 
+#include "jetproxy/ChangeBus.hpp"
+#include "jetproxy/CommandQueue.hpp"
 #include "jetproxy/JetProxy.hpp"
+#include "jetproxy/NotificationDispatcher.hpp"
+#include "jetproxy/ProxyRegistry.hpp"
 #include "objectmodel/ObjectModelConstants.hpp"
 
 namespace objModel = objectmodel::constants;
@@ -46,36 +46,61 @@ namespace objModel = objectmodel::constants;
 namespace hbk::jetproxy
 {
 
-    JetProxy::JetProxies JetProxy::m_jetProxies;
 
     JetProxy::JetProxy(hbk::jet::PeerAsync& jetPeer, const std::string& type, const std::string& path, bool fixed, const RoleLevel roleLevel, bool persistent):
+        JetProxy(ProxyRegistry::getDefault(), jetPeer, type, path, fixed, roleLevel, persistent)
+    {
+    }
+
+    JetProxy::JetProxy(ProxyRegistry& registry, hbk::jet::PeerAsync& jetPeer, const std::string& type, const std::string& path, bool fixed, const RoleLevel roleLevel, bool persistent):
         m_jetPeer(jetPeer),
         m_type(type),
         m_path(path),
         m_fixed(fixed),
         m_roleLevel(roleLevel),
-        m_persistent(persistent)
+        m_persistent(persistent),
+        m_baseCompositionValid(false),
+        m_savedCompositionInvalidationCount(0),
+        m_savedCompositionFormat(ProxyRegistry::Format::JSON),
+        m_registry(registry),
+        m_lifetime(std::make_shared < const bool >(true))
     {
-        if (m_jetProxies.find(m_path) != m_jetProxies.end())
-        {
-            throw std::runtime_error("Could not create jetProxy. Path '" + m_path + "' already in use!");
-        }
-
-        m_jetProxies[m_path] = this;
+        m_registry.insert(m_path, *this);
     }
 
     JetProxy::~JetProxy()
     {
-        m_jetProxies.erase(m_path);
+        // commands of the event loop do not synchronize with destruction in other threads
+        [[maybe_unused]] CommandQueue* commandQueue = CommandQueue::get(m_jetPeer);
+        assert((commandQueue == nullptr) || (!commandQueue->isExecuting()) || (commandQueue->isEventLoopThread()));
+        NotificationDispatcher* dispatcher = NotificationDispatcher::get(m_jetPeer);
+        if (dispatcher) {
+            dispatcher->cancel(*this);
+        }
+        m_registry.erase(m_path, *this);
     }
 
     JetProxy::JetProxy(JetProxy &&other) noexcept
         : m_jetPeer(other.m_jetPeer)
         , m_type(std::move(other.m_type))
         , m_path(std::move(other.m_path))
+        , m_fixed(other.m_fixed)
         , m_roleLevel(other.m_roleLevel)
+        , m_persistent(other.m_persistent)
         , m_state(std::move(other.m_state))
+        , m_referencesByTarget(std::move(other.m_referencesByTarget))
+        , m_referencesBySource(std::move(other.m_referencesBySource))
+        , m_baseCompositionValid(false)
+        , m_savedCompositionInvalidationCount(0)
+        , m_savedCompositionFormat(ProxyRegistry::Format::JSON)
+        , m_registry(other.m_registry)
+        , m_lifetime(std::make_shared < const bool >(true))
     {
+        m_registry.replace(m_path, other, *this);
+        NotificationDispatcher* dispatcher = NotificationDispatcher::get(m_jetPeer);
+        if (dispatcher) {
+            dispatcher->replace(other, *this);
+        }
     }
 
     void JetProxy::addReferenceByTarget(const std::string& referenceId, const std::string& targetId)
@@ -89,7 +114,8 @@ namespace hbk::jetproxy
         }
         typeReferences.emplace_back(targetId);
         m_referencesByTarget[referenceId] = typeReferences;
-        m_jetPeer.notifyState(m_path, compose());
+        m_baseCompositionValid = false;
+        notify();
     }
 
     void JetProxy::addReferenceBySource(const std::string &referenceId, const std::string &sourceId)
@@ -103,7 +129,17 @@ namespace hbk::jetproxy
         }
         typeReferences.emplace_back(sourceId);
         m_referencesBySource[referenceId] = typeReferences;
-        m_jetPeer.notifyState(m_path, compose());
+        m_baseCompositionValid = false;
+        notify();
+    }
+
+    std::vector < std::string > JetProxy::getRestoreDependencies() const
+    {
+        std::vector < std::string > dependencies;
+        for (const auto& iter : m_referencesByTarget) {
+            dependencies.insert(dependencies.end(), iter.second.begin(), iter.second.end());
+        }
+        return dependencies;
     }
 
     void JetProxy::deleteReferenceByTarget(const std::string& referenceId, const std::string& targetId)
@@ -115,7 +151,8 @@ namespace hbk::jetproxy
         for (auto it = referencesIt->second.begin(); it != referencesIt->second.end(); it++) {
             if (*it == targetId) {
                 m_referencesByTarget[referenceId].erase(it);
-                m_jetPeer.notifyState(m_path, compose());
+                m_baseCompositionValid = false;
+                notify();
                 break;
             }
         }
@@ -130,7 +167,8 @@ namespace hbk::jetproxy
         for (auto it = referencesIt->second.begin(); it != referencesIt->second.end(); it++) {
             if (*it == sourceId) {
                 m_referencesBySource[referenceId].erase(it);
-                m_jetPeer.notifyState(m_path, compose());
+                m_baseCompositionValid = false;
+                notify();
                 break;
             }
         }
@@ -138,10 +176,77 @@ namespace hbk::jetproxy
 
     void JetProxy::notify() const
     {
-        m_jetPeer.notifyState(m_path, compose());
+        m_savedComposition.reset();
+        if (m_state) {
+            NotificationDispatcher* dispatcher = NotificationDispatcher::get(m_jetPeer);
+            if (dispatcher) {
+                // composition is done once by the dispatcher
+                dispatcher->enqueue(m_state->getPublishedState(), *this);
+            } else {
+                // unchanged content won't be notified
+                m_state->notify(compose());
+            }
+        } else {
+            m_jetPeer.notifyState(m_path, compose());
+            ChangeBus::getDefault().announce(m_path);
+        }
+    }
+
+    void JetProxy::setMinPublishInterval(std::chrono::milliseconds minInterval)
+    {
+        if (m_state) {
+            m_state->setMinPublishInterval(minInterval);
+        }
+    }
+
+    void JetProxy::post(CommandQueue::Command command) const
+    {
+        CommandQueue* commandQueue = CommandQueue::get(m_jetPeer);
+        if (commandQueue == nullptr) {
+            command();
+            return;
+        }
+        commandQueue->post([lifetime = std::weak_ptr < const bool >(m_lifetime), command = std::move(command)]() {
+            if (lifetime.expired()) {
+                // jet proxy is gone
+                return;
+            }
+            command();
+        });
+    }
+
+    void JetProxy::dispatch(CommandQueue::Command command) const
+    {
+        CommandQueue* commandQueue = CommandQueue::get(m_jetPeer);
+        if ((commandQueue == nullptr) || (commandQueue->isEventLoopThread())) {
+            command();
+            return;
+        }
+        post(std::move(command));
+    }
+
+    std::uint64_t JetProxy::getSuppressedNotificationCount() const
+    {
+        if (!m_state) {
+            return 0;
+        }
+        return m_state->getSuppressedNotificationCount();
     }
 
     Json::Value JetProxy::compose() const
+    {
+        if (!m_baseCompositionValid) {
+            m_baseComposition = composeBase();
+            m_baseCompositionValid = true;
+        }
+        // The one copy per compose. Copying the cached base takes about half the time of composeBase().
+        // The properties are not composed into the cache: Members that composeProperties() adds conditionally would linger there.
+        Json::Value composition = m_baseComposition;
+        composeProperties(composition);
+        return composition;
+    }
+
+    Json::Value JetProxy::composeBase() const
     {
         Json::Value composition;
 
@@ -159,8 +264,6 @@ namespace hbk::jetproxy
         composition[objectmodel::constants::jsonPersistentMemberId] = m_persistent;
         composition[objectmodel::constants::jsonRoleLevelMemberId] = getRoleLevel();
         composition[objModel::jsonTypeMemberId] = m_type;
-        composeProperties(composition);
-
         return composition;
     }
     
@@ -185,6 +288,7 @@ namespace hbk::jetproxy
     void JetProxy::setRoleLevel(RoleLevel roleLevel)
     {
         m_roleLevel = roleLevel;
+        m_baseCompositionValid = false;
         notify();
     }
 
@@ -196,122 +300,38 @@ namespace hbk::jetproxy
     void JetProxy::setPersistent(bool persistent)
     {
         m_persistent = persistent;
+        m_baseCompositionValid = false;
+        m_savedComposition.reset();
+    }
+
+    ProxyRegistry& JetProxy::getRegistry() const
+    {
+        return m_registry;
     }
 
     int JetProxy::saveAllToFile(const std::string& fileName)
     {
-        // we compose to a temporary file and move to the real destination when finished.
-        const std::string tmpName = fileName + ".tmp";
-        std::ofstream tmpFile;
-        tmpFile.open(tmpName);
-        
-        if (!tmpFile) {
-            std::cerr << "could not open file '" << fileName << "' for writing" << std::endl;
-            return -1;
-        }
-        
-        Json::Value config;
-        /// walk to all existing jet proxies, that are marked as persistent, and save configurations as one json document to file
-        for (const auto &iter: m_jetProxies) {
-            if (iter.second->isPersistent()) {
-                config[iter.first] = iter.second->composeAll();
-            }
-        }
-        
-        {
-            Json::StreamWriterBuilder builder;
-            builder["indentation"] = "  ";
-            std::unique_ptr<Json::StreamWriter> writer(
-                        builder.newStreamWriter());
-            writer->write(config, &tmpFile);
-        }
-        tmpFile.close();
-        ::sync();
-        
-        try {
-            std::filesystem::rename(tmpName, fileName);
-        } catch (std::filesystem::filesystem_error& e) {
-            std::remove(fileName.c_str());
-            std::cerr << "Could not move config file to " << fileName << e.what() << '\n';
-            return -1;
-        }
-        ::sync();
-        return 0;
+        return ProxyRegistry::getDefault().saveToFile(fileName);
     }
 
     int JetProxy::restoreAllDefaults()
     {
-        for(auto& proxiesIter : m_jetProxies) {
-            try {
-                proxiesIter.second->restoreDefaults();
-            } catch(const std::exception& e) {
-                std::cerr << "could not restore defaults for " << proxiesIter.first << ": " << e.what() << std::endl;
-            } catch(...) {
-                std::cerr << "could not restore defaults for " << proxiesIter.first << std::endl;
-            }
-        }
-        return 0;
+        return ProxyRegistry::getDefault().restoreDefaults();
     }
-    
+
     int JetProxy::restoreAllFromFile(const std::string& fileName)
     {
-        std::ifstream file;
-        file.open(fileName);
-        if (!file) {
-            std::cerr << "could not open file '" << fileName << "' for reading. Restoring defaults for the complete service" << std::endl;
-            restoreAllDefaults();
-            return -1;
-        }
-
-        if ( file.peek() == std::ifstream::traits_type::eof()) {
-            std::cerr << "Json file '" << fileName << "': Empty file for reading. Restoring defaults for the complete service" << std::endl;
-            restoreAllDefaults();
-            return -1;
-        }
-
-        Json::Value config;
-        try
-        {
-            file >> config;
-        } catch (const Json::RuntimeError& e)
-        {
-            std::cerr << "Json file '" << fileName << "' has invalid content: " << e.what() << ". Restoring defaults for the complete service" << std::endl;
-            restoreAllDefaults();
-            return -1;
-        }
+        return ProxyRegistry::getDefault().restoreFromFile(fileName);
+    }
 
-        if ( config.isNull() ) {
-            std::cerr << "Json file '" << fileName << "' has no json content. Restoring defaults for the complete service" << std::endl;
-            restoreAllDefaults();
-            return -1;
-        }
+    int JetProxy::saveAllToDirectory(const std::string& directory)
+    {
+        return ProxyRegistry::getDefault().saveToDirectory(directory);
+    }
 
-        for(Json::Value::iterator it = config.begin(); it !=config.end(); ++it)
-        {
-            const std::string jetPath = it.key().asString();
-            const Json::Value& jsonConfig = (*it);
-            const auto& jetIter = m_jetProxies.find(jetPath);
-            if (jetIter==m_jetProxies.end()) {
-                std::cout << "could not restore " << jetPath << ": fbproxy does not exist\n";
-            } else {
-                if (!jetIter->second->isPersistent()) {
-                    std::cerr << jetPath << " is marked as non-persistent and won't be restored!" << std::endl;
-                } else {
-                    try {
-                        jetIter->second->setAll(jsonConfig);
-                    } catch(const std::runtime_error& excRestore) {
-                        std::cerr << "could not restore " << jetPath << ": " << excRestore.what() << ". Restoring defaults!" << std::endl;
-                        try {
-                            jetIter->second->restoreDefaults();
-                        } catch(const std::exception& excRestoreDefaults) {
-                            std::cerr << "could not restore defaults for " << jetIter->first << ": " << excRestoreDefaults.what() << std::endl;
-                        } catch(...) {
-                            std::cerr << "could not restore defaults for " << jetIter->first << std::endl;
-                        }
-                    }
-                }
-            }
-        }
-        return 0;
+    int JetProxy::restoreAllFromDirectory(const std::string& directory)
+    {
+        return ProxyRegistry::getDefault().restoreFromDirectory(directory);
     }
+
 }
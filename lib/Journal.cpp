@@ -0,0 +1,223 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "json/reader.h"
+#include "json/value.h"
+#include "json/writer.h"
+
+#include "jetproxy/Journal.hpp"
+#include "jetproxy/SnapshotFiles.hpp"
+
+namespace hbk::jetproxy {
+
+    static const char JOURNAL_PATH[] = "path";
+    static const char JOURNAL_CONFIG[] = "config";
+
+    std::string Journal::getFileName(const std::string& fileName)
+    {
+        return fileName + ".journal";
+    }
+
+    std::uintmax_t Journal::getSize(const std::string& fileName)
+    {
+        std::error_code ec;
+        const std::uintmax_t size = std::filesystem::file_size(getFileName(fileName), ec);
+        if (ec) {
+            return 0;
+        }
+        return size;
+    }
+
+    std::string Journal::format(const Json::Value& records)
+    {
+        Json::StreamWriterBuilder builder;
+        // one record per line
+        builder["indentation"] = "";
+        std::unique_ptr < Json::StreamWriter > writer(builder.newStreamWriter());
+        std::ostringstream stream;
+        for (Json::Value::const_iterator it = records.begin(); it != records.end(); ++it) {
+            Json::Value record;
+            record[JOURNAL_PATH] = it.key();
+            record[JOURNAL_CONFIG] = *it;
+            writer->write(record, &stream);
+            stream << '\n';
+        }
+        return stream.str();
+    }
+
+    int Journal::append(const std::string& fileName, std::string records, SnapshotFiles::Durability durability)
+    {
+        const std::string journalName = getFileName(fileName);
+        const int fd = ::open(journalName.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cerr << "could not open journal '" << journalName << "' for writing: " << std::strerror(errno) << std::endl;
+            return -1;
+        }
+        struct stat journalStat = {};
+        char lastCharacter = '\n';
+        if ((::fstat(fd, &journalStat) == 0) && (journalStat.st_size > 0)) {
+            if (::pread(fd, &lastCharacter, 1, journalStat.st_size - 1) != 1) {
+                lastCharacter = '\n';
+            }
+        }
+        if (lastCharacter != '\n') {
+            // do not continue a record that was torn by a power loss
+            records.insert(records.begin(), '\n');
+        }
+
+        std::string_view pending(records);
+        while (!pending.empty()) {
+            const ssize_t result = ::write(fd, pending.data(), pending.size());
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "could not write journal '" << journalName << "': " << std::strerror(errno) << std::endl;
+                ::close(fd);
+                return -1;
+            }
+            pending.remove_prefix(static_cast < std::size_t >(result));
+        }
+        // only the appended records go to disk, not the whole file system
+        int result = 0;
+        if (durability != SnapshotFiles::Durability::NONE) {
+            result = ::fdatasync(fd);
+        }
+        ::close(fd);
+        if (result < 0) {
+            std::cerr << "could not sync journal '" << journalName << "'" << std::endl;
+            return -1;
+        }
+        if ((journalStat.st_size == 0) || (durability == SnapshotFiles::Durability::FULL)) {
+            // the journal might have been created
+            return SnapshotFiles::syncDirectory(SnapshotFiles::getDirectory(journalName), durability);
+        }
+        return 0;
+    }
+
+    Json::Value Journal::read(const std::string& fileName, std::uintmax_t size)
+    {
+        Json::Value records(Json::objectValue);
+        if (size == 0) {
+            return records;
+        }
+        const std::string journalName = getFileName(fileName);
+        std::ifstream journal(journalName, std::ios::binary);
+        std::string content(size, '\0');
+        if ((!journal) || (!journal.read(content.data(), static_cast < std::streamsize >(size)))) {
+            std::cerr << "could not read journal '" << journalName << "'" << std::endl;
+            return records;
+        }
+
+        Json::CharReaderBuilder builder;
+        std::unique_ptr < Json::CharReader > reader(builder.newCharReader());
+        std::string_view lines(content);
+        while (!lines.empty()) {
+            const std::size_t end = lines.find('\n');
+            const std::string_view line = lines.substr(0, end);
+            lines.remove_prefix((end == std::string_view::npos) ? lines.size() : end + 1);
+            if (line.empty()) {
+                continue;
+            }
+
+            Json::Value record;
+            std::string errors;
+            if ((!reader->parse(line.data(), line.data() + line.size(), &record, &errors)) || (!record.isObject()) || (!record[JOURNAL_PATH].isString())) {
+                // a record that was torn by a power loss
+                std::cerr << "ignoring invalid record in journal '" << journalName << "'" << std::endl;
+                continue;
+            }
+            records[record[JOURNAL_PATH].asString()] = std::move(record[JOURNAL_CONFIG]);
+        }
+        return records;
+    }
+
+    void Journal::replay(const std::string& fileName, std::uintmax_t size, Json::Value& config)
+    {
+        const Json::Value records = read(fileName, size);
+        for (Json::Value::const_iterator it = records.begin(); it != records.end(); ++it) {
+            if (it->isNull()) {
+                config.removeMember(it.name());
+            } else {
+                config[it.name()] = *it;
+            }
+        }
+    }
+
+    int Journal::trim(const std::string& fileName, std::uintmax_t size, SnapshotFiles::Durability durability, bool& trimmed)
+    {
+        trimmed = false;
+        const std::string journalName = getFileName(fileName);
+        std::string remainder;
+        {
+            std::ifstream journal(journalName, std::ios::binary);
+            journal.seekg(static_cast < std::streamoff >(size));
+            remainder.assign(std::istreambuf_iterator < char >(journal), std::istreambuf_iterator < char >());
+        }
+
+        if (remainder.empty()) {
+            std::remove(journalName.c_str());
+            trimmed = true;
+            return 0;
+        }
+
+        // records appended meanwhile are kept
+        const std::string tmpName = journalName + SnapshotFiles::TMP_SUFFIX;
+        {
+            std::ofstream tmpFile(tmpName, std::ios::binary | std::ios::trunc);
+            if (!tmpFile) {
+                std::cerr << "could not open file '" << tmpName << "' for writing" << std::endl;
+                return -1;
+            }
+            tmpFile << remainder;
+        }
+        if (SnapshotFiles::syncFile(tmpName, durability) < 0) {
+            return -1;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmpName, journalName, ec);
+        if (ec) {
+            std::cerr << "Could not move journal to " << journalName << ": " << ec.message() << std::endl;
+            return -1;
+        }
+        trimmed = true;
+        return SnapshotFiles::syncDirectory(SnapshotFiles::getDirectory(journalName), durability);
+    }
+}
@@ -0,0 +1,431 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "json/value.h"
+
+#include "hbk/sys/eventloop.h"
+#include "hbk/sys/notifier.h"
+#include "hbk/sys/timer.h"
+#include "jet/peerasync.hpp"
+
+#include "jetproxy/JetProxy.hpp"
+#include "jetproxy/NotificationDispatcher.hpp"
+#include "jetproxy/PublishedState.hpp"
+
+namespace hbk::jetproxy
+{
+    std::mutex NotificationDispatcher::s_dispatchersMutex;
+    NotificationDispatcher::Dispatchers NotificationDispatcher::s_dispatchers;
+    // starts above the generation of an empty cache
+    std::atomic < std::uint64_t > NotificationDispatcher::s_dispatchersGeneration(1);
+
+    NotificationDispatcher::Batch::Batch(NotificationDispatcher& dispatcher)
+        : m_dispatcher(dispatcher)
+    {
+        std::lock_guard < std::mutex > lock(m_dispatcher.m_mutex);
+        ++m_dispatcher.m_batchDepth;
+    }
+
+    NotificationDispatcher::Batch::~Batch()
+    {
+        {
+            std::lock_guard < std::mutex > lock(m_dispatcher.m_mutex);
+            --m_dispatcher.m_batchDepth;
+            if (m_dispatcher.m_batchDepth > 0) {
+                return;
+            }
+        }
+        m_dispatcher.flush();
+    }
+
+    NotificationDispatcher::NotificationDispatcher(hbk::sys::EventLoop& eventloop, hbk::jet::PeerAsync& peer)
+        : m_peer(peer)
+        , m_flushNotifier(eventloop)
+        , m_rateLimitTimer(eventloop)
+        , m_batchDepth(0)
+        , m_flushRequested(false)
+        , m_maxPerIteration(0)
+        , m_coalescedCount(0)
+    {
+        {
+            std::lock_guard < std::mutex > lock(s_dispatchersMutex);
+            if (s_dispatchers.find(&m_peer) != s_dispatchers.end()) {
+                throw std::runtime_error("Could not create notification dispatcher. There is one for this jet peer already!");
+            }
+            s_dispatchers[&m_peer] = this;
+            s_dispatchersGeneration.fetch_add(1, std::memory_order_release);
+        }
+        m_flushNotifier.set(std::bind(&NotificationDispatcher::flushHandler, this));
+    }
+
+    NotificationDispatcher::~NotificationDispatcher()
+    {
+        {
+            std::lock_guard < std::mutex > lock(s_dispatchersMutex);
+            s_dispatchers.erase(&m_peer);
+            s_dispatchersGeneration.fetch_add(1, std::memory_order_release);
+        }
+        m_rateLimitTimer.cancel();
+        flush();
+
+        // no trailing update gets lost
+        PendingNotifications delayed;
+        {
+            std::lock_guard < std::mutex > lock(m_mutex);
+            delayed.swap(m_delayed);
+        }
+        for (const auto& iter : delayed) {
+            publish(iter.second);
+        }
+    }
+
+    NotificationDispatcher* NotificationDispatcher::get(const hbk::jet::PeerAsync& peer)
+    {
+        // dispatchers are created and destroyed rarely, looking them up must not contend on one mutex for all threads
+        thread_local CachedDispatchers cached;
+        const std::uint64_t generation = s_dispatchersGeneration.load(std::memory_order_acquire);
+        if (cached.generation != generation) {
+            cached.dispatchers.clear();
+            cached.generation = generation;
+        }
+        const auto cachedIter = cached.dispatchers.find(&peer);
+        if (cachedIter != cached.dispatchers.end()) {
+            return cachedIter->second;
+        }
+
+        NotificationDispatcher* dispatcher = nullptr;
+        {
+            std::lock_guard < std::mutex > lock(s_dispatchersMutex);
+            const auto iter = s_dispatchers.find(&peer);
+            if (iter != s_dispatchers.end()) {
+                dispatcher = iter->second;
+            }
+        }
+        // a change since generation was loaded drops the cache on the next call
+        cached.dispatchers.emplace(&peer, dispatcher);
+        return dispatcher;
+    }
+
+    void NotificationDispatcher::enqueue(const std::weak_ptr < PublishedState >& state, const Json::Value& value, Priority priority)
+    {
+        auto locked = state.lock();
+        if (!locked) {
+            return;
+        }
+        enqueue(locked->getPath(), priority, Pending{state, nullptr, value});
+    }
+
+    void NotificationDispatcher::enqueue(const std::weak_ptr < PublishedState >& state, const JetProxy& proxy)
+    {
+        auto locked = state.lock();
+        if (!locked) {
+            return;
+        }
+        enqueue(locked->getPath(), Priority::Value, Pending{state, &proxy, Json::Value()});
+    }
+
+    void NotificationDispatcher::enqueue(const std::string& path, Priority priority, Pending&& pending)
+    {
+        bool doNotify;
+        {
+            std::lock_guard < std::mutex > lock(m_mutex);
+            auto delayedIter = m_delayed.find(path);
+            if (delayedIter != m_delayed.end()) {
+                // held back until the minimum publish interval elapsed, latest wins
+                delayedIter->second = std::move(pending);
+                ++m_coalescedCount;
+                return;
+            }
+
+            Lane& lane = m_lanes[static_cast < std::size_t >(priority)];
+            auto iter = lane.pending.find(path);
+            if (iter == lane.pending.end()) {
+                lane.order.emplace_back(path);
+                lane.pending.emplace(path, std::move(pending));
+            } else {
+                // latest wins
+                iter->second = std::move(pending);
+                ++m_coalescedCount;
+            }
+            doNotify = requestFlush(priority);
+        }
+        if (doNotify) {
+            m_flushNotifier.notify();
+        }
+    }
+
+    void NotificationDispatcher::post(Priority priority, std::function < void() > operation)
+    {
+        bool doNotify;
+        {
+            std::lock_guard < std::mutex > lock(m_mutex);
+            m_lanes[static_cast < std::size_t >(priority)].operations.emplace_back(std::move(operation));
+            doNotify = requestFlush(priority);
+        }
+        if (doNotify) {
+            m_flushNotifier.notify();
+        }
+    }
+
+    bool NotificationDispatcher::requestFlush(Priority priority)
+    {
+        if (m_flushRequested) {
+            return false;
+        }
+        if ((m_batchDepth > 0) && (priority != Priority::Event)) {
+            // the last batch publishes everything
+            return false;
+        }
+        m_flushRequested = true;
+        return true;
+    }
+
+    void NotificationDispatcher::cancel(const JetProxy& proxy)
+    {
+        std::lock_guard < std::mutex > lock(m_mutex);
+        for (auto& lane : m_lanes) {
+            auto iter = lane.pending.find(proxy.getPath());
+            if ((iter != lane.pending.end()) && (iter->second.proxy == &proxy)) {
+                // stale entry in order is skipped when draining
+                lane.pending.erase(iter);
+            }
+        }
+        auto iter = m_delayed.find(proxy.getPath());
+        if ((iter != m_delayed.end()) && (iter->second.proxy == &proxy)) {
+            // stale entry in m_deadlines is skipped by rateLimitHandler
+            m_delayed.erase(iter);
+        }
+    }
+
+    void NotificationDispatcher::replace(const JetProxy& from, const JetProxy& to)
+    {
+        std::lock_guard < std::mutex > lock(m_mutex);
+        std::vector < PendingNotifications* > notifications = { &m_delayed };
+        for (auto& lane : m_lanes) {
+            notifications.emplace_back(&lane.pending);
+        }
+        for (auto* iter : notifications) {
+            auto pendingIter = iter->find(to.getPath());
+            if ((pendingIter != iter->end()) && (pendingIter->second.proxy == &from)) {
+                pendingIter->second.proxy = &to;
+            }
+        }
+    }
+
+    void NotificationDispatcher::flush()
+    {
+        drain(0, Priority::Introspection);
+    }
+
+    void NotificationDispatcher::setMaxPerIteration(std::size_t count)
+    {
+        std::lock_guard < std::mutex > lock(m_mutex);
+        m_maxPerIteration = count;
+    }
+
+    bool NotificationDispatcher::drain(std::size_t budget, Priority lowest)
+    {
+        const std::size_t laneCount = static_cast < std::size_t >(lowest) + 1;
+        std::size_t count = 0;
+        while (true) {
+            std::function < void() > operation;
+            std::string path;
+            Pending pending{};
+            {
+                std::lock_guard < std::mutex > lock(m_mutex);
+                Lane* lane = nullptr;
+                for (std::size_t index = 0; index < laneCount; ++index) {
+                    if ((!m_lanes[index].operations.empty()) || (!m_lanes[index].order.empty())) {
+                        lane = &m_lanes[index];
+                        break;
+                    }
+                }
+                if (lane == nullptr) {
+                    return false;
+                }
+                if ((budget > 0) && (count >= budget)) {
+                    return true;
+                }
+
+                if (!lane->operations.empty()) {
+                    operation = std::move(lane->operations.front());
+                    lane->operations.pop_front();
+                } else {
+                    path = std::move(lane->order.front());
+                    lane->order.pop_front();
+                    auto iter = lane->pending.find(path);
+                    if (iter == lane->pending.end()) {
+                        // canceled or published already
+                        continue;
+                    }
+                    pending = std::move(iter->second);
+                    lane->pending.erase(iter);
+                }
+            }
+
+            ++count;
+            if (operation) {
+                operation();
+            } else {
+                publishOrDelay(path, std::move(pending));
+            }
+        }
+    }
+
+    void NotificationDispatcher::publishOrDelay(const std::string& path, Pending&& pending)
+    {
+        auto state = pending.state.lock();
+        if (!state) {
+            return;
+        }
+        if ((state->getMinInterval().count() > 0) && (Clock::now() < state->getEarliestPublishTime())) {
+            std::lock_guard < std::mutex > lock(m_mutex);
+            auto delayedIter = m_delayed.find(path);
+            if (delayedIter == m_delayed.end()) {
+                m_deadlines.emplace(state->getEarliestPublishTime(), path);
+                m_delayed.emplace(path, std::move(pending));
+                armRateLimitTimer();
+            } else {
+                // enqueued while draining
+                delayedIter->second = std::move(pending);
+            }
+            return;
+        }
+        publish(pending);
+    }
+
+    void NotificationDispatcher::publish(const Pending& pending)
+    {
+        auto state = pending.state.lock();
+        if (!state) {
+            return;
+        }
+        if (pending.proxy) {
+            state->publish(pending.proxy->compose());
+        } else {
+            state->publish(pending.value);
+        }
+    }
+
+    void NotificationDispatcher::armRateLimitTimer()
+    {
+        if (m_deadlines.empty()) {
+            m_armedDeadline = Clock::time_point();
+            m_rateLimitTimer.cancel();
+            return;
+        }
+        const Clock::time_point deadline = m_deadlines.top().first;
+        if (deadline == m_armedDeadline) {
+            return;
+        }
+        m_armedDeadline = deadline;
+        // round up, the handler publishes due notifications only
+        auto timeout = std::chrono::ceil < std::chrono::milliseconds >(deadline - Clock::now());
+        if (timeout.count() < 1) {
+            timeout = std::chrono::milliseconds(1);
+        }
+        m_rateLimitTimer.set(timeout, false, std::bind(&NotificationDispatcher::rateLimitHandler, this, std::placeholders::_1));
+    }
+
+    void NotificationDispatcher::rateLimitHandler(bool fired)
+    {
+        if (!fired) {
+            return;
+        }
+
+        std::vector < Pending > due;
+        {
+            std::lock_guard < std::mutex > lock(m_mutex);
+            const Clock::time_point now = Clock::now();
+            while ((!m_deadlines.empty()) && (m_deadlines.top().first <= now)) {
+                const std::string path = m_deadlines.top().second;
+                m_deadlines.pop();
+                auto iter = m_delayed.find(path);
+                if (iter == m_delayed.end()) {
+                    // canceled
+                    continue;
+                }
+                auto state = iter->second.state.lock();
+                if ((state) && (now < state->getEarliestPublishTime())) {
+                    // stale deadline of a canceled notification, the interval restarted since
+                    m_deadlines.emplace(state->getEarliestPublishTime(), path);
+                    continue;
+                }
+                due.emplace_back(std::move(iter->second));
+                m_delayed.erase(iter);
+            }
+            m_armedDeadline = Clock::time_point();
+            armRateLimitTimer();
+        }
+
+        for (const auto& pending : due) {
+            publish(pending);
+        }
+    }
+
+    void NotificationDispatcher::flushHandler()
+    {
+        Priority lowest = Priority::Introspection;
+        std::size_t budget;
+        {
+            std::lock_guard < std::mutex > lock(m_mutex);
+            m_flushRequested = false;
+            if (m_batchDepth > 0) {
+                // the last batch publishes everything else
+                lowest = Priority::Event;
+            }
+            budget = m_maxPerIteration;
+        }
+
+        if (drain(budget, lowest)) {
+            bool doNotify;
+            {
+                // continue in the next iteration
+                std::lock_guard < std::mutex > lock(m_mutex);
+                doNotify = requestFlush(Priority::Event);
+            }
+            if (doNotify) {
+                m_flushNotifier.notify();
+            }
+        }
+    }
+
+    std::uint64_t NotificationDispatcher::getCoalescedCount() const
+    {
+        std::lock_guard < std::mutex > lock(m_mutex);
+        return m_coalescedCount;
+    }
+}
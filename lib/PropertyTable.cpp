@@ -0,0 +1,98 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "jetproxy/PropertyTable.hpp"
+
+namespace hbk::jetproxy
+{
+    PropertyIndex::PropertyIndex(const std::vector < const char* >& names)
+        : m_names(names)
+        , m_seed(0)
+    {
+        // try seeds until there is no collision. Table grows if there is none.
+        std::size_t slotCount = 1;
+        while (slotCount < m_names.size() * 2) {
+            slotCount *= 2;
+        }
+
+        static const std::uint32_t maxSeed = 64;
+        while (true) {
+            for (std::uint32_t seed = 0; seed < maxSeed; ++seed) {
+                std::vector < std::size_t > slots(slotCount, NOT_FOUND);
+                bool collision = false;
+                for (std::size_t position = 0; position < m_names.size(); ++position) {
+                    const char* name = m_names[position];
+                    std::size_t slot = hash(name, std::strlen(name), seed) & (slotCount - 1);
+                    if (slots[slot] != NOT_FOUND) {
+                        if (std::strcmp(m_names[slots[slot]], name) == 0) {
+                            throw std::runtime_error("Property '" + std::string(name) + "' is described twice");
+                        }
+                        collision = true;
+                        break;
+                    }
+                    slots[slot] = position;
+                }
+                if (!collision) {
+                    m_seed = seed;
+                    m_slots.swap(slots);
+                    return;
+                }
+            }
+            slotCount *= 2;
+        }
+    }
+
+    std::size_t PropertyIndex::find(const std::string& name) const
+    {
+        if (m_slots.empty()) {
+            return NOT_FOUND;
+        }
+        const std::size_t position = m_slots[hash(name.c_str(), name.length(), m_seed) & (m_slots.size() - 1)];
+        if (position == NOT_FOUND) {
+            return NOT_FOUND;
+        }
+        if (name.compare(m_names[position]) != 0) {
+            return NOT_FOUND;
+        }
+        return position;
+    }
+
+    std::uint32_t PropertyIndex::hash(const char* name, std::size_t length, std::uint32_t seed)
+    {
+        // FNV-1a
+        std::uint32_t result = 2166136261u ^ (seed * 16777619u);
+        for (std::size_t i = 0; i < length; ++i) {
+            result ^= static_cast < unsigned char >(name[i]);
+            result *= 16777619u;
+        }
+        return result;
+    }
+}
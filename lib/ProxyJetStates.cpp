@@ -22,6 +22,9 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <chrono>
+#include <cstdint>
+#include <iostream>
 #include <memory>
 #include <string>
 #include <utility>
@@ -31,9 +34,12 @@
 #include "jet/peerasync.hpp"
 
 #include "jetproxy/AnalogVariableHandler.hpp"
+#include "jetproxy/ChangeBus.hpp"
 #include "jetproxy/EnumValueHandler.hpp"
 #include "jetproxy/Method.hpp"
+#include "jetproxy/NotificationDispatcher.hpp"
 #include "jetproxy/ProxyJetStates.hpp"
+#include "jetproxy/PublishedState.hpp"
 #include "jetproxy/SelectionValueHandler.hpp"
 
 namespace hbk::jetproxy
@@ -41,9 +47,24 @@ namespace hbk::jetproxy
     ProxyJetStates::ProxyJetStates(hbk::jet::PeerAsync& peer, const std::string& path, const Json::Value& initialValue, const hbk::jet::stateCallback_t& callback)
         : m_jetPeer(peer)
         , m_path(path)
+        , m_published(std::make_shared < PublishedState >(peer, path, initialValue, true))
         , m_introspection(peer, path)
     {
-        m_jetPeer.addStateAsync(m_path, initialValue, hbk::jet::responseCallback_t(), callback);
+        hbk::jet::stateCallback_t stateCallback;
+        if (callback) {
+            // A set request might result in a state value that was not published by notify().
+            // We do not know it, hence the next notification is not to be suppressed.
+            std::weak_ptr < PublishedState > published = m_published;
+            stateCallback = [published, callback, path](const Json::Value& request) {
+                hbk::jet::SetStateCbResult result = callback(request);
+                if (auto locked = published.lock()) {
+                    locked->invalidate();
+                }
+                ChangeBus::getDefault().announce(path);
+                return result;
+            };
+        }
+        m_jetPeer.addStateAsync(m_path, initialValue, hbk::jet::responseCallback_t(), stateCallback);
     }
 
     ProxyJetStates::~ProxyJetStates()
@@ -52,6 +73,34 @@ namespace hbk::jetproxy
         m_jetPeer.removeStateAsync(m_path);
     }
 
+    void ProxyJetStates::notify(const Json::Value& value)
+    {
+        NotificationDispatcher* dispatcher = NotificationDispatcher::get(m_jetPeer);
+        if (dispatcher) {
+            dispatcher->enqueue(m_published, value);
+        } else {
+            m_published->publish(value);
+        }
+    }
+
+    void ProxyJetStates::setMinPublishInterval(std::chrono::milliseconds minInterval)
+    {
+        if ((minInterval.count() > 0) && (NotificationDispatcher::get(m_jetPeer) == nullptr)) {
+            std::cerr << "minimum publish interval of " << m_path << " takes effect once there is a NotificationDispatcher for its jet peer" << std::endl;
+        }
+        m_published->setMinInterval(minInterval);
+    }
+
+    std::uint64_t ProxyJetStates::getSuppressedNotificationCount() const
+    {
+        return m_published->getSuppressedCount();
+    }
+
+    std::uint64_t ProxyJetStates::getTotalSuppressedNotificationCount()
+    {
+        return PublishedState::getTotalSuppressedCount();
+    }
+
     void ProxyJetStates::addMethod(const std::string& methodName, const hbk::jet::methodCallback_t& callback, const Method::MethodDescription& description)
     {
         // create the method in place
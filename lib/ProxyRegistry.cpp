@@ -0,0 +1,1873 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <ostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "json/reader.h"
+#include "json/value.h"
+#include "json/writer.h"
+
+#include "jet/peerasync.hpp"
+
+#include "jetproxy/CborSerializer.hpp"
+#include "jetproxy/ChangeBus.hpp"
+#include "jetproxy/CommandQueue.hpp"
+#include "jetproxy/ConfigIndex.hpp"
+#include "jetproxy/JetProxy.hpp"
+#include "jetproxy/Journal.hpp"
+#include "jetproxy/NotificationDispatcher.hpp"
+#include "jetproxy/ProxyJetStates.hpp"
+#include "jetproxy/ProxyRegistry.hpp"
+#include "jetproxy/PublishedState.hpp"
+#include "jetproxy/ShardDirectory.hpp"
+#include "jetproxy/SnapshotFiles.hpp"
+#include "jetproxy/SnapshotHeader.hpp"
+
+namespace hbk::jetproxy
+{
+    /// How often an event loop thread waiting for other event loops executes the commands posted to it
+    static const std::chrono::milliseconds HELPING_WAIT_INTERVAL(1);
+
+    /// Calls the operation for each segment of the path. "/fb/scaler1" consists of "", "fb" and "scaler1".
+    /// \return false if the operation stopped the iteration by returning false
+    template < typename Operation >
+    static bool forEachSegment(std::string_view path, Operation&& operation)
+    {
+        while (true) {
+            const std::size_t separator = path.find('/');
+            if (!operation(path.substr(0, separator))) {
+                return false;
+            }
+            if (separator == std::string_view::npos) {
+                return true;
+            }
+            path.remove_prefix(separator + 1);
+        }
+    }
+
+    /// Like operator==() but numbers of different types with the same value are equal, e.g. a unsigned property and the integer read from the file
+    static bool isEquivalent(const Json::Value& a, const Json::Value& b)
+    {
+        if ((a.isNumeric()) && (b.isNumeric())) {
+            if ((a.isInt64()) && (b.isInt64())) {
+                return a.asInt64() == b.asInt64();
+            }
+            if ((a.isUInt64()) && (b.isUInt64())) {
+                return a.asUInt64() == b.asUInt64();
+            }
+            return a.asDouble() == b.asDouble();
+        }
+        if (a.type() != b.type()) {
+            return false;
+        }
+        if (a.isArray()) {
+            if (a.size() != b.size()) {
+                return false;
+            }
+            for (Json::ArrayIndex index = 0; index < a.size(); ++index) {
+                if (!isEquivalent(a[index], b[index])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (a.isObject()) {
+            if (a.size() != b.size()) {
+                return false;
+            }
+            for (Json::Value::const_iterator it = a.begin(); it != a.end(); ++it) {
+                const std::string name = it.name();
+                const Json::Value* member = b.find(name.data(), name.data() + name.size());
+                if ((member == nullptr) || (!isEquivalent(*it, *member))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        return a == b;
+    }
+
+    ProxyRegistry& ProxyRegistry::getDefault()
+    {
+        static ProxyRegistry registry;
+        return registry;
+    }
+
+    ProxyRegistry::ProxyRegistry()
+        : m_size(0)
+        , m_lastGeneration(0)
+        , m_incrementalSave(false)
+        , m_durability(Durability::FILE)
+        , m_format(Format::JSON)
+        , m_restoreSliceCount(100)
+        , m_restoreSliceDuration(std::chrono::milliseconds(10))
+        , m_restoreThreads(1)
+        , m_restoringCount(0)
+        , m_generations(1)
+        , m_composedCount(0)
+        , m_reusedCount(0)
+        , m_writeCount(0)
+        , m_skippedWriteCount(0)
+        , m_lastSequence(0)
+        , m_saveInFlight(false)
+        , m_stopSaveWorker(false)
+    {
+    }
+
+    ProxyRegistry::~ProxyRegistry()
+    {
+        {
+            std::lock_guard < std::mutex > lock(m_saveRequestsMutex);
+            m_stopSaveWorker = true;
+            m_saveRequestsCondition.notify_all();
+        }
+        if (m_saveWorker.joinable()) {
+            // waiting saves are executed before
+            m_saveWorker.join();
+        }
+    }
+
+    void ProxyRegistry::setFormat(Format format)
+    {
+        m_format = format;
+    }
+
+    ProxyRegistry::Format ProxyRegistry::getFormat() const
+    {
+        return m_format;
+    }
+
+    void ProxyRegistry::setGenerations(unsigned int count)
+    {
+        m_generations = count;
+    }
+
+    unsigned int ProxyRegistry::getGenerations() const
+    {
+        return m_generations;
+    }
+
+    void ProxyRegistry::setDurability(Durability durability)
+    {
+        m_durability = durability;
+    }
+
+    ProxyRegistry::Durability ProxyRegistry::getDurability() const
+    {
+        return m_durability;
+    }
+
+    ProxyRegistry::SaveDurations ProxyRegistry::getLastSaveDurations() const
+    {
+        std::lock_guard < std::mutex > lock(m_saveDurationsMutex);
+        return m_lastSaveDurations;
+    }
+
+    void ProxyRegistry::setIncrementalSave(bool incremental)
+    {
+        m_incrementalSave = incremental;
+    }
+
+    std::uint64_t ProxyRegistry::getComposedCount() const
+    {
+        return m_composedCount;
+    }
+
+    std::uint64_t ProxyRegistry::getReusedCount() const
+    {
+        return m_reusedCount;
+    }
+
+    std::uint64_t ProxyRegistry::getWriteCount() const
+    {
+        return m_writeCount;
+    }
+
+    std::uint64_t ProxyRegistry::getSkippedWriteCount() const
+    {
+        return m_skippedWriteCount;
+    }
+
+    void ProxyRegistry::insert(const std::string& path, JetProxy& jetProxy)
+    {
+        std::unique_lock < std::shared_mutex > lock(m_mutex);
+        Node* node = &m_root;
+        forEachSegment(path, [&node](std::string_view segment) {
+            auto iter = node->children.find(segment);
+            if (iter == node->children.end()) {
+                iter = node->children.emplace(std::string(segment), std::make_unique < Node >()).first;
+            }
+            node = iter->second.get();
+            return true;
+        });
+        if (node->jetProxy) {
+            throw std::runtime_error("Could not create jetProxy. Path '" + path + "' already in use!");
+        }
+        node->jetProxy = &jetProxy;
+        node->generation = ++m_lastGeneration;
+        ++m_size;
+    }
+
+    std::size_t ProxyRegistry::erase(const std::string& path, const JetProxy& jetProxy)
+    {
+        std::unique_lock < std::shared_mutex > lock(m_mutex);
+        // all nodes from the root to the one of the path
+        std::vector < Node* > nodes = { &m_root };
+        std::vector < std::string_view > segments;
+        const bool found = forEachSegment(path, [&nodes, &segments](std::string_view segment) {
+            auto iter = nodes.back()->children.find(segment);
+            if (iter == nodes.back()->children.end()) {
+                return false;
+            }
+            nodes.push_back(iter->second.get());
+            segments.push_back(segment);
+            return true;
+        });
+        if ((!found) || (nodes.back()->jetProxy != &jetProxy)) {
+            return 0;
+        }
+        nodes.back()->jetProxy = nullptr;
+        nodes.back()->generation = 0;
+        --m_size;
+
+        // remove nodes that lead to nowhere
+        for (std::size_t index = nodes.size() - 1; index > 0; --index) {
+            Node* node = nodes[index];
+            if ((node->jetProxy) || (!node->children.empty())) {
+                break;
+            }
+            Node* parent = nodes[index - 1];
+            parent->children.erase(parent->children.find(segments[index - 1]));
+        }
+        return 1;
+    }
+
+    void ProxyRegistry::replace(const std::string& path, const JetProxy& from, JetProxy& to)
+    {
+        std::unique_lock < std::shared_mutex > lock(m_mutex);
+        Node* node = const_cast < Node* >(findNode(path));
+        if ((node) && (node->jetProxy == &from)) {
+            node->jetProxy = &to;
+        }
+    }
+
+    JetProxy* ProxyRegistry::find(const std::string& path) const
+    {
+        std::shared_lock < std::shared_mutex > lock(m_mutex);
+        const Node* node = findNode(path);
+        if (node == nullptr) {
+            return nullptr;
+        }
+        return node->jetProxy;
+    }
+
+    JetProxy* ProxyRegistry::findOwner(const std::string& path) const
+    {
+        std::shared_lock < std::shared_mutex > lock(m_mutex);
+        return lookupOwner(path);
+    }
+
+    ProxyRegistry::Handle ProxyRegistry::getHandle(const std::string& path) const
+    {
+        std::shared_lock < std::shared_mutex > lock(m_mutex);
+        const Node* node = findNode(path);
+        if ((node == nullptr) || (node->jetProxy == nullptr)) {
+            return Handle();
+        }
+        return Handle{path, node->generation};
+    }
+
+    JetProxy* ProxyRegistry::resolve(const Handle& handle) const
+    {
+        if (handle.generation == 0) {
+            return nullptr;
+        }
+        std::shared_lock < std::shared_mutex > lock(m_mutex);
+        const Node* node = findNode(handle.path);
+        if ((node == nullptr) || (node->generation != handle.generation)) {
+            return nullptr;
+        }
+        return node->jetProxy;
+    }
+
+    void ProxyRegistry::forEach(const std::string& prefix, const Operation& operation) const
+    {
+        std::string_view subtree(prefix);
+        if ((!subtree.empty()) && (subtree.back() == '/')) {
+            subtree.remove_suffix(1);
+        }
+
+        std::shared_lock < std::shared_mutex > lock(m_mutex);
+        if (prefix.empty()) {
+            forEach(m_root, operation);
+            return;
+        }
+        const Node* node = findNode(subtree);
+        if (node) {
+            forEach(*node, operation);
+        }
+    }
+
+    std::size_t ProxyRegistry::size() const
+    {
+        std::shared_lock < std::shared_mutex > lock(m_mutex);
+        return m_size;
+    }
+
+    const ProxyRegistry::Node* ProxyRegistry::findNode(std::string_view path) const
+    {
+        const Node* node = &m_root;
+        const bool found = forEachSegment(path, [&node](std::string_view segment) {
+            auto iter = node->children.find(segment);
+            if (iter == node->children.end()) {
+                return false;
+            }
+            node = iter->second.get();
+            return true;
+        });
+        if (!found) {
+            return nullptr;
+        }
+        return node;
+    }
+
+    JetProxy* ProxyRegistry::lookupOwner(std::string_view path) const
+    {
+        JetProxy* owner = nullptr;
+        const Node* node = &m_root;
+        forEachSegment(path, [&node, &owner](std::string_view segment) {
+            auto iter = node->children.find(segment);
+            if (iter == node->children.end()) {
+                return false;
+            }
+            node = iter->second.get();
+            if (node->jetProxy) {
+                owner = node->jetProxy;
+            }
+            return true;
+        });
+        return owner;
+    }
+
+    void ProxyRegistry::forEach(const Node& node, const Operation& operation)
+    {
+        if (node.jetProxy) {
+            operation(*node.jetProxy);
+        }
+        for (const auto& iter : node.children) {
+            forEach(*iter.second, operation);
+        }
+    }
+
+    void ProxyRegistry::forEachInEventLoop(const std::string& prefix, const Operation& operation) const
+    {
+        forEachInEventLoop([this, &prefix](const Operation& collect) {
+            forEach(prefix, collect);
+        }, operation);
+    }
+
+    void ProxyRegistry::forEachInEventLoop(const Enumeration& enumerate, const Operation& operation) const
+    {
+        struct Entry {
+            JetProxy* jetProxy;
+            std::weak_ptr < const bool > lifetime;
+        };
+        using Entries = std::vector < Entry >;
+
+        // jet peer is the key
+        std::unordered_map < hbk::jet::PeerAsync*, Entries > entriesByPeer;
+        enumerate([&entriesByPeer](JetProxy& jetProxy) {
+            entriesByPeer[&jetProxy.m_jetPeer].push_back(Entry{&jetProxy, jetProxy.m_lifetime});
+        });
+
+        auto execute = [&operation](const Entries& entries) {
+            for (const auto& entry : entries) {
+                if (!entry.lifetime.expired()) {
+                    operation(*entry.jetProxy);
+                }
+            }
+        };
+
+        // the first exception thrown by the operation, rethrown after all jet peers are done
+        std::exception_ptr error;
+        std::vector < std::future < void > > done;
+        for (auto& iter : entriesByPeer) {
+            CommandQueue* commandQueue = CommandQueue::get(*iter.first);
+            if ((commandQueue == nullptr) || (commandQueue->isEventLoopThread())) {
+                try {
+                    execute(iter.second);
+                } catch (...) {
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                if (commandQueue) {
+                    // like below, notifications caused by the operation are published before returning
+                    NotificationDispatcher* dispatcher = NotificationDispatcher::get(*iter.first);
+                    if (dispatcher) {
+                        dispatcher->flush();
+                    }
+                }
+            } else {
+                // executed in parallel by the event loops of the jet peers
+                auto promise = std::make_shared < std::promise < void > >();
+                done.emplace_back(promise->get_future());
+                commandQueue->post([execute, entries = std::move(iter.second), promise, peer = iter.first]() {
+                    // the exception goes to the waiting caller, not to the event loop
+                    std::exception_ptr executeError;
+                    try {
+                        execute(entries);
+                    } catch (...) {
+                        executeError = std::current_exception();
+                    }
+                    // nothing refers to the jet proxies after returning
+                    NotificationDispatcher* dispatcher = NotificationDispatcher::get(*peer);
+                    if (dispatcher) {
+                        dispatcher->flush();
+                    }
+                    if (executeError) {
+                        promise->set_exception(executeError);
+                    } else {
+                        promise->set_value();
+                    }
+                });
+            }
+        }
+        // all posted operations refer to operation, none may be running when returning
+        for (auto& iter : done) {
+            // an event loop thread keeps executing the commands posted to it.
+            // Another event loop might wait for them, e.g. because it saves at the same time.
+            while (iter.wait_for(HELPING_WAIT_INTERVAL) != std::future_status::ready) {
+                if (!CommandQueue::executeForThisThread()) {
+                    iter.wait();
+                }
+            }
+        }
+        for (auto& iter : done) {
+            try {
+                iter.get();
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    bool ProxyRegistry::isInSubtree(const std::string& path, const std::string& prefix)
+    {
+        if (prefix.empty()) {
+            return true;
+        }
+        std::string_view subtree(prefix);
+        if (subtree.back() == '/') {
+            subtree.remove_suffix(1);
+        }
+        if (path.compare(0, subtree.size(), subtree) != 0) {
+            return false;
+        }
+        return (path.size() == subtree.size()) || (path[subtree.size()] == '/');
+    }
+
+    Json::Value ProxyRegistry::compose(const std::string& prefix) const
+    {
+        Json::Value config;
+        std::mutex configMutex;
+        /// walk to all existing jet proxies, that are marked as persistent, and save configurations as one json document to file
+        forEachInEventLoop(prefix, [&config, &configMutex](JetProxy& jetProxy) {
+            if (jetProxy.isPersistent()) {
+                Json::Value composition = jetProxy.composeAll();
+                std::lock_guard < std::mutex > lock(configMutex);
+                config[jetProxy.getPath()] = std::move(composition);
+            }
+        });
+        return config;
+    }
+
+    std::shared_ptr < const std::string > ProxyRegistry::getSavedComposition(const JetProxy& jetProxy, Format format, bool& composed)
+    {
+        std::uint64_t invalidationCount = 0;
+        if (jetProxy.m_state) {
+            if (auto published = jetProxy.m_state->getPublishedState().lock()) {
+                invalidationCount = published->getInvalidationCount();
+            }
+        }
+        if ((jetProxy.m_savedComposition) && (jetProxy.m_savedCompositionInvalidationCount == invalidationCount) && (jetProxy.m_savedCompositionFormat == format)) {
+            composed = false;
+            return jetProxy.m_savedComposition;
+        }
+
+        jetProxy.m_savedComposition = std::make_shared < const std::string >(serializeComposition(jetProxy.composeAll(), format));
+        jetProxy.m_savedCompositionInvalidationCount = invalidationCount;
+        jetProxy.m_savedCompositionFormat = format;
+        composed = true;
+        return jetProxy.m_savedComposition;
+    }
+
+    std::string ProxyRegistry::serializeComposition(const Json::Value& composition, Format format)
+    {
+        std::string serialized;
+        if (format == Format::CBOR) {
+            CborSerializer::encode(composition, serialized, false);
+        } else {
+            Json::StreamWriterBuilder builder;
+            builder["indentation"] = "  ";
+            serialized = Json::writeString(builder, composition);
+        }
+        if ((format == Format::JSON) && ((composition.isObject()) || (composition.isArray())) && (!composition.empty())) {
+            // indented as a member of the root object
+            std::string indented = "\n  ";
+            indented.reserve(serialized.size() + serialized.size() / 8);
+            for (char character : serialized) {
+                indented += character;
+                if (character == '\n') {
+                    indented += "  ";
+                }
+            }
+            serialized = std::move(indented);
+        }
+        return serialized;
+    }
+
+    ProxyRegistry::Compositions ProxyRegistry::composeSaved(const std::string& prefix) const
+    {
+        Compositions compositions;
+        std::mutex compositionsMutex;
+        const Format format = m_format;
+        forEachInEventLoop(prefix, [this, format, &compositions, &compositionsMutex](JetProxy& jetProxy) {
+            if (!jetProxy.isPersistent()) {
+                return;
+            }
+            bool composed;
+            std::shared_ptr < const std::string > composition = getSavedComposition(jetProxy, format, composed);
+            if (composed) {
+                ++m_composedCount;
+            } else {
+                ++m_reusedCount;
+            }
+            std::lock_guard < std::mutex > lock(compositionsMutex);
+            compositions.emplace(jetProxy.getPath(), std::move(composition));
+        });
+        return compositions;
+    }
+
+    ProxyRegistry::Compositions ProxyRegistry::composeSerialized(const std::string& prefix) const
+    {
+        if (m_incrementalSave) {
+            return composeSaved(prefix);
+        }
+        Compositions compositions;
+        std::mutex compositionsMutex;
+        const Format format = m_format;
+        forEachInEventLoop(prefix, [format, &compositions, &compositionsMutex](JetProxy& jetProxy) {
+            if (!jetProxy.isPersistent()) {
+                return;
+            }
+            auto composition = std::make_shared < const std::string >(serializeComposition(jetProxy.composeAll(), format));
+            std::lock_guard < std::mutex > lock(compositionsMutex);
+            compositions.emplace(jetProxy.getPath(), std::move(composition));
+        });
+        return compositions;
+    }
+
+    ProxyRegistry::Writer ProxyRegistry::createWriter(Json::Value config, Format format)
+    {
+        auto shared = std::make_shared < const Json::Value >(std::move(config));
+        if (format == Format::CBOR) {
+            return [shared](std::ostream& stream) {
+                std::string encoded;
+                CborSerializer::encode(*shared, encoded);
+                stream.write(encoded.data(), static_cast < std::streamsize >(encoded.size()));
+            };
+        }
+        return [shared](std::ostream& stream) {
+            Json::StreamWriterBuilder builder;
+            builder["indentation"] = "  ";
+            std::unique_ptr<Json::StreamWriter> writer(
+                        builder.newStreamWriter());
+            writer->write(*shared, &stream);
+        };
+    }
+
+    ProxyRegistry::Writer ProxyRegistry::createWriter(Compositions compositions, Format format)
+    {
+        auto shared = std::make_shared < const Compositions >(std::move(compositions));
+        if (format == Format::CBOR) {
+            // same encoding as of the complete document
+            return [shared](std::ostream& stream) {
+                std::string encoded;
+                CborSerializer::encodeHeader(encoded);
+                CborSerializer::encodeMapHeader(shared->size(), encoded);
+                for (const auto& iter : *shared) {
+                    CborSerializer::encodeString(iter.first, encoded);
+                    encoded += *iter.second;
+                }
+                stream.write(encoded.data(), static_cast < std::streamsize >(encoded.size()));
+            };
+        }
+        // same layout as written by the json writer
+        return [shared](std::ostream& stream) {
+            if (shared->empty()) {
+                stream << "{}";
+                return;
+            }
+            stream << "{\n";
+            for (auto iter = shared->begin(); iter != shared->end(); ++iter) {
+                if (iter != shared->begin()) {
+                    stream << ",\n";
+                }
+                stream << "  " << Json::valueToQuotedString(iter->first.c_str()) << " : " << *iter->second;
+            }
+            stream << "\n}";
+        };
+    }
+
+    int ProxyRegistry::writeFile(const std::string& fileName, const Writer& write, unsigned int generations, SaveDurations& durations) const
+    {
+        const auto phaseStart = std::chrono::steady_clock::now();
+
+        // we write to a temporary file and move to the real destination when finished.
+        const std::string tmpName = fileName + SnapshotFiles::TMP_SUFFIX;
+        std::ofstream tmpFile;
+        tmpFile.open(tmpName);
+        
+        if (!tmpFile) {
+            std::cerr << "could not open file '" << fileName << "' for writing" << std::endl;
+            return -1;
+        }
+        
+        write(tmpFile);
+        tmpFile.close();
+        if (!tmpFile) {
+            std::cerr << "could not write file '" << tmpName << "'" << std::endl;
+            std::remove(tmpName.c_str());
+            return -1;
+        }
+        durations.write = std::chrono::duration_cast < std::chrono::microseconds >(std::chrono::steady_clock::now() - phaseStart);
+        return replaceFile(fileName, generations, durations);
+    }
+
+    int ProxyRegistry::replaceFile(const std::string& fileName, unsigned int generations, SaveDurations& durations) const
+    {
+        auto phaseStart = std::chrono::steady_clock::now();
+        const std::string tmpName = fileName + SnapshotFiles::TMP_SUFFIX;
+
+        // content has to be on disk before it replaces the old file
+        if (SnapshotFiles::syncFile(tmpName, m_durability) < 0) {
+            std::remove(tmpName.c_str());
+            return -1;
+        }
+        auto phaseEnd = std::chrono::steady_clock::now();
+        durations.syncFile = std::chrono::duration_cast < std::chrono::microseconds >(phaseEnd - phaseStart);
+        phaseStart = phaseEnd;
+
+        const int result = SnapshotFiles::replace(fileName, generations, m_durability);
+        durations.rename = std::chrono::duration_cast < std::chrono::microseconds >(std::chrono::steady_clock::now() - phaseStart);
+        return result;
+    }
+
+    std::uint64_t ProxyRegistry::getSequence() const
+    {
+        std::lock_guard < std::mutex > lock(m_journalMutex);
+        return ++m_lastSequence;
+    }
+
+    std::uintmax_t ProxyRegistry::getUntrimmedJournalSize(const std::string& fileName, const Position& position) const
+    {
+        std::lock_guard < std::mutex > lock(m_journalMutex);
+        const std::uintmax_t trimmedJournal = m_fileStates[fileName].trimmedJournal;
+        if (position.journalOffset <= trimmedJournal) {
+            return 0;
+        }
+        return position.journalOffset - trimmedJournal;
+    }
+
+    ProxyRegistry::Position ProxyRegistry::getPosition(const std::string& fileName) const
+    {
+        std::lock_guard < std::mutex > lock(m_journalMutex);
+        Position position;
+        position.sequence = ++m_lastSequence;
+        position.journalSize = Journal::getSize(fileName);
+        position.journalOffset = m_fileStates[fileName].trimmedJournal + position.journalSize;
+        return position;
+    }
+
+    int ProxyRegistry::commit(const std::string& fileName, const Writer& write, const Position& position, SaveDurations& durations) const
+    {
+        std::uint64_t snapshotSequence;
+        {
+            std::lock_guard < std::mutex > lock(m_journalMutex);
+            FileState& fileState = m_fileStates[fileName];
+            if (position.sequence < fileState.writtenSequence) {
+                // a newer state was written meanwhile
+                return 0;
+            }
+            fileState.writtenSequence = position.sequence;
+            snapshotSequence = fileState.snapshotSequence;
+        }
+
+        const auto writeStart = std::chrono::steady_clock::now();
+        const unsigned int generations = std::max(m_generations.load(), 1u);
+        // serialized into the temporary file at once, length and checksum are computed on the way
+        const std::string tmpName = fileName + SnapshotFiles::TMP_SUFFIX;
+        std::ofstream tmpFile(tmpName, std::ios::binary);
+        if (!tmpFile) {
+            std::cerr << "could not open file '" << fileName << "' for writing" << std::endl;
+            return -1;
+        }
+        if (generations > 1) {
+            // replaced once length and checksum are known
+            tmpFile << SnapshotHeader::create(0, 0, 0);
+        }
+        std::uint64_t contentLength;
+        std::uint32_t contentChecksum;
+        SnapshotFiles::write(tmpFile, write, contentLength, contentChecksum);
+
+        if ((tmpFile) && (isWritten(fileName, contentLength, contentChecksum))) {
+            tmpFile.close();
+            std::remove(tmpName.c_str());
+            ++m_skippedWriteCount;
+            durations.write = std::chrono::duration_cast < std::chrono::microseconds >(std::chrono::steady_clock::now() - writeStart);
+            durations.skipped = true;
+            {
+                std::lock_guard < std::mutex > lock(m_saveDurationsMutex);
+                m_lastSaveDurations = durations;
+            }
+            // the journal records are part of the content nevertheless
+            return trimJournal(fileName, position.journalOffset);
+        }
+
+        if (generations > 1) {
+            if (snapshotSequence == 0) {
+                // continue the sequence of the files written before
+                snapshotSequence = SnapshotFiles::readLatestSequence(fileName, generations);
+            }
+            ++snapshotSequence;
+            tmpFile.seekp(0);
+            tmpFile << SnapshotHeader::create(snapshotSequence, contentLength, contentChecksum);
+        }
+        tmpFile.close();
+        if (!tmpFile) {
+            std::cerr << "could not write file '" << tmpName << "'" << std::endl;
+            std::remove(tmpName.c_str());
+            return -1;
+        }
+        durations.write = std::chrono::duration_cast < std::chrono::microseconds >(std::chrono::steady_clock::now() - writeStart);
+        if (replaceFile(fileName, generations, durations) < 0) {
+            return -1;
+        }
+        ++m_writeCount;
+        {
+            std::lock_guard < std::mutex > lock(m_journalMutex);
+            FileState& fileState = m_fileStates[fileName];
+            if (generations > 1) {
+                fileState.snapshotSequence = snapshotSequence;
+            }
+            std::error_code sizeError;
+            std::error_code timeError;
+            fileState.fileSize = std::filesystem::file_size(fileName, sizeError);
+            fileState.fileTime = std::filesystem::last_write_time(fileName, timeError);
+            fileState.written = (!sizeError) && (!timeError);
+            fileState.contentLength = contentLength;
+            fileState.contentChecksum = contentChecksum;
+        }
+        {
+            std::lock_guard < std::mutex > lock(m_saveDurationsMutex);
+            m_lastSaveDurations = durations;
+        }
+        return trimJournal(fileName, position.journalOffset);
+    }
+
+    bool ProxyRegistry::isWritten(const std::string& fileName, std::uint64_t contentLength, std::uint32_t contentChecksum) const
+    {
+        std::lock_guard < std::mutex > lock(m_journalMutex);
+        const FileState& fileState = m_fileStates[fileName];
+        if ((!fileState.written) || (fileState.contentLength != contentLength) || (fileState.contentChecksum != contentChecksum)) {
+            return false;
+        }
+        std::error_code sizeError;
+        std::error_code timeError;
+        const std::uintmax_t fileSize = std::filesystem::file_size(fileName, sizeError);
+        const std::filesystem::file_time_type fileTime = std::filesystem::last_write_time(fileName, timeError);
+        return (!sizeError) && (!timeError) && (fileSize == fileState.fileSize) && (fileTime == fileState.fileTime);
+    }
+
+    std::string ProxyRegistry::getGenerationFileName(const std::string& fileName, unsigned int generation)
+    {
+        return SnapshotFiles::getGenerationFileName(fileName, generation);
+    }
+
+    std::string ProxyRegistry::getJournalFileName(const std::string& fileName)
+    {
+        return Journal::getFileName(fileName);
+    }
+
+    std::uintmax_t ProxyRegistry::getJournalSize(const std::string& fileName)
+    {
+        return Journal::getSize(fileName);
+    }
+
+    std::uintmax_t ProxyRegistry::lockJournalSize(const std::string& fileName) const
+    {
+        std::lock_guard < std::mutex > lock(m_journalMutex);
+        return Journal::getSize(fileName);
+    }
+
+    int ProxyRegistry::trimJournal(const std::string& fileName, std::uintmax_t offset) const
+    {
+        std::lock_guard < std::mutex > lock(m_journalMutex);
+        FileState& fileState = m_fileStates[fileName];
+        if (offset <= fileState.trimmedJournal) {
+            return 0;
+        }
+        bool trimmed;
+        const int result = Journal::trim(fileName, offset - fileState.trimmedJournal, m_durability, trimmed);
+        if (trimmed) {
+            fileState.trimmedJournal = offset;
+        }
+        return result;
+    }
+
+    Json::Value ProxyRegistry::readConfig(const std::string& fileName) const
+    {
+        const std::uintmax_t journalSize = lockJournalSize(fileName);
+        Json::Value config(Json::objectValue);
+        try {
+            config = SnapshotFiles::read(SnapshotFiles::selectGeneration(fileName, m_generations));
+        } catch (const std::runtime_error& e) {
+            if (journalSize == 0) {
+                throw;
+            }
+            std::cerr << e.what() << ". Replaying journal only" << std::endl;
+        }
+        Journal::replay(fileName, journalSize, config);
+        return config;
+    }
+
+    int ProxyRegistry::saveToFile(const std::string& fileName) const
+    {
+        // records appended after this point might be newer than the composition and have to survive
+        const Position position = getPosition(fileName);
+        SaveDurations durations;
+        // composed without lock, the event loops might wait for it themselves. A newer composition that got committed meanwhile is kept.
+        const Writer writer = composeWriter(durations);
+        std::lock_guard < std::mutex > compactionLock(m_compactionMutex);
+        return commit(fileName, writer, position, durations);
+    }
+
+    ProxyRegistry::Writer ProxyRegistry::composeWriter(SaveDurations& durations) const
+    {
+        const auto start = std::chrono::steady_clock::now();
+        Writer writer;
+        if (m_incrementalSave) {
+            writer = createWriter(composeSaved(""), m_format);
+        } else {
+            writer = createWriter(compose(""), m_format);
+        }
+        durations.compose = std::chrono::duration_cast < std::chrono::microseconds >(std::chrono::steady_clock::now() - start);
+        return writer;
+    }
+
+    int ProxyRegistry::saveToFileAsync(const std::string& fileName, Completion completion) const
+    {
+        const Position position = getPosition(fileName);
+        SaveDurations durations;
+        Writer writer = composeWriter(durations);
+
+        std::lock_guard < std::mutex > lock(m_saveRequestsMutex);
+        if (!m_saveWorker.joinable()) {
+            m_saveWorker = std::thread(&ProxyRegistry::saveWorker, this);
+        }
+        if ((!m_saveRequests.empty()) && (m_saveRequests.back().fileName == fileName)) {
+            // the waiting save is replaced by the newer one
+            SaveRequest& request = m_saveRequests.back();
+            request.write = std::move(writer);
+            request.position = position;
+            request.durations = durations;
+            if (completion) {
+                request.completions.push_back(std::move(completion));
+            }
+            return 0;
+        }
+        SaveRequest request{fileName, std::move(writer), position, durations, {}};
+        if (completion) {
+            request.completions.push_back(std::move(completion));
+        }
+        m_saveRequests.push_back(std::move(request));
+        m_saveRequestsCondition.notify_all();
+        return 0;
+    }
+
+    void ProxyRegistry::waitForAsyncSaves() const
+    {
+        std::unique_lock < std::mutex > lock(m_saveRequestsMutex);
+        m_saveRequestsCondition.wait(lock, [this]() {
+            return (m_saveRequests.empty()) && (!m_saveInFlight);
+        });
+    }
+
+    void ProxyRegistry::saveWorker() const
+    {
+        std::unique_lock < std::mutex > lock(m_saveRequestsMutex);
+        while (true) {
+            m_saveRequestsCondition.wait(lock, [this]() {
+                return (!m_saveRequests.empty()) || (m_stopSaveWorker);
+            });
+            if (m_saveRequests.empty()) {
+                // stopped
+                return;
+            }
+            SaveRequest request = std::move(m_saveRequests.front());
+            m_saveRequests.pop_front();
+            m_saveInFlight = true;
+            lock.unlock();
+
+            int result;
+            {
+                std::lock_guard < std::mutex > compactionLock(m_compactionMutex);
+                result = commit(request.fileName, request.write, request.position, request.durations);
+            }
+            for (const auto& completion : request.completions) {
+                completion(result, request.durations);
+            }
+
+            lock.lock();
+            m_saveInFlight = false;
+            m_saveRequestsCondition.notify_all();
+        }
+    }
+
+    int ProxyRegistry::saveSubtreeToFile(const std::string& fileName, const std::string& prefix) const
+    {
+        // records appended after this point might be newer than the composition and have to survive
+        Position position = getPosition(fileName);
+        const auto start = std::chrono::steady_clock::now();
+        // composed without lock, the event loops might wait for it themselves
+        const Json::Value subtree = compose(prefix);
+
+        std::lock_guard < std::mutex > compactionLock(m_compactionMutex);
+        // a save meanwhile might have folded records into the file already
+        position.journalSize = getUntrimmedJournalSize(fileName, position);
+        Json::Value config(Json::objectValue);
+        const std::string generationFileName = SnapshotFiles::selectGeneration(fileName, m_generations);
+        std::error_code ec;
+        if (!std::filesystem::exists(generationFileName, ec)) {
+            std::cerr << "configuration file '" << fileName << "' does not exist. Saving subtree '" << prefix << "' to new file" << std::endl;
+        } else {
+            try {
+                config = SnapshotFiles::read(generationFileName);
+            } catch (const std::runtime_error& e) {
+                // the entries outside the subtree would get lost
+                std::cerr << e.what() << ". Not saving subtree '" << prefix << "'" << std::endl;
+                return -1;
+            }
+        }
+        Journal::replay(fileName, position.journalSize, config);
+
+        // entries of jet proxies that are gone or not persistent anymore have to disappear
+        for (const auto& path : config.getMemberNames()) {
+            if (isInSubtree(path, prefix)) {
+                config.removeMember(path);
+            }
+        }
+
+        for (Json::Value::const_iterator it = subtree.begin(); it != subtree.end(); ++it) {
+            config[it.key().asString()] = *it;
+        }
+        SaveDurations durations;
+        durations.compose = std::chrono::duration_cast < std::chrono::microseconds >(std::chrono::steady_clock::now() - start);
+        return commit(fileName, createWriter(std::move(config), m_format), position, durations);
+    }
+
+    int ProxyRegistry::exportToJson(const std::string& fileName, const std::string& jsonFileName) const
+    {
+        Json::Value config;
+        try {
+            config = readConfig(fileName);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << ". Nothing to export" << std::endl;
+            return -1;
+        }
+        SaveDurations durations;
+        return writeFile(jsonFileName, createWriter(std::move(config), Format::JSON), 1, durations);
+    }
+
+    std::string ProxyRegistry::getShardFileName(const std::string& directory, const std::string& path)
+    {
+        return ShardDirectory::getFileName(directory, path);
+    }
+
+    int ProxyRegistry::saveToDirectory(const std::string& directory) const
+    {
+        SaveDurations durations;
+        auto phaseStart = std::chrono::steady_clock::now();
+        const Format format = m_format;
+        const std::uint64_t sequence = getSequence();
+        // composed without lock, the event loops might wait for it themselves
+        const Compositions compositions = composeSerialized("");
+        auto phaseEnd = std::chrono::steady_clock::now();
+        durations.compose = std::chrono::duration_cast < std::chrono::microseconds >(phaseEnd - phaseStart);
+        phaseStart = phaseEnd;
+
+        std::lock_guard < std::mutex > compactionLock(m_compactionMutex);
+        std::uint64_t& writtenSequence = m_writtenShardsSequences[directory];
+        if (sequence < writtenSequence) {
+            // a newer composition was written meanwhile
+            return 0;
+        }
+        writtenSequence = sequence;
+
+        std::error_code ec;
+        std::filesystem::create_directories(directory, ec);
+        if (ec) {
+            std::cerr << "could not create directory '" << directory << "': " << ec.message() << std::endl;
+            return -1;
+        }
+        // files of shards found in the directory, those left over in the end are stale
+        std::set < std::string > staleFiles;
+        for (auto& entry : ShardDirectory::list(directory, ec)) {
+            staleFiles.insert(std::move(entry.fileName));
+        }
+        if (ec) {
+            std::cerr << "could not read directory '" << directory << "': " << ec.message() << std::endl;
+            return -1;
+        }
+
+        Compositions& writtenShards = m_writtenShards[directory];
+        // the jet paths of the shards written to temporary files
+        std::vector < std::string > changedShards;
+        // all shards are on disk before the first one replaces its old file
+        auto removeTmpFiles = [&directory, &changedShards]() {
+            for (const auto& iter : changedShards) {
+                std::remove((ShardDirectory::getFileName(directory, iter) + SnapshotFiles::TMP_SUFFIX).c_str());
+            }
+        };
+        std::uint64_t unchangedCount = 0;
+        for (const auto& iter : compositions) {
+            const std::string fileName = ShardDirectory::getFileName(directory, iter.first);
+            const bool exists = (staleFiles.erase(fileName) != 0);
+            staleFiles.erase(fileName + SnapshotFiles::TMP_SUFFIX);
+            auto writtenIter = writtenShards.find(iter.first);
+            if ((exists) && (writtenIter != writtenShards.end()) &&
+                ((writtenIter->second == iter.second) || (*writtenIter->second == *iter.second))) {
+                ++unchangedCount;
+                continue;
+            }
+
+            const std::string tmpName = fileName + SnapshotFiles::TMP_SUFFIX;
+            std::ofstream tmpFile(tmpName, std::ios::binary);
+            std::uint64_t length;
+            std::uint32_t checksum;
+            SnapshotFiles::write(tmpFile, createWriter(Compositions{ iter }, format), length, checksum);
+            tmpFile.close();
+            if (!tmpFile) {
+                std::cerr << "could not write file '" << tmpName << "'" << std::endl;
+                std::remove(tmpName.c_str());
+                removeTmpFiles();
+                return -1;
+            }
+            if ((exists) && (writtenIter == writtenShards.end())) {
+                // not written by us yet, e.g. after a restart
+                std::uint64_t fileLength;
+                std::uint32_t fileChecksum;
+                if ((SnapshotFiles::readChecksum(fileName, 0, fileLength, fileChecksum)) && (fileLength == length) && (fileChecksum == checksum)) {
+                    std::remove(tmpName.c_str());
+                    writtenShards[iter.first] = iter.second;
+                    ++unchangedCount;
+                    continue;
+                }
+            }
+            changedShards.push_back(iter.first);
+        }
+        phaseEnd = std::chrono::steady_clock::now();
+        durations.write = std::chrono::duration_cast < std::chrono::microseconds >(phaseEnd - phaseStart);
+        phaseStart = phaseEnd;
+
+        for (const auto& iter : changedShards) {
+            if (SnapshotFiles::syncFile(ShardDirectory::getFileName(directory, iter) + SnapshotFiles::TMP_SUFFIX, m_durability) < 0) {
+                removeTmpFiles();
+                return -1;
+            }
+        }
+        phaseEnd = std::chrono::steady_clock::now();
+        durations.syncFile = std::chrono::duration_cast < std::chrono::microseconds >(phaseEnd - phaseStart);
+        phaseStart = phaseEnd;
+
+        int result = 0;
+        for (const auto& iter : changedShards) {
+            const std::string fileName = ShardDirectory::getFileName(directory, iter);
+            std::filesystem::rename(fileName + SnapshotFiles::TMP_SUFFIX, fileName, ec);
+            if (ec) {
+                std::cerr << "Could not move shard to " << fileName << ": " << ec.message() << std::endl;
+                std::remove((fileName + SnapshotFiles::TMP_SUFFIX).c_str());
+                writtenShards.erase(iter);
+                result = -1;
+                continue;
+            }
+            writtenShards[iter] = compositions.at(iter);
+            ++m_writeCount;
+        }
+        // shards of jet proxies that are gone or not persistent anymore
+        for (const auto& fileName : staleFiles) {
+            if (std::remove(fileName.c_str()) != 0) {
+                std::cerr << "could not remove stale shard '" << fileName << "': " << std::strerror(errno) << std::endl;
+                result = -1;
+            }
+        }
+        for (auto iter = writtenShards.begin(); iter != writtenShards.end(); ) {
+            if (compositions.count(iter->first) == 0) {
+                iter = writtenShards.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+        m_skippedWriteCount += unchangedCount;
+
+        if ((changedShards.empty()) && (staleFiles.empty())) {
+            durations.skipped = true;
+        } else if (SnapshotFiles::syncDirectory(directory, m_durability) < 0) {
+            result = -1;
+        }
+        durations.rename = std::chrono::duration_cast < std::chrono::microseconds >(std::chrono::steady_clock::now() - phaseStart);
+        if (result == 0) {
+            std::lock_guard < std::mutex > lock(m_saveDurationsMutex);
+            m_lastSaveDurations = durations;
+        }
+        return result;
+    }
+
+    int ProxyRegistry::appendToJournal(const std::string& fileName, const std::vector < std::string >& paths) const
+    {
+        // jet path is the key, null if the entry is to be removed
+        Json::Value records(Json::objectValue);
+        std::mutex recordsMutex;
+        std::vector < std::string > unknownPaths;
+        forEachInEventLoop([this, &paths, &unknownPaths](const Operation& collect) {
+            std::shared_lock < std::shared_mutex > lock(m_mutex);
+            std::set < const JetProxy* > collected;
+            for (const auto& path : paths) {
+                // states of sub objects belong to the jet proxy above
+                JetProxy* owner = lookupOwner(path);
+                if (owner == nullptr) {
+                    unknownPaths.push_back(path);
+                } else if (collected.insert(owner).second) {
+                    collect(*owner);
+                }
+            }
+        }, [&records, &recordsMutex](JetProxy& jetProxy) {
+            Json::Value composition;
+            if (jetProxy.isPersistent()) {
+                composition = jetProxy.composeAll();
+            }
+            std::lock_guard < std::mutex > lock(recordsMutex);
+            records[jetProxy.getPath()] = std::move(composition);
+        });
+        for (const auto& path : unknownPaths) {
+            if (!records.isMember(path)) {
+                records[path] = Json::Value();
+            }
+        }
+        if (records.empty()) {
+            return 0;
+        }
+
+        std::string content = Journal::format(records);
+        std::lock_guard < std::mutex > lock(m_journalMutex);
+        return Journal::append(fileName, std::move(content), m_durability);
+    }
+
+    int ProxyRegistry::compactJournal(const std::string& fileName) const
+    {
+        std::lock_guard < std::mutex > compactionLock(m_compactionMutex);
+        const Position position = getPosition(fileName);
+        if (position.journalSize == 0) {
+            return 0;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        Json::Value config(Json::objectValue);
+        try {
+            config = SnapshotFiles::read(SnapshotFiles::selectGeneration(fileName, m_generations));
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << ". Compacting journal to new file" << std::endl;
+        }
+        Journal::replay(fileName, position.journalSize, config);
+        SaveDurations durations;
+        durations.compose = std::chrono::duration_cast < std::chrono::microseconds >(std::chrono::steady_clock::now() - start);
+        return commit(fileName, createWriter(std::move(config), m_format), position, durations);
+    }
+
+    int ProxyRegistry::restoreDefaults()
+    {
+        return restoreDefaults("");
+    }
+
+    int ProxyRegistry::restoreDefaults(const std::string& prefix)
+    {
+        forEachInEventLoop(prefix, [](JetProxy& jetProxy) {
+            try {
+                jetProxy.restoreDefaults();
+            } catch(const std::exception& e) {
+                std::cerr << "could not restore defaults for " << jetProxy.getPath() << ": " << e.what() << std::endl;
+            } catch(...) {
+                std::cerr << "could not restore defaults for " << jetProxy.getPath() << std::endl;
+            }
+        });
+        return 0;
+    }
+    
+    int ProxyRegistry::restoreFromFile(const std::string& fileName)
+    {
+        return restoreFromFile(fileName, "");
+    }
+
+    int ProxyRegistry::openConfig(const std::string& fileName, const std::string& prefix, std::shared_ptr < const ConfigIndex >& index, Json::Value& journal)
+    {
+        const std::uintmax_t journalSize = lockJournalSize(fileName);
+        try {
+            index = std::make_shared < const ConfigIndex >(SnapshotFiles::selectGeneration(fileName, m_generations));
+        } catch (const std::runtime_error& e) {
+            if (journalSize != 0) {
+                std::cerr << e.what() << ". Replaying journal only" << std::endl;
+            } else {
+                if (prefix.empty()) {
+                    std::cerr << e.what() << ". Restoring defaults for the complete service" << std::endl;
+                } else {
+                    std::cerr << e.what() << ". Restoring defaults for subtree '" << prefix << "'" << std::endl;
+                }
+                restoreDefaults(prefix);
+                return -1;
+            }
+        }
+        // small compared to the file, journals are folded into the file regularly
+        journal = Journal::read(fileName, journalSize);
+
+        auto reportMissing = [this, &prefix](const std::string& jetPath) {
+            if ((isInSubtree(jetPath, prefix)) && (find(jetPath)==nullptr)) {
+                std::cout << "could not restore " << jetPath << ": fbproxy does not exist\n";
+            }
+        };
+        if (index) {
+            for (const auto& jetPath : index->getPaths()) {
+                if (!journal.isMember(jetPath)) {
+                    reportMissing(jetPath);
+                }
+            }
+        }
+        for (Json::Value::const_iterator it = journal.begin(); it != journal.end(); ++it) {
+            if (!it->isNull()) {
+                reportMissing(it.name());
+            }
+        }
+        return 0;
+    }
+
+    bool ProxyRegistry::restoreJetProxy(JetProxy& jetProxy, const ConfigIndex* index, const Json::Value& journal)
+    {
+        const std::string& jetPath = jetProxy.getPath();
+        const Json::Value* journalConfig = journal.find(jetPath.data(), jetPath.data() + jetPath.size());
+        if ((journalConfig != nullptr) && (journalConfig->isNull())) {
+            // removed after the file was written
+            return true;
+        }
+        if ((journalConfig == nullptr) && ((index == nullptr) || (!index->contains(jetPath)))) {
+            return true;
+        }
+        if (!jetProxy.isPersistent()) {
+            std::cerr << jetPath << " is marked as non-persistent and won't be restored!" << std::endl;
+            return true;
+        }
+        if (journalConfig != nullptr) {
+            return applyConfig(jetProxy, *journalConfig, std::exception_ptr());
+        }
+        Json::Value config;
+        std::exception_ptr error;
+        try {
+            config = index->find(jetPath);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        return applyConfig(jetProxy, config, error);
+    }
+
+    bool ProxyRegistry::applyConfig(JetProxy& jetProxy, const Json::Value& config, const std::exception_ptr& error)
+    {
+        const std::string& jetPath = jetProxy.getPath();
+        try {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            jetProxy.setAll(config);
+            // values might have been adjusted while setting
+            return isEquivalent(jetProxy.composeAll(), config);
+        } catch(const std::exception& excRestore) {
+            // any exception of setConfig() (e.g. Json::LogicError on a mistyped value) is confined to this jet proxy
+            std::cerr << "could not restore " << jetPath << ": " << excRestore.what() << ". Restoring defaults!" << std::endl;
+        } catch(...) {
+            std::cerr << "could not restore " << jetPath << ". Restoring defaults!" << std::endl;
+        }
+        try {
+            jetProxy.restoreDefaults();
+        } catch(const std::exception& excRestoreDefaults) {
+            std::cerr << "could not restore defaults for " << jetPath << ": " << excRestoreDefaults.what() << std::endl;
+        } catch(...) {
+            std::cerr << "could not restore defaults for " << jetPath << std::endl;
+        }
+        return false;
+    }
+
+    int ProxyRegistry::restoreFromFile(const std::string& fileName, const std::string& prefix)
+    {
+        std::shared_ptr < const ConfigIndex > index;
+        Json::Value journal;
+        if (openConfig(fileName, prefix, index, journal) < 0) {
+            return -1;
+        }
+        std::vector < std::string > deviations;
+        for (const auto& layer : getRestoreLayers(prefix, index.get(), journal)) {
+            restoreLayer(layer, index.get(), journal, deviations);
+        }
+        announceDeviations(deviations);
+        return 0;
+    }
+
+    int ProxyRegistry::restoreFromDirectory(const std::string& directory)
+    {
+        return restoreFromDirectory(directory, "");
+    }
+
+    int ProxyRegistry::restoreFromDirectory(const std::string& directory, const std::string& prefix)
+    {
+        // jet path and file name of the shards in the subtree, the jet path of a shortened name is empty until read from the shard
+        std::vector < std::pair < std::string, std::string > > shards;
+        std::error_code ec;
+        for (auto& entry : ShardDirectory::list(directory, ec)) {
+            if (entry.tmp) {
+                continue;
+            }
+            if (!entry.shortened) {
+                if (isInSubtree(entry.path, prefix)) {
+                    shards.emplace_back(std::move(entry.path), std::move(entry.fileName));
+                }
+            } else if ((entry.path.compare(0, prefix.size(), prefix) == 0) || (prefix.compare(0, entry.path.size(), entry.path) == 0)) {
+                // the beginning might belong to the subtree
+                shards.emplace_back(std::string(), std::move(entry.fileName));
+            }
+        }
+        if (ec) {
+            if (prefix.empty()) {
+                std::cerr << "could not read directory '" << directory << "': " << ec.message() << ". Restoring defaults for the complete service" << std::endl;
+            } else {
+                std::cerr << "could not read directory '" << directory << "': " << ec.message() << ". Restoring defaults for subtree '" << prefix << "'" << std::endl;
+            }
+            restoreDefaults(prefix);
+            return -1;
+        }
+
+        std::vector < Json::Value > configs(shards.size());
+        std::vector < std::exception_ptr > errors(shards.size());
+        auto parse = [&directory, &shards, &configs, &errors](std::size_t begin, std::size_t end) {
+            for (std::size_t position = begin; position < end; ++position) {
+                try {
+                    configs[position] = ShardDirectory::read(directory, shards[position].second, shards[position].first);
+                } catch (...) {
+                    errors[position] = std::current_exception();
+                }
+            }
+        };
+        const std::size_t parsers = std::max < std::size_t >(std::min < std::size_t >(m_restoreThreads.load(), shards.size()), 1);
+        std::vector < std::future < void > > parsed;
+        for (std::size_t parser = 1; parser < parsers; ++parser) {
+            parsed.emplace_back(std::async(std::launch::async, parse, parser * shards.size() / parsers, (parser + 1) * shards.size() / parsers));
+        }
+        parse(0, shards.size() / parsers);
+        for (auto& iter : parsed) {
+            iter.wait();
+        }
+
+        // damaged shards with shortened name, their jet proxies are found by the shard names of the registered ones
+        std::map < std::string, std::size_t > unresolved;
+        for (std::size_t position = 0; position < shards.size(); ++position) {
+            if (shards[position].first.empty()) {
+                unresolved.emplace(shards[position].second, position);
+            }
+        }
+        if (!unresolved.empty()) {
+            forEach(prefix, [&directory, &shards, &unresolved](JetProxy& jetProxy) {
+                auto iter = unresolved.find(ShardDirectory::getFileName(directory, jetProxy.getPath()));
+                if (iter != unresolved.end()) {
+                    shards[iter->second].first = jetProxy.getPath();
+                }
+            });
+        }
+
+        // takes the role of the journal, the layers are restored from it only
+        Json::Value entries(Json::objectValue);
+        // jet proxies with a damaged shard
+        std::map < std::string, std::exception_ptr > damaged;
+        for (std::size_t position = 0; position < shards.size(); ++position) {
+            const std::string& jetPath = shards[position].first;
+            if (jetPath.empty()) {
+                std::cout << "could not restore shard '" << shards[position].second << "': fbproxy does not exist\n";
+            } else if (!isInSubtree(jetPath, prefix)) {
+                continue;
+            } else if (find(jetPath) == nullptr) {
+                std::cout << "could not restore " << jetPath << ": fbproxy does not exist\n";
+            } else if (errors[position]) {
+                damaged.emplace(jetPath, errors[position]);
+            } else {
+                entries[jetPath].swap(configs[position]);
+            }
+        }
+        configs.clear();
+
+        std::vector < std::string > deviations;
+        for (const auto& layer : getRestoreLayers(prefix, nullptr, entries)) {
+            restoreLayer(layer, nullptr, entries, deviations);
+        }
+        if (!damaged.empty()) {
+            std::mutex deviationsMutex;
+            std::vector < std::string > marked;
+            try {
+                forEachInEventLoop([this, &damaged](const Operation& collect) {
+                    std::shared_lock < std::shared_mutex > lock(m_mutex);
+                    for (const auto& iter : damaged) {
+                        const Node* node = findNode(iter.first);
+                        if ((node) && (node->jetProxy)) {
+                            collect(*node->jetProxy);
+                        }
+                    }
+                }, [this, &damaged, &deviations, &marked, &deviationsMutex](JetProxy& jetProxy) {
+                    const std::string& jetPath = jetProxy.getPath();
+                    if (!jetProxy.isPersistent()) {
+                        std::cerr << jetPath << " is marked as non-persistent and won't be restored!" << std::endl;
+                        return;
+                    }
+                    markRestoring(jetPath);
+                    {
+                        std::lock_guard < std::mutex > lock(deviationsMutex);
+                        marked.push_back(jetPath);
+                    }
+                    // restores the defaults
+                    if (!applyConfig(jetProxy, Json::Value(), damaged.at(jetPath))) {
+                        std::lock_guard < std::mutex > lock(deviationsMutex);
+                        deviations.push_back(jetPath);
+                    }
+                });
+            } catch (...) {
+                unmarkRestoring(marked);
+                throw;
+            }
+            unmarkRestoring(marked);
+        }
+        announceDeviations(deviations);
+        return 0;
+    }
+
+    bool ProxyRegistry::isRestoring(const std::string& path) const
+    {
+        if (m_restoringCount == 0) {
+            return false;
+        }
+        std::lock_guard < std::mutex > lock(m_restoringMutex);
+        // the jet proxy owning the state is the state itself or above it
+        std::string_view candidate(path);
+        while (true) {
+            if (m_restoringPaths.find(std::string(candidate)) != m_restoringPaths.end()) {
+                return true;
+            }
+            const std::size_t separator = candidate.rfind('/');
+            if ((separator == std::string_view::npos) || (separator == 0)) {
+                return false;
+            }
+            candidate = candidate.substr(0, separator);
+        }
+    }
+
+    void ProxyRegistry::markRestoring(const std::string& path) const
+    {
+        std::lock_guard < std::mutex > lock(m_restoringMutex);
+        m_restoringPaths.insert(path);
+        ++m_restoringCount;
+    }
+
+    void ProxyRegistry::unmarkRestoring(const std::vector < std::string >& paths) const
+    {
+        std::lock_guard < std::mutex > lock(m_restoringMutex);
+        for (const auto& path : paths) {
+            const auto iter = m_restoringPaths.find(path);
+            if (iter != m_restoringPaths.end()) {
+                m_restoringPaths.erase(iter);
+                --m_restoringCount;
+            }
+        }
+    }
+
+    void ProxyRegistry::announceDeviations(const std::vector < std::string >& deviations)
+    {
+        for (const auto& path : deviations) {
+            ChangeBus::getDefault().announce(path);
+        }
+    }
+
+    ProxyRegistry::RestoreLayers ProxyRegistry::getRestoreLayers(const std::string& prefix, const ConfigIndex* index, const Json::Value& journal) const
+    {
+        struct Vertex {
+            Handle handle;
+            std::vector < std::string > dependencies;
+            std::size_t pendingDependencies = 0;
+            std::vector < Vertex* > dependents;
+        };
+        // jet path is the key
+        std::map < std::string, Vertex > vertices;
+        std::mutex verticesMutex;
+        forEachInEventLoop(prefix, [this, index, &journal, &vertices, &verticesMutex](JetProxy& jetProxy) {
+            const std::string& jetPath = jetProxy.getPath();
+            const Json::Value* journalConfig = journal.find(jetPath.data(), jetPath.data() + jetPath.size());
+            const bool hasConfig = (journalConfig != nullptr) ? !journalConfig->isNull() : ((index != nullptr) && (index->contains(jetPath)));
+            if (!hasConfig) {
+                return;
+            }
+            std::vector < std::string > dependencies = jetProxy.getRestoreDependencies();
+            Handle handle = getHandle(jetPath);
+            std::lock_guard < std::mutex > lock(verticesMutex);
+            Vertex& vertex = vertices[jetPath];
+            vertex.handle = std::move(handle);
+            vertex.dependencies = std::move(dependencies);
+        });
+
+        // Kahn's algorithm, dependencies that are not restored do not count
+        std::vector < Vertex* > ready;
+        for (auto& iter : vertices) {
+            for (const auto& dependency : iter.second.dependencies) {
+                auto dependencyIter = vertices.find(dependency);
+                if ((dependencyIter != vertices.end()) && (&dependencyIter->second != &iter.second)) {
+                    dependencyIter->second.dependents.push_back(&iter.second);
+                    ++iter.second.pendingDependencies;
+                }
+            }
+        }
+        for (auto& iter : vertices) {
+            if (iter.second.pendingDependencies == 0) {
+                ready.push_back(&iter.second);
+            }
+        }
+
+        RestoreLayers layers;
+        std::size_t layered = 0;
+        while (!ready.empty()) {
+            std::vector < Vertex* > next;
+            layers.emplace_back();
+            for (Vertex* vertex : ready) {
+                layers.back().push_back(vertex->handle);
+                for (Vertex* dependent : vertex->dependents) {
+                    if (--dependent->pendingDependencies == 0) {
+                        next.push_back(dependent);
+                    }
+                }
+            }
+            layered += ready.size();
+            ready.swap(next);
+        }
+        if (layered < vertices.size()) {
+            layers.emplace_back();
+            for (const auto& iter : vertices) {
+                if (iter.second.pendingDependencies != 0) {
+                    std::cerr << "cyclic restore dependency of " << iter.first << std::endl;
+                    layers.back().push_back(iter.second.handle);
+                }
+            }
+        }
+        return layers;
+    }
+
+    void ProxyRegistry::restoreLayer(const std::vector < Handle >& layer, const ConfigIndex* index, const Json::Value& journal, std::vector < std::string >& deviations) const
+    {
+        std::mutex deviationsMutex;
+        // bounds the parsed configurations held at a time
+        static const std::size_t BATCH_SIZE = 256;
+        const std::size_t threads = std::max(m_restoreThreads.load(), 1u);
+
+        for (std::size_t batchBegin = 0; batchBegin < layer.size(); batchBegin += BATCH_SIZE) {
+            const std::size_t batchSize = std::min(BATCH_SIZE, layer.size() - batchBegin);
+            std::vector < Json::Value > configs(batchSize);
+            std::vector < std::exception_ptr > errors(batchSize);
+            auto parse = [&](std::size_t begin, std::size_t end) {
+                for (std::size_t position = begin; position < end; ++position) {
+                    const std::string& jetPath = layer[batchBegin + position].path;
+                    if (journal.isMember(jetPath)) {
+                        continue;
+                    }
+                    try {
+                        configs[position] = index->find(jetPath);
+                    } catch (...) {
+                        errors[position] = std::current_exception();
+                    }
+                }
+            };
+            const std::size_t parsers = std::min(threads, batchSize);
+            std::vector < std::future < void > > parsed;
+            for (std::size_t parser = 1; parser < parsers; ++parser) {
+                parsed.emplace_back(std::async(std::launch::async, parse, parser * batchSize / parsers, (parser + 1) * batchSize / parsers));
+            }
+            parse(0, batchSize / parsers);
+            for (auto& iter : parsed) {
+                iter.wait();
+            }
+
+            std::unordered_map < std::string, std::size_t > positions;
+            for (std::size_t position = 0; position < batchSize; ++position) {
+                positions.emplace(layer[batchBegin + position].path, position);
+            }
+            std::vector < std::string > marked;
+            try {
+                forEachInEventLoop([this, &layer, batchBegin, batchSize](const Operation& collect) {
+                    std::shared_lock < std::shared_mutex > lock(m_mutex);
+                    for (std::size_t position = batchBegin; position < batchBegin + batchSize; ++position) {
+                        const Handle& handle = layer[position];
+                        const Node* node = findNode(handle.path);
+                        if ((node) && (node->jetProxy) && (node->generation == handle.generation)) {
+                            collect(*node->jetProxy);
+                        }
+                    }
+                }, [this, &positions, &configs, &errors, &journal, &deviations, &marked, &deviationsMutex](JetProxy& jetProxy) {
+                    const std::string& jetPath = jetProxy.getPath();
+                    if (!jetProxy.isPersistent()) {
+                        std::cerr << jetPath << " is marked as non-persistent and won't be restored!" << std::endl;
+                        return;
+                    }
+                    // until the notifications of the batch were published by the event loop
+                    markRestoring(jetPath);
+                    {
+                        std::lock_guard < std::mutex > lock(deviationsMutex);
+                        marked.push_back(jetPath);
+                    }
+                    bool equal;
+                    const Json::Value* journalConfig = journal.find(jetPath.data(), jetPath.data() + jetPath.size());
+                    if (journalConfig != nullptr) {
+                        equal = applyConfig(jetProxy, *journalConfig, std::exception_ptr());
+                    } else {
+                        const std::size_t position = positions.at(jetPath);
+                        equal = applyConfig(jetProxy, configs[position], errors[position]);
+                    }
+                    if (!equal) {
+                        std::lock_guard < std::mutex > lock(deviationsMutex);
+                        deviations.push_back(jetPath);
+                    }
+                });
+            } catch (...) {
+                unmarkRestoring(marked);
+                throw;
+            }
+            unmarkRestoring(marked);
+        }
+    }
+
+    void ProxyRegistry::setRestoreThreads(unsigned int threads)
+    {
+        m_restoreThreads = threads;
+    }
+
+    struct ProxyRegistry::SlicedRestore {
+        struct Entry {
+            JetProxy* jetProxy;
+            std::weak_ptr < const bool > lifetime;
+        };
+        using Entries = std::vector < Entry >;
+
+        ProxyRegistry* registry;
+        std::shared_ptr < const ConfigIndex > index;
+        Json::Value journal;
+        std::size_t sliceCount;
+        std::chrono::microseconds sliceDuration;
+        /// One per jet peer
+        std::vector < Entries > entriesByPeer;
+        std::vector < hbk::jet::PeerAsync* > peers;
+        std::size_t total;
+
+        std::mutex mutex;
+        std::size_t restored;
+        /// See restoreLayer()
+        std::vector < std::string > deviations;
+        RestoreProgress progress;
+        RestoreCompletion completion;
+    };
+
+    void ProxyRegistry::setRestoreSlice(std::size_t count, std::chrono::microseconds duration)
+    {
+        m_restoreSliceCount = count;
+        m_restoreSliceDuration = duration;
+    }
+
+    int ProxyRegistry::restoreFromFileSliced(const std::string& fileName, const std::string& prefix, RestoreProgress progress, RestoreCompletion completion)
+    {
+        auto restore = std::make_shared < SlicedRestore >();
+        if (openConfig(fileName, prefix, restore->index, restore->journal) < 0) {
+            if (completion) {
+                completion(-1);
+            }
+            return -1;
+        }
+        restore->registry = this;
+        restore->sliceCount = std::max(m_restoreSliceCount.load(), std::size_t(1));
+        restore->sliceDuration = m_restoreSliceDuration;
+        restore->total = 0;
+        restore->restored = 0;
+        restore->progress = std::move(progress);
+        restore->completion = std::move(completion);
+
+        std::vector < hbk::jet::PeerAsync* >& peers = restore->peers;
+        {
+            std::unordered_map < hbk::jet::PeerAsync*, std::size_t > peerIndices;
+            forEach(prefix, [&restore, &peers, &peerIndices](JetProxy& jetProxy) {
+                const auto iter = peerIndices.emplace(&jetProxy.m_jetPeer, peers.size()).first;
+                if (iter->second == peers.size()) {
+                    peers.push_back(&jetProxy.m_jetPeer);
+                    restore->entriesByPeer.emplace_back();
+                }
+                restore->entriesByPeer[iter->second].push_back(SlicedRestore::Entry{&jetProxy, jetProxy.m_lifetime});
+                ++restore->total;
+            });
+        }
+        if (restore->total == 0) {
+            if (restore->completion) {
+                restore->completion(0);
+            }
+            return 0;
+        }
+
+        for (std::size_t peerIndex = 0; peerIndex < peers.size(); ++peerIndex) {
+            CommandQueue* commandQueue = CommandQueue::get(*peers[peerIndex]);
+            if (commandQueue) {
+                deferSlice(restore, *commandQueue, peerIndex, 0);
+            } else {
+                const std::size_t size = restore->entriesByPeer[peerIndex].size();
+                for (std::size_t position = 0; position < size;) {
+                    position = restoreSlice(*restore, peerIndex, position);
+                }
+            }
+        }
+        return 0;
+    }
+
+    std::size_t ProxyRegistry::restoreSlice(SlicedRestore& restore, std::size_t peerIndex, std::size_t position)
+    {
+        const SlicedRestore::Entries& entries = restore.entriesByPeer[peerIndex];
+        const auto start = std::chrono::steady_clock::now();
+        std::size_t count = 0;
+        std::vector < std::string > deviations;
+        std::vector < std::string > marked;
+        try {
+            while (position < entries.size()) {
+                const SlicedRestore::Entry& entry = entries[position++];
+                if (!entry.lifetime.expired()) {
+                    const std::string& jetPath = entry.jetProxy->getPath();
+                    restore.registry->markRestoring(jetPath);
+                    marked.push_back(jetPath);
+                    bool equal = false;
+                    try {
+                        equal = restoreJetProxy(*entry.jetProxy, restore.index.get(), restore.journal);
+                    } catch (const std::exception& e) {
+                        // the remaining slices and the completion must not be skipped
+                        std::cerr << "could not restore " << jetPath << ": " << e.what() << std::endl;
+                    } catch (...) {
+                        std::cerr << "could not restore " << jetPath << std::endl;
+                    }
+                    if (!equal) {
+                        deviations.push_back(jetPath);
+                    }
+                }
+                ++count;
+                if ((count >= restore.sliceCount) || (std::chrono::steady_clock::now() - start >= restore.sliceDuration)) {
+                    break;
+                }
+            }
+            CommandQueue* commandQueue = CommandQueue::get(*restore.peers[peerIndex]);
+            if ((commandQueue) && (commandQueue->isEventLoopThread())) {
+                // notifications of this slice are published while its jet proxies count as restoring
+                NotificationDispatcher* dispatcher = NotificationDispatcher::get(*restore.peers[peerIndex]);
+                if (dispatcher) {
+                    dispatcher->flush();
+                }
+            }
+        } catch (...) {
+            restore.registry->unmarkRestoring(marked);
+            throw;
+        }
+        restore.registry->unmarkRestoring(marked);
+
+        std::lock_guard < std::mutex > lock(restore.mutex);
+        restore.restored += count;
+        restore.deviations.insert(restore.deviations.end(), deviations.begin(), deviations.end());
+        if (restore.progress) {
+            restore.progress(restore.restored, restore.total);
+        }
+        if (restore.restored == restore.total) {
+            announceDeviations(restore.deviations);
+            if (restore.completion) {
+                restore.completion(0);
+            }
+        }
+        return position;
+    }
+
+    void ProxyRegistry::deferSlice(const std::shared_ptr < SlicedRestore >& restore, CommandQueue& commandQueue, std::size_t peerIndex, std::size_t position)
+    {
+        commandQueue.defer([restore, &commandQueue, peerIndex, position]() {
+            const std::size_t next = restoreSlice(*restore, peerIndex, position);
+            if (next < restore->entriesByPeer[peerIndex].size()) {
+                deferSlice(restore, commandQueue, peerIndex, next);
+            }
+        });
+    }
+}
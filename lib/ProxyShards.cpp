@@ -0,0 +1,122 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hbk/sys/eventloop.h"
+#include "jet/peerasync.hpp"
+
+#include "jetproxy/CommandQueue.hpp"
+#include "jetproxy/NotificationDispatcher.hpp"
+#include "jetproxy/ProxyShards.hpp"
+
+namespace hbk::jetproxy
+{
+    ProxyShards::Shard::Shard(const std::string& address, unsigned int port)
+        : eventloop()
+        , peer(eventloop, address, port)
+        , dispatcher(eventloop, peer)
+        , commandQueue(eventloop, peer)
+    {
+    }
+
+    ProxyShards::ProxyShards(std::size_t count, const std::string& address, unsigned int port)
+    {
+        if (count == 0) {
+            throw std::runtime_error("Could not create proxy shards. At least one shard is required!");
+        }
+
+        std::vector < std::future < void > > running;
+        try {
+            for (std::size_t index = 0; index < count; ++index) {
+                auto shard = std::make_unique < Shard >(address, port);
+                shard->thread = std::thread(std::bind(&hbk::sys::EventLoop::execute, std::ref(shard->eventloop)));
+
+                // The command queue learns its event loop thread by executing a command.
+                // Before, commands posted from the event loop thread would wait for themselves.
+                auto promise = std::make_shared < std::promise < void > >();
+                running.emplace_back(promise->get_future());
+                shard->commandQueue.post([promise]() {
+                    promise->set_value();
+                });
+                m_shards.emplace_back(std::move(shard));
+            }
+        } catch (...) {
+            stop();
+            throw;
+        }
+        for (auto& iter : running) {
+            iter.wait();
+        }
+    }
+
+    ProxyShards::~ProxyShards()
+    {
+        stop();
+    }
+
+    void ProxyShards::stop()
+    {
+        for (auto& shard : m_shards) {
+            shard->eventloop.stop();
+        }
+        for (auto& shard : m_shards) {
+            if (shard->thread.joinable()) {
+                shard->thread.join();
+            }
+        }
+    }
+
+    std::size_t ProxyShards::getIndex(const std::string& path) const
+    {
+        return std::hash < std::string >()(path) % m_shards.size();
+    }
+
+    hbk::jet::PeerAsync& ProxyShards::getPeer(const std::string& path)
+    {
+        return m_shards[getIndex(path)]->peer;
+    }
+
+    hbk::jet::PeerAsync& ProxyShards::getPeer(std::size_t index)
+    {
+        return m_shards.at(index)->peer;
+    }
+
+    hbk::sys::EventLoop& ProxyShards::getEventLoop(std::size_t index)
+    {
+        return m_shards.at(index)->eventloop;
+    }
+
+    CommandQueue& ProxyShards::getCommandQueue(std::size_t index)
+    {
+        return m_shards.at(index)->commandQueue;
+    }
+}
@@ -0,0 +1,74 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "json/value.h"
+
+#include "jet/peerasync.hpp"
+
+#include "jetproxy/ChangeBus.hpp"
+#include "jetproxy/PublishedState.hpp"
+
+namespace hbk::jetproxy
+{
+    PublishedState::PublishedState(hbk::jet::PeerAsync& peer, const std::string& path, const Json::Value& initialValue, bool announceChanges)
+        : m_peer(peer)
+        , m_path(path)
+        , m_announceChanges(announceChanges)
+        , m_valid(true)
+        , m_value(initialValue)
+        , m_suppressedCount(0)
+        , m_invalidationCount(0)
+        , m_minInterval(0)
+        // nothing was published yet, the first notification is not held back
+        , m_lastPublishTime(std::chrono::steady_clock::time_point::min())
+    {
+    }
+
+    bool PublishedState::publish(const Json::Value& value)
+    {
+        if ((m_valid) && (m_value == value)) {
+            ++m_suppressedCount;
+            ++s_totalSuppressedCount;
+            return false;
+        }
+        m_value = value;
+        m_valid = true;
+        m_lastPublishTime = std::chrono::steady_clock::now();
+        m_peer.notifyState(m_path, value);
+        if (m_announceChanges) {
+            ChangeBus::getDefault().announce(m_path);
+        }
+        return true;
+    }
+
+    void PublishedState::invalidate()
+    {
+        m_valid = false;
+        ++m_invalidationCount;
+    }
+}
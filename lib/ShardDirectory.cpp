@@ -0,0 +1,182 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "json/value.h"
+
+#include "jetproxy/ShardDirectory.hpp"
+#include "jetproxy/SnapshotFiles.hpp"
+
+namespace hbk::jetproxy {
+
+    static const char SHARD_SUFFIX[] = ".config";
+    /// NAME_MAX of common file systems, leaves room for SnapshotFiles::TMP_SUFFIX
+    static const std::size_t MAX_SHARD_NAME_SIZE = 255 - (sizeof(SnapshotFiles::TMP_SUFFIX) - 1);
+    /// Separates the shortened beginning of a shard name from the hash of the complete jet path
+    static const char SHARD_HASH_SEPARATOR = '~';
+    static const std::size_t SHARD_HASH_DIGITS = 16;
+
+    /// \return -1 if character is no hexadecimal digit
+    static int getHexValue(char character)
+    {
+        if ((character >= '0') && (character <= '9')) {
+            return character - '0';
+        }
+        if ((character >= 'A') && (character <= 'F')) {
+            return character - 'A' + 10;
+        }
+        if ((character >= 'a') && (character <= 'f')) {
+            return character - 'a' + 10;
+        }
+        return -1;
+    }
+
+    /// FNV-1a, unlike std::hash the same on every platform and with every standard library
+    static std::uint64_t getShardHash(const std::string& path)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (char character : path) {
+            hash ^= static_cast < unsigned char >(character);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string ShardDirectory::getFileName(const std::string& directory, const std::string& path)
+    {
+        static const char HEX_DIGITS[] = "0123456789ABCDEF";
+        std::string name;
+        name.reserve(path.size() + path.size() / 2 + sizeof(SHARD_SUFFIX));
+        for (char character : path) {
+            if (((character >= '0') && (character <= '9')) || ((character >= 'A') && (character <= 'Z')) ||
+                ((character >= 'a') && (character <= 'z')) || (character == '-') || (character == '_') || (character == '.')) {
+                name += character;
+            } else {
+                const auto value = static_cast < unsigned char >(character);
+                name += '%';
+                name += HEX_DIGITS[value / 16];
+                name += HEX_DIGITS[value % 16];
+            }
+        }
+        if (name.size() + sizeof(SHARD_SUFFIX) - 1 > MAX_SHARD_NAME_SIZE) {
+            // the beginning keeps the shards of a subtree together, the hash of the complete jet path tells them apart
+            name.resize(MAX_SHARD_NAME_SIZE - (sizeof(SHARD_SUFFIX) - 1) - SHARD_HASH_DIGITS - 1);
+            // does not cut an encoded character
+            const std::size_t escape = name.find('%', name.size() - std::min < std::size_t >(name.size(), 2));
+            if (escape != std::string::npos) {
+                name.resize(escape);
+            }
+            const std::uint64_t hash = getShardHash(path);
+            name += SHARD_HASH_SEPARATOR;
+            for (std::size_t digit = SHARD_HASH_DIGITS; digit > 0; --digit) {
+                name += HEX_DIGITS[(hash >> ((digit - 1) * 4)) & 0xf];
+            }
+        }
+        name += SHARD_SUFFIX;
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    bool ShardDirectory::decodeName(const std::string& name, std::string& path, bool& shortened)
+    {
+        const std::size_t suffixSize = sizeof(SHARD_SUFFIX) - 1;
+        if ((name.size() <= suffixSize) || (name.compare(name.size() - suffixSize, suffixSize, SHARD_SUFFIX) != 0)) {
+            return false;
+        }
+        std::size_t end = name.size() - suffixSize;
+        // the separator is percent-encoded within jet paths
+        shortened = (end > SHARD_HASH_DIGITS) && (name[end - SHARD_HASH_DIGITS - 1] == SHARD_HASH_SEPARATOR);
+        if (shortened) {
+            for (std::size_t position = end - SHARD_HASH_DIGITS; position < end; ++position) {
+                if (getHexValue(name[position]) < 0) {
+                    return false;
+                }
+            }
+            end -= SHARD_HASH_DIGITS + 1;
+        }
+        path.clear();
+        for (std::size_t position = 0; position < end; ++position) {
+            if (name[position] != '%') {
+                path += name[position];
+                continue;
+            }
+            if (position + 2 >= end) {
+                return false;
+            }
+            const int high = getHexValue(name[position + 1]);
+            const int low = getHexValue(name[position + 2]);
+            if ((high < 0) || (low < 0)) {
+                return false;
+            }
+            path += static_cast < char >(high * 16 + low);
+            position += 2;
+        }
+        return true;
+    }
+
+    std::vector < ShardDirectory::Entry > ShardDirectory::list(const std::string& directory, std::error_code& ec)
+    {
+        std::vector < Entry > entries;
+        for (std::filesystem::directory_iterator iter(directory, ec); (!ec) && (iter != std::filesystem::directory_iterator()); iter.increment(ec)) {
+            Entry entry;
+            std::string name = iter->path().filename().string();
+            const std::size_t tmpSuffixSize = sizeof(SnapshotFiles::TMP_SUFFIX) - 1;
+            if ((name.size() > tmpSuffixSize) && (name.compare(name.size() - tmpSuffixSize, tmpSuffixSize, SnapshotFiles::TMP_SUFFIX) == 0)) {
+                // left behind by an interrupted save
+                name.resize(name.size() - tmpSuffixSize);
+                entry.tmp = true;
+            }
+            if (decodeName(name, entry.path, entry.shortened)) {
+                entry.fileName = iter->path().string();
+                entries.push_back(std::move(entry));
+            }
+        }
+        return entries;
+    }
+
+    Json::Value ShardDirectory::read(const std::string& directory, const std::string& fileName, std::string& path)
+    {
+        Json::Value shard = SnapshotFiles::read(fileName);
+        if (path.empty()) {
+            // the name got shortened, the shard has the complete jet path
+            if ((shard.size() != 1) || (getFileName(directory, shard.getMemberNames().front()) != fileName)) {
+                throw std::runtime_error("shard '" + fileName + "' has no entry matching its name");
+            }
+            path = shard.getMemberNames().front();
+        }
+        if (!shard.isMember(path)) {
+            throw std::runtime_error("shard '" + fileName + "' has no entry for " + path);
+        }
+        Json::Value config;
+        config.swap(shard[path]);
+        return config;
+    }
+}
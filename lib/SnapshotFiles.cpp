@@ -0,0 +1,275 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "json/reader.h"
+#include "json/value.h"
+
+#include "jetproxy/CborSerializer.hpp"
+#include "jetproxy/ChecksumStreamBuffer.hpp"
+#include "jetproxy/SnapshotFiles.hpp"
+#include "jetproxy/SnapshotHeader.hpp"
+
+namespace hbk::jetproxy {
+
+    /// \return 0 on success, -1 on error
+    static int syncPath(const std::string& path, int flags)
+    {
+        const int fd = ::open(path.c_str(), flags | O_CLOEXEC);
+        if (fd < 0) {
+            return -1;
+        }
+        const int result = ::fsync(fd);
+        ::close(fd);
+        return result;
+    }
+
+    std::string SnapshotFiles::getGenerationFileName(const std::string& fileName, unsigned int generation)
+    {
+        if (generation == 0) {
+            return fileName;
+        }
+        return fileName + "." + std::to_string(generation);
+    }
+
+    std::string SnapshotFiles::getDirectory(const std::string& fileName)
+    {
+        const std::string directory = std::filesystem::path(fileName).parent_path().string();
+        if (directory.empty()) {
+            return ".";
+        }
+        return directory;
+    }
+
+    void SnapshotFiles::write(std::ostream& stream, const Writer& write, std::uint64_t& length, std::uint32_t& checksum)
+    {
+        ChecksumStreamBuffer checksumBuffer(*stream.rdbuf());
+        std::ostream contentStream(&checksumBuffer);
+        write(contentStream);
+        contentStream.flush();
+        if (!contentStream) {
+            stream.setstate(std::ios::failbit);
+        }
+        length = checksumBuffer.getLength();
+        checksum = checksumBuffer.getChecksum();
+    }
+
+    bool SnapshotFiles::readChecksum(const std::string& fileName, std::size_t offset, std::uint64_t& length, std::uint32_t& checksum)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        file.seekg(static_cast < std::streamoff >(offset));
+        std::vector < char > buffer(64 * 1024);
+        checksum = 0;
+        length = 0;
+        while (file) {
+            file.read(buffer.data(), static_cast < std::streamsize >(buffer.size()));
+            const std::size_t count = static_cast < std::size_t >(file.gcount());
+            checksum = SnapshotHeader::crc32c(std::string_view(buffer.data(), count), checksum);
+            length += count;
+        }
+        return true;
+    }
+
+    std::size_t SnapshotFiles::readHeader(const std::string& fileName, SnapshotHeader& header)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file) {
+            return 0;
+        }
+        char buffer[128];
+        file.read(buffer, sizeof(buffer));
+        return SnapshotHeader::parse(std::string_view(buffer, static_cast < std::size_t >(file.gcount())), header);
+    }
+
+    bool SnapshotFiles::verify(const std::string& fileName, const SnapshotHeader& header, std::size_t headerSize)
+    {
+        std::uint64_t length;
+        std::uint32_t checksum;
+        return (readChecksum(fileName, headerSize, length, checksum)) && (length == header.length) && (checksum == header.checksum);
+    }
+
+    std::uint64_t SnapshotFiles::readLatestSequence(const std::string& fileName, unsigned int generations)
+    {
+        std::uint64_t sequence = 0;
+        for (unsigned int generation = 0; generation < generations; ++generation) {
+            SnapshotHeader header;
+            if (readHeader(getGenerationFileName(fileName, generation), header) > 0) {
+                sequence = std::max(sequence, header.sequence);
+            }
+        }
+        return sequence;
+    }
+
+    std::string SnapshotFiles::selectGeneration(const std::string& fileName, unsigned int generations)
+    {
+        if (generations <= 1) {
+            return fileName;
+        }
+
+        struct Candidate {
+            std::string fileName;
+            SnapshotHeader header;
+            std::size_t headerSize;
+        };
+        std::vector < Candidate > candidates;
+        for (unsigned int generation = 0; generation < generations; ++generation) {
+            Candidate candidate;
+            candidate.fileName = getGenerationFileName(fileName, generation);
+            candidate.headerSize = readHeader(candidate.fileName, candidate.header);
+            if (candidate.headerSize > 0) {
+                candidates.push_back(std::move(candidate));
+            }
+        }
+        // a rotation might have been interrupted, the sequence tells the latest
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& left, const Candidate& right) {
+            return left.header.sequence > right.header.sequence;
+        });
+        for (const auto& candidate : candidates) {
+            if (verify(candidate.fileName, candidate.header, candidate.headerSize)) {
+                return candidate.fileName;
+            }
+            std::cerr << "configuration file '" << candidate.fileName << "' is damaged. Trying an older generation" << std::endl;
+        }
+        // written before generations were kept or nothing intact
+        std::error_code ec;
+        if (std::filesystem::exists(fileName, ec)) {
+            return fileName;
+        }
+        // the first rotation of a file without header moved it away but was interrupted before the new file was renamed in
+        for (unsigned int generation = 1; generation < generations; ++generation) {
+            const std::string generationFileName = getGenerationFileName(fileName, generation);
+            if (std::filesystem::exists(generationFileName, ec)) {
+                std::cerr << "configuration file '" << fileName << "' is missing. Taking '" << generationFileName << "'" << std::endl;
+                return generationFileName;
+            }
+        }
+        return fileName;
+    }
+
+    int SnapshotFiles::replace(const std::string& fileName, unsigned int generations, Durability durability)
+    {
+        // the oldest generation is dropped, the others move one up
+        for (unsigned int generation = generations - 1; generation > 0; --generation) {
+            std::error_code ec;
+            std::filesystem::rename(getGenerationFileName(fileName, generation - 1), getGenerationFileName(fileName, generation), ec);
+        }
+        try {
+            std::filesystem::rename(fileName + TMP_SUFFIX, fileName);
+        } catch (std::filesystem::filesystem_error& e) {
+            std::remove(fileName.c_str());
+            std::cerr << "Could not move config file to " << fileName << e.what() << '\n';
+            return -1;
+        }
+        return syncDirectory(getDirectory(fileName), durability);
+    }
+
+    int SnapshotFiles::syncFile(const std::string& fileName, Durability durability)
+    {
+        if (durability == Durability::NONE) {
+            return 0;
+        }
+        if (syncPath(fileName, O_RDONLY) < 0) {
+            std::cerr << "could not sync file '" << fileName << "': " << std::strerror(errno) << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    int SnapshotFiles::syncDirectory(const std::string& directory, Durability durability)
+    {
+        if (durability == Durability::NONE) {
+            return 0;
+        }
+        if (syncPath(directory, O_RDONLY | O_DIRECTORY) < 0) {
+            std::cerr << "could not sync directory '" << directory << "': " << std::strerror(errno) << std::endl;
+            return -1;
+        }
+        if (durability == Durability::FULL) {
+            ::sync();
+        }
+        return 0;
+    }
+
+    Json::Value SnapshotFiles::read(const std::string& fileName)
+    {
+        std::ifstream file;
+        file.open(fileName, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("could not open file '" + fileName + "' for reading");
+        }
+
+        if ( file.peek() == std::ifstream::traits_type::eof()) {
+            throw std::runtime_error("Json file '" + fileName + "': Empty file for reading");
+        }
+        const std::string fileContent((std::istreambuf_iterator < char >(file)), std::istreambuf_iterator < char >());
+        std::string_view content(fileContent);
+        SnapshotHeader header;
+        content.remove_prefix(SnapshotHeader::parse(content, header));
+
+        Json::Value config;
+        if (CborSerializer::hasHeader(content)) {
+            try {
+                config = CborSerializer::decode(content);
+            } catch (const std::runtime_error& e) {
+                throw std::runtime_error("CBOR file '" + fileName + "' has invalid content: " + e.what());
+            }
+        } else {
+            Json::CharReaderBuilder builder;
+            std::unique_ptr < Json::CharReader > reader(builder.newCharReader());
+            std::string errors;
+            if (!reader->parse(content.data(), content.data() + content.size(), &config, &errors)) {
+                throw std::runtime_error("Json file '" + fileName + "' has invalid content: " + errors);
+            }
+        }
+
+        if ( config.isNull() ) {
+            throw std::runtime_error("Json file '" + fileName + "' has no json content");
+        }
+        if ( !config.isObject() ) {
+            throw std::runtime_error("Json file '" + fileName + "' has invalid content: Not an object");
+        }
+        return config;
+    }
+}
@@ -0,0 +1,122 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <array>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "jetproxy/SnapshotHeader.hpp"
+
+namespace hbk::jetproxy {
+
+    static const char HEADER_START[] = "// snapshot ";
+    /// Longer lines are no header
+    static const std::size_t MAX_HEADER_SIZE = 128;
+    /// Reversed Castagnoli polynomial
+    static const std::uint32_t POLYNOMIAL = 0x82f63b78;
+
+    using CrcTables = std::array < std::array < std::uint32_t, 256 >, 8 >;
+
+    /// Tables for processing 8 bytes at once ("slicing-by-8")
+    static CrcTables createCrcTables()
+    {
+        CrcTables tables;
+        for (std::uint32_t index = 0; index < 256; ++index) {
+            std::uint32_t crc = index;
+            for (unsigned int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+            }
+            tables[0][index] = crc;
+        }
+        for (std::uint32_t index = 0; index < 256; ++index) {
+            for (std::size_t table = 1; table < tables.size(); ++table) {
+                const std::uint32_t previous = tables[table - 1][index];
+                tables[table][index] = (previous >> 8) ^ tables[0][previous & 0xff];
+            }
+        }
+        return tables;
+    }
+
+    // "// snapshot sequence=<20 digits> length=<20 digits> crc32c=<8 digits>\n"
+    const std::size_t SnapshotHeader::SIZE = sizeof(HEADER_START) - 1 + 9 + 20 + 8 + 20 + 8 + 8 + 1;
+
+    std::string SnapshotHeader::create(std::uint64_t sequence, std::string_view content)
+    {
+        return create(sequence, content.size(), crc32c(content));
+    }
+
+    std::string SnapshotHeader::create(std::uint64_t sequence, std::uint64_t length, std::uint32_t checksum)
+    {
+        char header[MAX_HEADER_SIZE];
+        std::snprintf(header, sizeof(header), "%ssequence=%020" PRIu64 " length=%020" PRIu64 " crc32c=%08" PRIx32 "\n",
+                      HEADER_START, sequence, length, checksum);
+        return header;
+    }
+
+    std::size_t SnapshotHeader::parse(std::string_view data, SnapshotHeader& header)
+    {
+        if (data.substr(0, sizeof(HEADER_START) - 1) != HEADER_START) {
+            return 0;
+        }
+        const std::size_t end = data.substr(0, MAX_HEADER_SIZE).find('\n');
+        if (end == std::string_view::npos) {
+            return 0;
+        }
+        const std::string line(data.substr(0, end));
+        SnapshotHeader parsed;
+        int consumed = 0;
+        if ((std::sscanf(line.c_str(), "// snapshot sequence=%" SCNu64 " length=%" SCNu64 " crc32c=%" SCNx32 "%n",
+                         &parsed.sequence, &parsed.length, &parsed.checksum, &consumed) != 3) || (static_cast < std::size_t >(consumed) != line.size())) {
+            return 0;
+        }
+        header = parsed;
+        return end + 1;
+    }
+
+    std::uint32_t SnapshotHeader::crc32c(std::string_view data, std::uint32_t crc)
+    {
+        static const CrcTables tables = createCrcTables();
+        const unsigned char* position = reinterpret_cast < const unsigned char* >(data.data());
+        std::size_t size = data.size();
+        crc = ~crc;
+        while (size >= 8) {
+            crc ^= static_cast < std::uint32_t >(position[0]) | (static_cast < std::uint32_t >(position[1]) << 8) |
+                   (static_cast < std::uint32_t >(position[2]) << 16) | (static_cast < std::uint32_t >(position[3]) << 24);
+            crc = tables[7][crc & 0xff] ^ tables[6][(crc >> 8) & 0xff] ^ tables[5][(crc >> 16) & 0xff] ^ tables[4][crc >> 24] ^
+                  tables[3][position[4]] ^ tables[2][position[5]] ^ tables[1][position[6]] ^ tables[0][position[7]];
+            position += 8;
+            size -= 8;
+        }
+        while (size > 0) {
+            crc = (crc >> 8) ^ tables[0][(crc ^ *position) & 0xff];
+            ++position;
+            --size;
+        }
+        return ~crc;
+    }
+}
@@ -0,0 +1,147 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "json/value.h"
+
+#include "jetproxy/CborSerializer.hpp"
+
+namespace hbk::jetproxy
+{
+    static Json::Value roundTrip(const Json::Value& value)
+    {
+        std::string encoded;
+        CborSerializer::encode(value, encoded);
+        return CborSerializer::decode(encoded);
+    }
+
+    TEST(CborSerializerTest, scalars)
+    {
+        ASSERT_TRUE(roundTrip(Json::Value()).isNull());
+        ASSERT_EQ(roundTrip(true), Json::Value(true));
+        ASSERT_EQ(roundTrip(false), Json::Value(false));
+        ASSERT_EQ(roundTrip(0), Json::Value(0));
+        ASSERT_EQ(roundTrip(23), Json::Value(23));
+        ASSERT_EQ(roundTrip(24), Json::Value(24));
+        ASSERT_EQ(roundTrip(-1), Json::Value(-1));
+        ASSERT_EQ(roundTrip(-100000), Json::Value(-100000));
+        ASSERT_EQ(roundTrip(Json::Value::Int64(std::numeric_limits < std::int64_t >::min())).asInt64(), std::numeric_limits < std::int64_t >::min());
+        ASSERT_EQ(roundTrip(Json::Value::UInt64(std::numeric_limits < std::uint64_t >::max())).asUInt64(), std::numeric_limits < std::uint64_t >::max());
+        // small unsigned values come back as signed ones
+        ASSERT_EQ(roundTrip(Json::Value::UInt(5)).asUInt64(), 5u);
+        ASSERT_EQ(roundTrip(0.5).asDouble(), 0.5);
+        ASSERT_EQ(roundTrip(0.1).asDouble(), 0.1);
+        ASSERT_EQ(roundTrip(-1e300).asDouble(), -1e300);
+        ASSERT_EQ(roundTrip("").asString(), "");
+        ASSERT_EQ(roundTrip("hello wörld").asString(), "hello wörld");
+    }
+
+    TEST(CborSerializerTest, containers)
+    {
+        Json::Value value;
+        value["number"] = 42;
+        value["real"] = 3.25;
+        value["text"] = std::string(300, 'x');
+        value["empty"] = Json::Value(Json::objectValue);
+        value["list"].append(1);
+        value["list"].append("two");
+        value["list"].append(Json::Value(Json::arrayValue));
+        value["nested"]["deeper"]["deepest"] = false;
+        ASSERT_EQ(roundTrip(value), value);
+    }
+
+    TEST(CborSerializerTest, compact)
+    {
+        std::string encoded;
+        CborSerializer::encode(1, encoded, false);
+        ASSERT_EQ(encoded, std::string("\x01"));
+        encoded.clear();
+        CborSerializer::encode(1.5, encoded, false);
+        // half precision is not written, single precision is
+        ASSERT_EQ(encoded.size(), 5u);
+        encoded.clear();
+        CborSerializer::encode(0.1, encoded, false);
+        ASSERT_EQ(encoded.size(), 9u);
+    }
+
+    TEST(CborSerializerTest, header)
+    {
+        std::string encoded;
+        CborSerializer::encode(Json::Value(Json::objectValue), encoded);
+        ASSERT_TRUE(CborSerializer::hasHeader(encoded));
+        ASSERT_FALSE(CborSerializer::hasHeader("{}"));
+        ASSERT_FALSE(CborSerializer::hasHeader(""));
+
+        // pieces give the same document as the complete value
+        Json::Value value;
+        value["a"] = 1;
+        value["b"] = "two";
+        std::string pieces;
+        CborSerializer::encodeHeader(pieces);
+        CborSerializer::encodeMapHeader(2, pieces);
+        CborSerializer::encodeString("a", pieces);
+        CborSerializer::encode(1, pieces, false);
+        CborSerializer::encodeString("b", pieces);
+        CborSerializer::encode("two", pieces, false);
+        encoded.clear();
+        CborSerializer::encode(value, encoded);
+        ASSERT_EQ(pieces, encoded);
+        ASSERT_EQ(CborSerializer::decode(pieces), value);
+    }
+
+    TEST(CborSerializerTest, half_precision)
+    {
+        // written by other encoders
+        ASSERT_EQ(CborSerializer::decode(std::string("\xf9\x3e\x00", 3)).asDouble(), 1.5);
+        ASSERT_EQ(CborSerializer::decode(std::string("\xf9\x00\x01", 3)).asDouble(), 5.960464477539063e-8);
+    }
+
+    TEST(CborSerializerTest, invalid)
+    {
+        std::string encoded;
+        Json::Value value;
+        value["key"] = "value";
+        CborSerializer::encode(value, encoded);
+        for (std::size_t size = 0; size < encoded.size(); ++size) {
+            ASSERT_THROW(CborSerializer::decode(encoded.substr(0, size)), std::runtime_error);
+        }
+        ASSERT_THROW(CborSerializer::decode(encoded + '\x01'), std::runtime_error);
+        // byte string
+        ASSERT_THROW(CborSerializer::decode(std::string("\x41\x00", 2)), std::runtime_error);
+        // indefinite length array
+        ASSERT_THROW(CborSerializer::decode(std::string("\x9f\xff", 2)), std::runtime_error);
+        // integer map key
+        ASSERT_THROW(CborSerializer::decode(std::string("\xa1\x01\x01", 3)), std::runtime_error);
+        // nesting beyond any sensible configuration
+        ASSERT_THROW(CborSerializer::decode(std::string(100000, '\x81')), std::runtime_error);
+        // claims a length far beyond the data
+        ASSERT_THROW(CborSerializer::decode(std::string("\x7b\xff\xff\xff\xff\xff\xff\xff\xff", 9)), std::runtime_error);
+    }
+}
@@ -0,0 +1,98 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "json/value.h"
+
+#include "hbk/sys/eventloop.h"
+#include "jet/defines.h"
+#include "jet/peerasync.hpp"
+
+#include "jetproxy/ChangeBus.hpp"
+#include "jetproxy/PublishedState.hpp"
+
+namespace hbk::jetproxy
+{
+    TEST(ChangeBusTest, prefix)
+    {
+        ChangeBus bus;
+        std::vector < std::string > all;
+        std::vector < std::string > filtered;
+        const ChangeBus::SubscriptionId allId = bus.subscribe("", [&all](const std::string& path) {
+            all.push_back(path);
+        });
+        const ChangeBus::SubscriptionId filteredId = bus.subscribe("/fb/", [&filtered](const std::string& path) {
+            filtered.push_back(path);
+        });
+        ASSERT_NE(allId, filteredId);
+        ASSERT_EQ(bus.getSubscriptionCount(), 2u);
+
+        bus.announce("/fb/scaler");
+        bus.announce("/other");
+        ASSERT_EQ(all, std::vector < std::string >({"/fb/scaler", "/other"}));
+        ASSERT_EQ(filtered, std::vector < std::string >({"/fb/scaler"}));
+
+        bus.unsubscribe(allId);
+        ASSERT_EQ(bus.getSubscriptionCount(), 1u);
+        bus.announce("/fb/filter");
+        ASSERT_EQ(all.size(), 2u);
+        ASSERT_EQ(filtered.size(), 2u);
+
+        // unknown ids are ignored
+        bus.unsubscribe(allId);
+        bus.unsubscribe(filteredId);
+        ASSERT_EQ(bus.getSubscriptionCount(), 0u);
+        bus.announce("/fb/scaler");
+        ASSERT_EQ(filtered.size(), 2u);
+    }
+
+    TEST(ChangeBusTest, published_state)
+    {
+        static const std::string PATH = "/ChangeBusTest/state";
+        hbk::sys::EventLoop eventloop;
+        hbk::jet::PeerAsync peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+
+        unsigned int announced = 0;
+        const ChangeBus::SubscriptionId id = ChangeBus::getDefault().subscribe(PATH, [&announced](const std::string&) {
+            ++announced;
+        });
+
+        PublishedState announcing(peer, PATH, Json::Value(1), true);
+        ASSERT_TRUE(announcing.publish(Json::Value(2)));
+        ASSERT_EQ(announced, 1u);
+        // suppressed notifications are not announced
+        ASSERT_FALSE(announcing.publish(Json::Value(2)));
+        ASSERT_EQ(announced, 1u);
+
+        PublishedState silent(peer, PATH, Json::Value(1));
+        ASSERT_TRUE(silent.publish(Json::Value(2)));
+        ASSERT_EQ(announced, 1u);
+
+        ChangeBus::getDefault().unsubscribe(id);
+    }
+}
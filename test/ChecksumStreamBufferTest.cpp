@@ -0,0 +1,71 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "jetproxy/ChecksumStreamBuffer.hpp"
+#include "jetproxy/SnapshotHeader.hpp"
+
+namespace hbk::jetproxy
+{
+    TEST(ChecksumStreamBufferTest, pass_on)
+    {
+        std::ostringstream target;
+        // more than fits into the buffer at once
+        std::string content;
+        for (unsigned int i = 0; i < 10000; ++i) {
+            content += std::to_string(i) + ",";
+        }
+        {
+            ChecksumStreamBuffer buffer(*target.rdbuf());
+            std::ostream stream(&buffer);
+            stream << content.substr(0, 7);
+            stream.put(content[7]);
+            stream.write(content.data() + 8, static_cast < std::streamsize >(content.size() - 8));
+            stream.flush();
+            ASSERT_TRUE(stream.good());
+            ASSERT_EQ(buffer.getLength(), content.size());
+            ASSERT_EQ(buffer.getChecksum(), SnapshotHeader::crc32c(content));
+            ASSERT_EQ(target.str(), content);
+        }
+    }
+
+    TEST(ChecksumStreamBufferTest, destruction)
+    {
+        std::ostringstream target;
+        {
+            ChecksumStreamBuffer buffer(*target.rdbuf());
+            std::ostream stream(&buffer);
+            stream << "not flushed";
+            ASSERT_EQ(buffer.getLength(), 0u);
+        }
+        // passed on nevertheless
+        ASSERT_EQ(target.str(), "not flushed");
+    }
+}
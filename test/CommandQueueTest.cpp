@@ -0,0 +1,232 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "json/value.h"
+
+#include "hbk/sys/eventloop.h"
+#include "jet/peerasync.hpp"
+
+#include "jetproxy/CommandQueue.hpp"
+#include "jetproxy/JetProxy.hpp"
+#include "jetproxy/ProxyJetStates.hpp"
+
+namespace hbk::jetproxy {
+
+    static const char TYPE[] = "TestProxy";
+    static const char PROPERTY_NUMBER[] = "number";
+    static const std::string PROXY_PATH = "/CommandQueueTest/aProxy";
+    static const unsigned int MAX_WAIT_TIME_MS = 1000;
+
+    class TestProxy : public JetProxy
+    {
+    public:
+        TestProxy(hbk::jet::PeerAsync& peer, const std::string& path)
+            : JetProxy(peer, TYPE, path, true)
+            , m_number(0)
+        {
+            m_state = std::make_unique<hbk::jetproxy::ProxyJetStates>(m_jetPeer, m_path, TestProxy::compose(), hbk::jet::stateCallback_t());
+        }
+
+        void restoreDefaults() override
+        {
+            setNumber(0);
+        }
+
+        void composeProperties(Json::Value &composition) const override
+        {
+            composition[PROPERTY_NUMBER] = m_number;
+        }
+
+        hbk::jet::SetStateCbResult setFromJet(const Json::Value&) override
+        {
+            return Json::Value();
+        }
+
+        void setNumber(unsigned int number)
+        {
+            m_number = number;
+            notify();
+        }
+
+        unsigned int getNumber() const
+        {
+            return m_number;
+        }
+
+    private:
+        unsigned int m_number;
+    };
+
+    class CommandQueueTest : public ::testing::Test {
+    protected:
+        hbk::sys::EventLoop eventloop;
+        hbk::jet::PeerAsync peer;
+        std::thread workerThread;
+
+        CommandQueueTest()
+            : peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0)
+        {
+        }
+
+        virtual void SetUp() override
+        {
+            workerThread = std::thread(std::bind(&hbk::sys::EventLoop::execute, std::ref(eventloop)));
+        }
+
+        virtual void TearDown() override
+        {
+            eventloop.stop();
+            workerThread.join();
+        }
+
+        static void waitForCount(const CommandQueue& commandQueue, std::uint64_t expectedCount)
+        {
+            for (unsigned int wait = 0; commandQueue.getExecutedCount() < expectedCount; ++wait) {
+                ASSERT_LT(wait, MAX_WAIT_TIME_MS) << "wait timeout";
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    };
+
+    TEST_F(CommandQueueTest, one_queue_per_peer)
+    {
+        ASSERT_EQ(CommandQueue::get(peer), nullptr);
+        {
+            CommandQueue commandQueue(eventloop, peer);
+            // the cached result of the lookup before is not taken
+            ASSERT_EQ(CommandQueue::get(peer), &commandQueue);
+            std::thread([this, &commandQueue]() {
+                ASSERT_EQ(CommandQueue::get(peer), &commandQueue);
+            }).join();
+            ASSERT_THROW(CommandQueue anotherCommandQueue(eventloop, peer), std::runtime_error);
+        }
+        ASSERT_EQ(CommandQueue::get(peer), nullptr);
+    }
+
+    TEST_F(CommandQueueTest, many_producers)
+    {
+        static const unsigned int producerCount = 8;
+        static const unsigned int commandCount = 10000;
+        CommandQueue commandQueue(eventloop, peer);
+
+        // executed by the event loop thread only, no synchronization required
+        std::vector < unsigned int > lastSequence(producerCount, 0);
+        bool inOrder = true;
+        bool inEventLoop = true;
+
+        std::vector < std::thread > producers;
+        for (unsigned int producer = 0; producer < producerCount; ++producer) {
+            producers.emplace_back([&, producer]() {
+                for (unsigned int sequence = 1; sequence <= commandCount; ++sequence) {
+                    commandQueue.post([&, producer, sequence]() {
+                        if (lastSequence[producer] + 1 != sequence) {
+                            inOrder = false;
+                        }
+                        lastSequence[producer] = sequence;
+                        if (!commandQueue.isEventLoopThread()) {
+                            inEventLoop = false;
+                        }
+                    });
+                }
+            });
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+
+        waitForCount(commandQueue, producerCount * commandCount);
+        ASSERT_TRUE(inOrder);
+        ASSERT_TRUE(inEventLoop);
+    }
+
+    TEST_F(CommandQueueTest, proxy_post)
+    {
+        CommandQueue commandQueue(eventloop, peer);
+        TestProxy testProxy(peer, PROXY_PATH);
+        std::thread producer([&testProxy]() {
+            for (unsigned int number = 1; number <= 100; ++number) {
+                testProxy.post([&testProxy, number]() { testProxy.setNumber(number); });
+            }
+        });
+        producer.join();
+        waitForCount(commandQueue, 100);
+        ASSERT_EQ(testProxy.getNumber(), 100);
+    }
+
+    TEST_F(CommandQueueTest, proxy_destroyed)
+    {
+        std::atomic < bool > executed(false);
+        CommandQueue commandQueue(eventloop, peer);
+        std::atomic < bool > release(false);
+        // keeps the event loop busy until the proxy is gone
+        commandQueue.post([&release]() {
+            while (!release) {
+                std::this_thread::yield();
+            }
+        });
+        {
+            TestProxy testProxy(peer, PROXY_PATH);
+            testProxy.post([&executed]() { executed = true; });
+        }
+        release = true;
+        waitForCount(commandQueue, 2);
+        ASSERT_FALSE(executed);
+    }
+
+    TEST_F(CommandQueueTest, defer)
+    {
+        CommandQueue commandQueue(eventloop, peer);
+        // executed by the event loop thread only, no synchronization required
+        std::vector < unsigned int > order;
+        commandQueue.post([&commandQueue, &order]() {
+            commandQueue.defer([&commandQueue, &order]() {
+                order.push_back(2);
+                commandQueue.defer([&order]() {
+                    order.push_back(3);
+                });
+            });
+            // not in the same iteration
+            order.push_back(1);
+        });
+        waitForCount(commandQueue, 3);
+        ASSERT_EQ(order, std::vector < unsigned int >({ 1, 2, 3 }));
+    }
+
+    TEST_F(CommandQueueTest, no_queue)
+    {
+        TestProxy testProxy(peer, PROXY_PATH);
+        // executed at once
+        testProxy.post([&testProxy]() { testProxy.setNumber(1); });
+        ASSERT_EQ(testProxy.getNumber(), 1);
+    }
+}
@@ -0,0 +1,126 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "json/value.h"
+
+#include "jetproxy/CborSerializer.hpp"
+#include "jetproxy/ConfigIndex.hpp"
+
+namespace hbk::jetproxy
+{
+    static const std::string CONFIG_FILE = "ConfigIndexTest.json";
+
+    static void writeFile(const std::string& content)
+    {
+        std::ofstream file(CONFIG_FILE, std::ios::binary | std::ios::trunc);
+        file << content;
+    }
+
+    TEST(ConfigIndexTest, json)
+    {
+        writeFile(
+            "// leading comment\n"
+            "{\n"
+            "  \"/a\" : { \"number\" : 1, \"text\" : \"with } and ] and \\\" inside\" },\n"
+            "  /* between members, { */\n"
+            "  \"/b\" : [ 1, [ 2, { \"c\" : null } ] ],\n"
+            "  \"/esc\\u0061ped\" : 3.5,\n"
+            "  \"/d\" : \"first\",\n"
+            "  \"/d\" : \"last\"\n"
+            "}\n");
+        ConfigIndex index(CONFIG_FILE);
+        ASSERT_EQ(index.size(), 4u);
+        ASSERT_EQ(index.getPaths(), std::vector < std::string >({ "/a", "/b", "/d", "/escaped" }));
+        ASSERT_TRUE(index.contains("/a"));
+        ASSERT_FALSE(index.contains("/c"));
+        ASSERT_TRUE(index.find("/c").isNull());
+
+        ASSERT_EQ(index.find("/a")["number"].asInt(), 1);
+        ASSERT_EQ(index.find("/a")["text"].asString(), "with } and ] and \" inside");
+        ASSERT_EQ(index.find("/b")[1][1].size(), 1u);
+        ASSERT_EQ(index.find("/escaped").asDouble(), 3.5);
+        // the last one wins as with the json reader
+        ASSERT_EQ(index.find("/d").asString(), "last");
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST(ConfigIndexTest, cbor)
+    {
+        Json::Value config;
+        config["/a"]["number"] = 1;
+        config["/b"]["list"].append("x");
+        config["/c"] = Json::Value(Json::objectValue);
+        std::string encoded;
+        CborSerializer::encode(config, encoded);
+        writeFile(encoded);
+
+        ConfigIndex index(CONFIG_FILE);
+        ASSERT_EQ(index.getPaths(), std::vector < std::string >({ "/a", "/b", "/c" }));
+        ASSERT_EQ(index.find("/a"), config["/a"]);
+        ASSERT_EQ(index.find("/b"), config["/b"]);
+        ASSERT_EQ(index.find("/c"), config["/c"]);
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST(ConfigIndexTest, empty_object)
+    {
+        writeFile(" { } ");
+        ConfigIndex index(CONFIG_FILE);
+        ASSERT_EQ(index.size(), 0u);
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST(ConfigIndexTest, invalid)
+    {
+        std::remove(CONFIG_FILE.c_str());
+        ASSERT_THROW(ConfigIndex index(CONFIG_FILE), std::runtime_error);
+
+        for (const char* content : { "", "null", "[ 1 ]", "{ \"/a\" : { \"b\" : 1 }", "{ \"/a\" : \"unterminated }", "{ \"/a\" 1 }", "{ /a : 1 }", "{ \"/a\" : 1 ] }" }) {
+            writeFile(content);
+            ASSERT_THROW(ConfigIndex index(CONFIG_FILE), std::runtime_error) << content;
+        }
+
+        std::string encoded;
+        Json::Value config;
+        config["/a"]["number"] = 1;
+        CborSerializer::encode(config, encoded);
+        writeFile(encoded.substr(0, encoded.size() - 1));
+        ASSERT_THROW(ConfigIndex index(CONFIG_FILE), std::runtime_error);
+
+        // only the structure is checked up front, the broken entry is detected when being parsed
+        writeFile("{ \"/a\" : { \"number\" : 1 }, \"/b\" : { \"number\" : nonsense } }");
+        ConfigIndex index(CONFIG_FILE);
+        ASSERT_EQ(index.find("/a")["number"].asInt(), 1);
+        ASSERT_THROW(index.find("/b"), std::runtime_error);
+        std::remove(CONFIG_FILE.c_str());
+    }
+}
@@ -22,7 +22,10 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <chrono>
 #include <fstream>
+#include <iterator>
+#include <string>
 #include <thread>
 #include <unistd.h>
 
@@ -33,6 +36,7 @@
 
 #include "jetproxy/DelayedSaver.hpp"
 #include "jetproxy/JetProxy.hpp"
+#include "jetproxy/ProxyRegistry.hpp"
 
 #include "example/JetObjectProxyWithSubObjectType.hpp"
 
@@ -106,12 +110,19 @@ namespace hbk::jetproxy {
     };
 
 
+    static std::string readContent(const std::string& fileName)
+    {
+        std::ifstream file(fileName);
+        return std::string((std::istreambuf_iterator < char >(file)), std::istreambuf_iterator < char >());
+    }
+
         TEST(DelayedSaverTest, error_test)
         {
             hbk::sys::EventLoop eventloop;
             hbk::jet::PeerAsync peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
 
             hbk::jetproxy::DelayedSaver delayedSaver(eventloop, peer);
+            delayedSaver.setSource(DelayedSaver::Source::Local);
 
             // there must be at least on matcher
             hbk::jetproxy::DelayedSaver::Matchers noMatchers;
@@ -122,6 +133,10 @@ namespace hbk::jetproxy {
             hbk::jetproxy::DelayedSaver::Matchers matcher(1);
             matcher[0].startsWith = PROXY_PATH;
             ASSERT_EQ(delayedSaver.start(matcher, ""), -1);
+
+            // the local source evaluates startsWith, equals and contains only
+            matcher[0].endsWith = "number";
+            ASSERT_EQ(delayedSaver.start(matcher, "fileName"), -1);
         }
 
 
@@ -225,6 +240,171 @@ namespace hbk::jetproxy {
             m_workerThread.join();
         }
         
+        /// By default, changes are taken from a fetch through the jet daemon instead of the change bus of the process
+        TEST(DelayedSaverTest, fetch_source_test)
+        {
+            hbk::sys::EventLoop eventloop;
+            hbk::jet::PeerAsync peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+            hbk::jet::Peer callingPeer(hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+            auto m_workerThread = std::thread(std::bind(&hbk::sys::EventLoop::execute, std::ref(eventloop)));
+
+            static const std::chrono::milliseconds delay(5);
+            {
+                TestProxy aproxy(peer, PROXY_PATH);
+                unlink(CONFIG_FILE.c_str());
+
+                hbk::jetproxy::DelayedSaver delayedSaver(eventloop, peer);
+                delayedSaver.setDelay(delay);
+
+                hbk::jetproxy::DelayedSaver::Matchers matchers(1);
+                matchers[0].startsWith = PROXY_PATH;
+                delayedSaver.start(matchers, CONFIG_FILE);
+
+                Json::Value requestedValueJson;
+                requestedValueJson[PROPERTY_NUMBER] = aproxy.getNumber() + 1;
+                callingPeer.setStateValue(aproxy.getPath(), requestedValueJson);
+                std::this_thread::sleep_for(delay * 10);
+                std::ifstream savedFile(CONFIG_FILE);
+                ASSERT_EQ(savedFile.good(), true);
+            }
+            eventloop.stop();
+            m_workerThread.join();
+            unlink(CONFIG_FILE.c_str());
+        }
+
+        /// A restore only suppresses the changes it causes itself, changes of other jet proxies meanwhile are saved
+        TEST(DelayedSaverTest, restore_unrelated_change_test)
+        {
+            hbk::sys::EventLoop eventloop;
+            hbk::jet::PeerAsync peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+            hbk::jet::Peer callingPeer(hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+            auto m_workerThread = std::thread(std::bind(&hbk::sys::EventLoop::execute, std::ref(eventloop)));
+
+            // only the save when stopping is to happen
+            static const std::chrono::milliseconds delay(std::chrono::hours(1));
+            {
+                TestProxy aproxy(peer, PROXY_PATH);
+                TestProxy anotherProxy(peer, ANOTHER_PROXY_PATH);
+                ASSERT_EQ(JetProxy::saveAllToFile(CONFIG_FILE), 0);
+
+                hbk::jetproxy::DelayedSaver delayedSaver(eventloop, peer);
+                delayedSaver.setDelay(delay);
+                // knows which changes are caused by the restore
+                delayedSaver.setSource(DelayedSaver::Source::Local);
+                hbk::jetproxy::DelayedSaver::Matchers matchers(1);
+                matchers[0].startsWith = PATH_PREFIX;
+                delayedSaver.start(matchers, CONFIG_FILE);
+
+                // without CommandQueue the slices are restored before returning, progress is called while the restore is going on
+                int result = 1;
+                ASSERT_EQ(ProxyRegistry::getDefault().restoreFromFileSliced(CONFIG_FILE, PROXY_PATH, [&](std::size_t, std::size_t) {
+                    Json::Value requestedValueJson;
+                    requestedValueJson[PROPERTY_NUMBER] = anotherProxy.getNumber() + 1;
+                    callingPeer.setStateValue(anotherProxy.getPath(), requestedValueJson);
+                }, [&result](int completed) {
+                    result = completed;
+                }), 0);
+                ASSERT_EQ(result, 0);
+                unlink(CONFIG_FILE.c_str());
+                // leaving this scope destroys delayedSaver, which saves the pending change at once
+            }
+            std::ifstream savedFile(CONFIG_FILE);
+            ASSERT_EQ(savedFile.good(), true);
+            eventloop.stop();
+            m_workerThread.join();
+            unlink(CONFIG_FILE.c_str());
+        }
+
+        /// Restoring the content of the file must not alter the file, whatever source of changes is used
+        TEST(DelayedSaverTest, restore_source_test)
+        {
+            for (auto source : { DelayedSaver::Source::Fetch, DelayedSaver::Source::Local }) {
+                hbk::sys::EventLoop eventloop;
+                hbk::jet::PeerAsync peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+                hbk::jet::Peer callingPeer(hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+                auto m_workerThread = std::thread(std::bind(&hbk::sys::EventLoop::execute, std::ref(eventloop)));
+
+                // only the save when stopping is to happen
+                static const std::chrono::milliseconds delay(std::chrono::hours(1));
+                {
+                    TestProxy aproxy(peer, PROXY_PATH);
+                    ASSERT_EQ(JetProxy::saveAllToFile(CONFIG_FILE), 0);
+                    const std::string saved = readContent(CONFIG_FILE);
+                    // differs from the file, the restore changes it back
+                    Json::Value requestedValueJson;
+                    requestedValueJson[PROPERTY_NUMBER] = aproxy.getNumber() + 1;
+                    callingPeer.setStateValue(aproxy.getPath(), requestedValueJson);
+
+                    hbk::jetproxy::DelayedSaver delayedSaver(eventloop, peer);
+                    delayedSaver.setDelay(delay);
+                    delayedSaver.setSource(source);
+                    hbk::jetproxy::DelayedSaver::Matchers matchers(1);
+                    matchers[0].startsWith = PROXY_PATH;
+                    delayedSaver.start(matchers, CONFIG_FILE);
+
+                    ASSERT_EQ(JetProxy::restoreAllFromFile(CONFIG_FILE), 0);
+                    ASSERT_EQ(aproxy.getNumber(), NUMBER_DEFAULT_VALUE);
+                    if (source == DelayedSaver::Source::Local) {
+                        // the changes of the restore are known as such
+                        ASSERT_EQ(delayedSaver.getPendingDuration().count(), 0);
+                    }
+                    // with Fetch, the change comes back from the jet daemon and is saved
+                    delayedSaver.stop();
+                    const std::string written = readContent(CONFIG_FILE);
+                    ASSERT_EQ(written, saved);
+                }
+                eventloop.stop();
+                m_workerThread.join();
+                unlink(CONFIG_FILE.c_str());
+            }
+        }
+
+        /// Changes that keep coming faster than the delay must not postpone saving beyond the maximum delay
+        TEST(DelayedSaverTest, max_delay_test)
+        {
+            hbk::sys::EventLoop eventloop;
+            hbk::jet::PeerAsync peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+            hbk::jet::Peer callingPeer(hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+            auto m_workerThread = std::thread(std::bind(&hbk::sys::EventLoop::execute, std::ref(eventloop)));
+
+            // the quiet period never elapses during the test, only the maximum delay causes a save
+            static const std::chrono::hours delay(1);
+            static const std::chrono::milliseconds maxDelay(50);
+            // generous, the timer of the maximum delay might be late on a busy machine
+            static const std::chrono::seconds timeout(10);
+            {
+                TestProxy aproxy(peer, PROXY_PATH);
+                unlink(CONFIG_FILE.c_str());
+
+                hbk::jetproxy::DelayedSaver delayedSaver(eventloop, peer);
+                delayedSaver.setDelay(delay);
+                delayedSaver.setMaxDelay(maxDelay);
+
+                hbk::jetproxy::DelayedSaver::Matchers matchers(1);
+                matchers[0].startsWith = PROXY_PATH;
+                delayedSaver.start(matchers, CONFIG_FILE);
+                ASSERT_EQ(delayedSaver.getPendingDuration().count(), 0);
+
+                // keep changing more often than the delay until saved
+                double requestedValue = aproxy.getNumber();
+                const auto end = std::chrono::steady_clock::now() + timeout;
+                bool saved = false;
+                while ((!saved) && (std::chrono::steady_clock::now() < end)) {
+                    Json::Value requestedValueJson;
+                    requestedValueJson[PROPERTY_NUMBER] = ++requestedValue;
+                    callingPeer.setStateValue(aproxy.getPath(), requestedValueJson);
+                    ASSERT_LT(delayedSaver.getPendingDuration(), timeout);
+                    std::this_thread::sleep_for(maxDelay / 5);
+                    saved = std::ifstream(CONFIG_FILE).good();
+                }
+                // saved although the quiet period never elapsed
+                ASSERT_TRUE(saved);
+            }
+            eventloop.stop();
+            m_workerThread.join();
+            unlink(CONFIG_FILE.c_str());
+        }
+
         TEST(DelayedSaverTest, nonpersistent_test)
         {
             hbk::sys::EventLoop eventloop;
@@ -274,6 +454,62 @@ namespace hbk::jetproxy {
             m_workerThread.join();
         }
 
+        TEST(DelayedSaverTest, journal_test)
+        {
+            const std::string journalFile = ProxyRegistry::getJournalFileName(CONFIG_FILE);
+            unlink(CONFIG_FILE.c_str());
+            unlink(journalFile.c_str());
+            // nothing is saved before stop()
+            static const std::chrono::hours delay(1);
+            double requestedValue;
+            {
+                hbk::sys::EventLoop eventloop;
+                hbk::jet::PeerAsync peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+                hbk::jet::Peer callingPeer(hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+                auto m_workerThread = std::thread(std::bind(&hbk::sys::EventLoop::execute, std::ref(eventloop)));
+
+                TestProxy aproxy(peer, PROXY_PATH);
+                TestProxy anotherProxy(peer, ANOTHER_PROXY_PATH);
+
+                hbk::jetproxy::DelayedSaver delayedSaver(eventloop, peer);
+                delayedSaver.setDelay(delay);
+                // compaction is never reached
+                delayedSaver.setJournal(1024 * 1024);
+                // the change is announced before setStateValue() returns, there is no round trip through the jet daemon
+                delayedSaver.setSource(DelayedSaver::Source::Local);
+                hbk::jetproxy::DelayedSaver::Matchers matchers(1);
+                matchers[0].startsWith = PATH_PREFIX;
+                delayedSaver.start(matchers, CONFIG_FILE);
+
+                requestedValue = aproxy.getNumber() + 1;
+                Json::Value requestedValueJson;
+                requestedValueJson[PROPERTY_NUMBER] = requestedValue;
+                callingPeer.setStateValue(aproxy.getPath(), requestedValueJson);
+                // saves the pending change at once, as when shutting down
+                delayedSaver.stop();
+
+                // only the changed jet proxy was appended to the journal. There is no complete file.
+                std::ifstream savedFile(CONFIG_FILE);
+                ASSERT_EQ(savedFile.good(), false);
+                std::ifstream journal(journalFile);
+                std::string record;
+                ASSERT_TRUE(std::getline(journal, record));
+                ASSERT_NE(record.find(PROXY_PATH), std::string::npos);
+                ASSERT_FALSE(std::getline(journal, record));
+                eventloop.stop();
+                m_workerThread.join();
+            }
+
+            {
+                hbk::sys::EventLoop eventloop;
+                hbk::jet::PeerAsync peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0);
+                TestProxy aproxy(peer, PROXY_PATH);
+                hbk::jetproxy::JetProxy::restoreAllFromFile(CONFIG_FILE);
+                ASSERT_EQ(aproxy.getNumber(), requestedValue);
+            }
+            unlink(journalFile.c_str());
+        }
+
         TEST(DelayedSaverTest, subobject_delayed_save_test)
         {
             // Construct type, request new configuration and save.
@@ -439,6 +439,54 @@ TEST_F(JetProxy_test, userlevels)
 
 }
 
+TEST_F(JetProxy_test, suppress_unchanged_notification)
+{
+    TestProxy testProxy(peer, proxyPath);
+    waitForPath(testProxy.getPath());
+    ASSERT_EQ(testProxy.getSuppressedNotificationCount(), 0);
+
+    // changes the composition
+    testProxy.setRoleLevel(RoleLevel::ADMIN);
+    ASSERT_EQ(testProxy.getSuppressedNotificationCount(), 0);
+    // nothing changes, nothing is to be notified
+    testProxy.setRoleLevel(RoleLevel::ADMIN);
+    ASSERT_EQ(testProxy.getSuppressedNotificationCount(), 1);
+    testProxy.addReferenceByTarget("refId", "targetId");
+    ASSERT_EQ(testProxy.getSuppressedNotificationCount(), 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(s_states[proxyPath].changeCount, 2);
+    ASSERT_EQ(s_states[proxyPath].value[objectmodel::constants::jsonRoleLevelMemberId], ROLE_ADMIN);
+
+    // A set request from jet invalidates the last published value. Hence the next notification has to happen.
+    Json::Value request;
+    request[PROPERTY_NUMBER] = NUMBER_DEFAULT_VALUE + 1;
+    clientJetPeer.setStateValue(proxyPath, request);
+    testProxy.setRoleLevel(RoleLevel::ADMIN);
+    ASSERT_EQ(testProxy.getSuppressedNotificationCount(), 1);
+}
+
+TEST_F(JetProxy_test, base_composition_cache)
+{
+    TestProxy testProxy(peer, proxyPath);
+    waitForPath(testProxy.getPath());
+    ASSERT_EQ(s_states[proxyPath].value[objectmodel::constants::jsonPersistentMemberId], true);
+
+    // cached members are to be updated by their setters
+    testProxy.setPersistent(false);
+    testProxy.setRoleLevel(RoleLevel::SUPPORT);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(s_states[proxyPath].value[objectmodel::constants::jsonPersistentMemberId], false);
+    ASSERT_EQ(s_states[proxyPath].value[objectmodel::constants::jsonRoleLevelMemberId], ROLE_SUPPORT);
+
+    // properties are composed each time
+    testProxy.setNumber(NUMBER_DEFAULT_VALUE * 3);
+    testProxy.setRoleLevel(RoleLevel::USER);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(s_states[proxyPath].value[PROPERTY_NUMBER].asDouble(), NUMBER_DEFAULT_VALUE * 3);
+    ASSERT_EQ(s_states[proxyPath].value[objectmodel::constants::jsonRoleLevelMemberId], ROLE_USER);
+}
+
 TEST_F(JetProxy_test, create_and_move)
 {
     TestProxy testProxySrc(peer, proxyPath);
@@ -454,6 +502,24 @@ TEST_F(JetProxy_test, create_and_move)
     ASSERT_EQ(instanceComposition[objModel::jsonTypeMemberId].asString(), TYPE);
 }
 
+TEST_F(JetProxy_test, move_registration)
+{
+    TestProxy testProxySrc(peer, proxyPath, RoleLevel::ADMIN, false);
+    testProxySrc.addReferenceByTarget("refId", "targetId");
+    const ProxyRegistry::Handle handle = ProxyRegistry::getDefault().getHandle(proxyPath);
+    ASSERT_EQ(ProxyRegistry::getDefault().resolve(handle), &testProxySrc);
+
+    TestProxy testProxyDst(std::move(testProxySrc));
+    ASSERT_EQ(ProxyRegistry::getDefault().find(proxyPath), &testProxyDst);
+    ASSERT_EQ(ProxyRegistry::getDefault().resolve(handle), &testProxyDst);
+    ASSERT_FALSE(testProxyDst.isPersistent());
+    ASSERT_EQ(testProxyDst.getRoleLevel(), ROLE_ADMIN);
+
+    Json::Value composition = testProxyDst.compose();
+    ASSERT_TRUE(composition[objModel::jsonFixedMemberId].asBool());
+    ASSERT_EQ(composition[objModel::jsonReferenceByTargetMemberId]["refId"][0].asString(), "targetId");
+}
+
 TEST_F(JetProxy_test, references)
 {
     static const char REFERENCE_ID[] = "refId";
@@ -0,0 +1,123 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "json/value.h"
+
+#include "jetproxy/Journal.hpp"
+#include "jetproxy/SnapshotFiles.hpp"
+
+namespace hbk::jetproxy
+{
+    static const std::string FILE_NAME = "JournalTest.json";
+
+    static Json::Value createRecords(const std::string& path, int number)
+    {
+        Json::Value records(Json::objectValue);
+        records[path]["number"] = number;
+        return records;
+    }
+
+    TEST(JournalTest, append_read)
+    {
+        std::remove(Journal::getFileName(FILE_NAME).c_str());
+        ASSERT_EQ(Journal::getFileName(FILE_NAME), FILE_NAME + ".journal");
+        ASSERT_EQ(Journal::getSize(FILE_NAME), 0u);
+        ASSERT_TRUE(Journal::read(FILE_NAME, 0).empty());
+
+        Json::Value records = createRecords("/a", 1);
+        records["/b"] = Json::Value();
+        const std::string lines = Journal::format(records);
+        // one record per line
+        ASSERT_EQ(lines, "{\"config\":{\"number\":1},\"path\":\"/a\"}\n{\"config\":null,\"path\":\"/b\"}\n");
+        ASSERT_EQ(Journal::append(FILE_NAME, lines, SnapshotFiles::Durability::FILE), 0);
+        ASSERT_EQ(Journal::append(FILE_NAME, Journal::format(createRecords("/a", 2)), SnapshotFiles::Durability::NONE), 0);
+        ASSERT_EQ(Journal::getSize(FILE_NAME), lines.size() + Journal::format(createRecords("/a", 2)).size());
+
+        // the last record of a jet path wins
+        Json::Value read = Journal::read(FILE_NAME, Journal::getSize(FILE_NAME));
+        ASSERT_EQ(read.size(), 2u);
+        ASSERT_EQ(read["/a"]["number"].asInt(), 2);
+        ASSERT_TRUE(read["/b"].isNull());
+        // records behind size are not read
+        read = Journal::read(FILE_NAME, lines.size());
+        ASSERT_EQ(read["/a"]["number"].asInt(), 1);
+
+        // removed entries disappear
+        Json::Value config(Json::objectValue);
+        config["/b"]["number"] = 5;
+        config["/c"]["number"] = 6;
+        Journal::replay(FILE_NAME, Journal::getSize(FILE_NAME), config);
+        ASSERT_EQ(config.size(), 2u);
+        ASSERT_EQ(config["/a"]["number"].asInt(), 2);
+        ASSERT_EQ(config["/c"]["number"].asInt(), 6);
+        std::remove(Journal::getFileName(FILE_NAME).c_str());
+    }
+
+    TEST(JournalTest, torn_record)
+    {
+        std::remove(Journal::getFileName(FILE_NAME).c_str());
+        {
+            // as left behind by a power loss
+            std::ofstream journal(Journal::getFileName(FILE_NAME), std::ios::binary);
+            journal << Journal::format(createRecords("/a", 1)) << "{\"config\":{\"num";
+        }
+        ASSERT_EQ(Journal::append(FILE_NAME, Journal::format(createRecords("/b", 2)), SnapshotFiles::Durability::FILE), 0);
+        const Json::Value read = Journal::read(FILE_NAME, Journal::getSize(FILE_NAME));
+        ASSERT_EQ(read.size(), 2u);
+        ASSERT_EQ(read["/a"]["number"].asInt(), 1);
+        ASSERT_EQ(read["/b"]["number"].asInt(), 2);
+        std::remove(Journal::getFileName(FILE_NAME).c_str());
+    }
+
+    TEST(JournalTest, trim)
+    {
+        std::remove(Journal::getFileName(FILE_NAME).c_str());
+        const std::string first = Journal::format(createRecords("/a", 1));
+        ASSERT_EQ(Journal::append(FILE_NAME, first, SnapshotFiles::Durability::FILE), 0);
+        ASSERT_EQ(Journal::append(FILE_NAME, Journal::format(createRecords("/b", 2)), SnapshotFiles::Durability::FILE), 0);
+
+        // records behind the trimmed ones are kept
+        bool trimmed = false;
+        ASSERT_EQ(Journal::trim(FILE_NAME, first.size(), SnapshotFiles::Durability::FILE, trimmed), 0);
+        ASSERT_TRUE(trimmed);
+        ASSERT_FALSE(std::filesystem::exists(Journal::getFileName(FILE_NAME) + SnapshotFiles::TMP_SUFFIX));
+        const Json::Value read = Journal::read(FILE_NAME, Journal::getSize(FILE_NAME));
+        ASSERT_EQ(read.size(), 1u);
+        ASSERT_EQ(read["/b"]["number"].asInt(), 2);
+
+        // nothing left
+        trimmed = false;
+        ASSERT_EQ(Journal::trim(FILE_NAME, Journal::getSize(FILE_NAME), SnapshotFiles::Durability::FILE, trimmed), 0);
+        ASSERT_TRUE(trimmed);
+        ASSERT_FALSE(std::filesystem::exists(Journal::getFileName(FILE_NAME)));
+    }
+}
@@ -0,0 +1,344 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "json/value.h"
+
+#include "hbk/sys/eventloop.h"
+#include "jet/peer.hpp"
+#include "jet/peerasync.hpp"
+
+#include "jetproxy/JetProxy.hpp"
+#include "jetproxy/NotificationDispatcher.hpp"
+#include "jetproxy/ProxyJetStates.hpp"
+#include "jetproxy/test/jethelperfunction.hpp"
+
+#include "objectmodel/ObjectModelConstants.hpp"
+
+namespace hbk::jetproxy {
+
+    static const char TYPE[] = "TestProxy";
+    static const double NUMBER_DEFAULT_VALUE = 42.0;
+    static const char PROPERTY_NUMBER[] = "number";
+    static const std::string PATH_PREFIX = "/NotificationDispatcherTest/";
+    static const std::string PROXY_PATH = PATH_PREFIX + "aProxy";
+    static const std::string SUB_STATE_PATH = PROXY_PATH + "/sub";
+
+    class TestProxy : public JetProxy
+    {
+    public:
+        TestProxy(hbk::jet::PeerAsync& peer, const std::string& path)
+            : JetProxy(peer, TYPE, path, true)
+            , m_number(NUMBER_DEFAULT_VALUE)
+        {
+            m_state = std::make_unique<hbk::jetproxy::ProxyJetStates>(m_jetPeer, m_path, TestProxy::compose(), std::bind(&TestProxy::setFromJet, this, std::placeholders::_1));
+        }
+
+        void restoreDefaults() override
+        {
+            setNumber(NUMBER_DEFAULT_VALUE);
+        }
+
+        void composeProperties(Json::Value &composition) const override
+        {
+            ++m_composeCount;
+            composition[PROPERTY_NUMBER] = m_number;
+        }
+
+        hbk::jet::SetStateCbResult setFromJet(const Json::Value& request) override
+        {
+            const Json::Value numberNode = request[PROPERTY_NUMBER];
+            if (!numberNode.isNull()) {
+                setNumber(numberNode.asDouble());
+            }
+            return Json::Value();
+        }
+
+        void setNumber(double number)
+        {
+            m_number = number;
+            notify();
+        }
+
+        unsigned int getComposeCount() const
+        {
+            return m_composeCount;
+        }
+
+    private:
+        double m_number;
+        mutable unsigned int m_composeCount = 0;
+    };
+
+    class NotificationDispatcherTest : public ::testing::Test {
+    protected:
+        hbk::sys::EventLoop eventloop;
+        hbk::jet::PeerAsync peer;
+        std::thread workerThread;
+
+        NotificationDispatcherTest()
+            : peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0)
+        {
+        }
+
+        virtual void SetUp() override
+        {
+            hbk::jet::matcher_t match;
+            match.startsWith = PATH_PREFIX;
+            peer.addFetchAsync(match, fetchFbCb);
+            workerThread = std::thread(std::bind(&hbk::sys::EventLoop::execute, std::ref(eventloop)));
+        }
+
+        virtual void TearDown() override
+        {
+            eventloop.stop();
+            workerThread.join();
+        }
+    };
+
+    TEST_F(NotificationDispatcherTest, one_dispatcher_per_peer)
+    {
+        NotificationDispatcher dispatcher(eventloop, peer);
+        ASSERT_EQ(NotificationDispatcher::get(peer), &dispatcher);
+        ASSERT_THROW(NotificationDispatcher anotherDispatcher(eventloop, peer), std::runtime_error);
+    }
+
+    TEST_F(NotificationDispatcherTest, no_dispatcher)
+    {
+        ASSERT_EQ(NotificationDispatcher::get(peer), nullptr);
+        {
+            NotificationDispatcher dispatcher(eventloop, peer);
+            // the cached result of the lookup before is not taken
+            ASSERT_EQ(NotificationDispatcher::get(peer), &dispatcher);
+            std::thread([this, &dispatcher]() {
+                ASSERT_EQ(NotificationDispatcher::get(peer), &dispatcher);
+            }).join();
+        }
+        ASSERT_EQ(NotificationDispatcher::get(peer), nullptr);
+    }
+
+    TEST_F(NotificationDispatcherTest, batch)
+    {
+        NotificationDispatcher dispatcher(eventloop, peer);
+        TestProxy testProxy(peer, PROXY_PATH);
+        waitForPath(PROXY_PATH);
+        unsigned int composeCount = testProxy.getComposeCount();
+        {
+            NotificationDispatcher::Batch batch(dispatcher);
+            testProxy.setNumber(NUMBER_DEFAULT_VALUE + 1);
+            testProxy.addReferenceByTarget("refId", "targetId");
+            testProxy.setRoleLevel(RoleLevel::ADMIN);
+            testProxy.setNumber(NUMBER_DEFAULT_VALUE + 2);
+            // nothing is composed before the batch is finished
+            ASSERT_EQ(testProxy.getComposeCount(), composeCount);
+        }
+        // one composition, one notification, latest value wins
+        ASSERT_EQ(testProxy.getComposeCount(), composeCount + 1);
+        ASSERT_EQ(dispatcher.getCoalescedCount(), 3);
+        waitForChangeCount(PROXY_PATH, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ASSERT_EQ(s_states[PROXY_PATH].changeCount, 1);
+        ASSERT_EQ(s_states[PROXY_PATH].value[PROPERTY_NUMBER].asDouble(), NUMBER_DEFAULT_VALUE + 2);
+        ASSERT_EQ(s_states[PROXY_PATH].value[objectmodel::constants::jsonRoleLevelMemberId], ROLE_ADMIN);
+    }
+
+    TEST_F(NotificationDispatcherTest, event_loop_iteration)
+    {
+        NotificationDispatcher dispatcher(eventloop, peer);
+        Json::Value value;
+        value[PROPERTY_NUMBER] = 0;
+        ProxyJetStates subState(peer, SUB_STATE_PATH, value, hbk::jet::stateCallback_t());
+        waitForPath(SUB_STATE_PATH);
+
+        for (unsigned int i = 1; i <= 100; ++i) {
+            value[PROPERTY_NUMBER] = i;
+            subState.notify(value);
+        }
+        // published by the event loop
+        waitForChangeCount(SUB_STATE_PATH, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ASSERT_EQ(s_states[SUB_STATE_PATH].value[PROPERTY_NUMBER].asUInt(), 100);
+        ASSERT_LT(s_states[SUB_STATE_PATH].changeCount, 100);
+    }
+
+    TEST_F(NotificationDispatcherTest, rate_limit)
+    {
+        static const std::chrono::milliseconds minInterval(100);
+        NotificationDispatcher dispatcher(eventloop, peer);
+        Json::Value value;
+        value[PROPERTY_NUMBER] = 0;
+        ProxyJetStates subState(peer, SUB_STATE_PATH, value, hbk::jet::stateCallback_t());
+        subState.setMinPublishInterval(minInterval);
+        waitForPath(SUB_STATE_PATH);
+
+        // nothing was published before, not held back
+        value[PROPERTY_NUMBER] = 1;
+        subState.notify(value);
+        waitForChangeCount(SUB_STATE_PATH, 1);
+        for (unsigned int i = 2; i <= 100; ++i) {
+            value[PROPERTY_NUMBER] = i;
+            subState.notify(value);
+        }
+        // held back until the interval since the first notification elapsed
+        std::this_thread::sleep_for(minInterval / 4);
+        ASSERT_EQ(s_states[SUB_STATE_PATH].changeCount, 1);
+        // trailing update with the latest value
+        waitForChangeCount(SUB_STATE_PATH, 2);
+        ASSERT_EQ(s_states[SUB_STATE_PATH].value[PROPERTY_NUMBER].asUInt(), 100);
+
+        value[PROPERTY_NUMBER] = 101;
+        subState.notify(value);
+        std::this_thread::sleep_for(minInterval / 4);
+        ASSERT_EQ(s_states[SUB_STATE_PATH].changeCount, 2);
+        waitForChangeCount(SUB_STATE_PATH, 3);
+        std::this_thread::sleep_for(minInterval / 4);
+        ASSERT_EQ(s_states[SUB_STATE_PATH].changeCount, 3);
+        ASSERT_EQ(s_states[SUB_STATE_PATH].value[PROPERTY_NUMBER].asUInt(), 101);
+        ASSERT_GT(dispatcher.getCoalescedCount(), 0);
+    }
+
+    TEST_F(NotificationDispatcherTest, rate_limit_first_immediately)
+    {
+        NotificationDispatcher dispatcher(eventloop, peer);
+        Json::Value value;
+        value[PROPERTY_NUMBER] = 0;
+        ProxyJetStates subState(peer, SUB_STATE_PATH, value, hbk::jet::stateCallback_t());
+        // would be waited for if the creation counted as publishing
+        subState.setMinPublishInterval(std::chrono::hours(1));
+        waitForPath(SUB_STATE_PATH);
+
+        value[PROPERTY_NUMBER] = 1;
+        subState.notify(value);
+        waitForChangeCount(SUB_STATE_PATH, 1);
+        ASSERT_EQ(s_states[SUB_STATE_PATH].value[PROPERTY_NUMBER].asUInt(), 1);
+
+        value[PROPERTY_NUMBER] = 2;
+        subState.notify(value);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ASSERT_EQ(s_states[SUB_STATE_PATH].changeCount, 1);
+    }
+
+    TEST_F(NotificationDispatcherTest, rate_limit_destroy)
+    {
+        Json::Value value;
+        value[PROPERTY_NUMBER] = 0;
+        ProxyJetStates subState(peer, SUB_STATE_PATH, value, hbk::jet::stateCallback_t());
+        subState.setMinPublishInterval(std::chrono::hours(1));
+        waitForPath(SUB_STATE_PATH);
+        {
+            NotificationDispatcher dispatcher(eventloop, peer);
+            value[PROPERTY_NUMBER] = 1;
+            subState.notify(value);
+            dispatcher.flush();
+            // held back, published on destruction of the dispatcher
+        }
+        waitForChangeCount(SUB_STATE_PATH, 1);
+        ASSERT_EQ(s_states[SUB_STATE_PATH].value[PROPERTY_NUMBER].asUInt(), 1);
+    }
+
+    TEST_F(NotificationDispatcherTest, priority)
+    {
+        NotificationDispatcher dispatcher(eventloop, peer);
+        std::vector < NotificationDispatcher::Priority > executed;
+        {
+            NotificationDispatcher::Batch batch(dispatcher);
+            for (auto priority : { NotificationDispatcher::Priority::Introspection, NotificationDispatcher::Priority::Value, NotificationDispatcher::Priority::Event }) {
+                dispatcher.post(priority, [&executed, priority]() { executed.emplace_back(priority); });
+            }
+            // events are not held back by a batch
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            ASSERT_EQ(executed.size(), 1);
+            ASSERT_EQ(executed.front(), NotificationDispatcher::Priority::Event);
+        }
+        ASSERT_EQ(executed.size(), 3);
+        ASSERT_EQ(executed[1], NotificationDispatcher::Priority::Value);
+        ASSERT_EQ(executed[2], NotificationDispatcher::Priority::Introspection);
+    }
+
+    TEST_F(NotificationDispatcherTest, event_overtakes_backlog)
+    {
+        static const unsigned int count = 1000;
+        // default settings, no limit per iteration
+        NotificationDispatcher dispatcher(eventloop, peer);
+        std::promise < void > release;
+        std::shared_future < void > released = release.get_future().share();
+        // written by the event loop only
+        std::vector < NotificationDispatcher::Priority > executed;
+        std::atomic < unsigned int > executedCount(0);
+        // keeps the event loop busy while the backlog is built up
+        dispatcher.post(NotificationDispatcher::Priority::Value, [released]() { released.wait(); });
+        for (unsigned int i = 0; i < count; ++i) {
+            dispatcher.post(NotificationDispatcher::Priority::Value, [&executed, &executedCount]() {
+                executed.emplace_back(NotificationDispatcher::Priority::Value);
+                ++executedCount;
+            });
+        }
+        // as done by Event::Trigger()
+        dispatcher.post(NotificationDispatcher::Priority::Event, [&executed, &executedCount]() {
+            executed.emplace_back(NotificationDispatcher::Priority::Event);
+            ++executedCount;
+        });
+        release.set_value();
+        for (unsigned int wait = 0; (executedCount < count + 1) && (wait < 5000); ++wait) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_EQ(executedCount, count + 1);
+        ASSERT_EQ(executed.front(), NotificationDispatcher::Priority::Event);
+    }
+
+    TEST_F(NotificationDispatcherTest, max_per_iteration)
+    {
+        static const unsigned int count = 10;
+        NotificationDispatcher dispatcher(eventloop, peer);
+        dispatcher.setMaxPerIteration(1);
+        std::atomic < unsigned int > executed(0);
+        for (unsigned int i = 0; i < count; ++i) {
+            dispatcher.post(NotificationDispatcher::Priority::Value, [&executed]() { ++executed; });
+        }
+        // the remainder is executed in the following iterations
+        for (unsigned int wait = 0; (executed < count) && (wait < 1000); ++wait) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_EQ(executed, count);
+    }
+
+    TEST_F(NotificationDispatcherTest, destroy_pending)
+    {
+        NotificationDispatcher dispatcher(eventloop, peer);
+        NotificationDispatcher::Batch batch(dispatcher);
+        {
+            TestProxy testProxy(peer, PROXY_PATH);
+            testProxy.setNumber(NUMBER_DEFAULT_VALUE + 1);
+            // pending notification is dropped on destruction
+        }
+        dispatcher.flush();
+    }
+}
@@ -0,0 +1,229 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "json/value.h"
+
+#include "jetproxy/JsonSchema.hpp"
+#include "jetproxy/PropertyTable.hpp"
+
+namespace hbk::jetproxy {
+
+    static const char BOOL_PROPERTY[] = "boolProperty";
+    static const char INT_PROPERTY[] = "intProperty";
+    static const char UINT64_PROPERTY[] = "uint64Property";
+    static const char DOUBLE_PROPERTY[] = "doubleProperty";
+    static const char STRING_PROPERTY[] = "stringProperty";
+    static const char ENUM_PROPERTY[] = "enumProperty";
+    static const char ARRAY_PROPERTY[] = "arrayProperty";
+    static const char STD_ARRAY_PROPERTY[] = "stdArrayProperty";
+    static const char VECTOR_PROPERTY[] = "vectorProperty";
+    static const char ENUM_TYPE[] = "myEnumType";
+
+    enum TestEnum {
+        FIRST,
+        SECOND
+    };
+
+    struct Properties {
+        bool boolProperty = false;
+        int intProperty = 1;
+        std::uint64_t uint64Property = 2;
+        double doubleProperty = 3.0;
+        std::string stringProperty = "four";
+        TestEnum enumProperty = FIRST;
+        float arrayProperty[2] = {5.0, 6.0};
+        std::array < int, 3 > stdArrayProperty = {7, 8, 9};
+        std::vector < double > vectorProperty;
+    };
+
+    static const PropertyTable < Properties >& propertyTable()
+    {
+        static const PropertyTable < Properties > table({
+            property < &Properties::boolProperty >(BOOL_PROPERTY, "A bool value."),
+            property < &Properties::intProperty >(INT_PROPERTY, "An int value."),
+            property < &Properties::uint64Property >(UINT64_PROPERTY, "An uint64 value."),
+            property < &Properties::doubleProperty >(DOUBLE_PROPERTY, "A double value."),
+            property < &Properties::stringProperty >(STRING_PROPERTY, "A string value."),
+            property < &Properties::enumProperty >(ENUM_PROPERTY, "An enum value.", ENUM_TYPE),
+            property < &Properties::arrayProperty >(ARRAY_PROPERTY, "An array."),
+            property < &Properties::stdArrayProperty >(STD_ARRAY_PROPERTY, "A std::array."),
+            property < &Properties::vectorProperty >(VECTOR_PROPERTY, "A vector.")
+        });
+        return table;
+    }
+
+    TEST(PropertyTableTest, index)
+    {
+        std::vector < const char* > names = { BOOL_PROPERTY, INT_PROPERTY, UINT64_PROPERTY, DOUBLE_PROPERTY, STRING_PROPERTY };
+        PropertyIndex index(names);
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            ASSERT_EQ(index.find(names[i]), i);
+        }
+        ASSERT_EQ(index.find("unknown"), PropertyIndex::NOT_FOUND);
+        ASSERT_EQ(index.find(""), PropertyIndex::NOT_FOUND);
+
+        PropertyIndex emptyIndex({});
+        ASSERT_EQ(emptyIndex.find(BOOL_PROPERTY), PropertyIndex::NOT_FOUND);
+
+        names.push_back(INT_PROPERTY);
+        ASSERT_THROW(PropertyIndex duplicateIndex(names), std::runtime_error);
+    }
+
+    TEST(PropertyTableTest, compose)
+    {
+        Properties properties;
+        properties.vectorProperty = {10.0, 11.0};
+        Json::Value composition;
+        propertyTable().compose(properties, composition);
+
+        ASSERT_EQ(composition.size(), 9);
+        ASSERT_EQ(composition[BOOL_PROPERTY].asBool(), false);
+        ASSERT_EQ(composition[INT_PROPERTY].asInt(), 1);
+        ASSERT_EQ(composition[UINT64_PROPERTY].asUInt64(), 2);
+        ASSERT_EQ(composition[DOUBLE_PROPERTY].asDouble(), 3.0);
+        ASSERT_EQ(composition[STRING_PROPERTY].asString(), "four");
+        ASSERT_EQ(composition[ENUM_PROPERTY].asInt(), FIRST);
+        ASSERT_EQ(composition[ARRAY_PROPERTY].size(), 2);
+        ASSERT_EQ(composition[ARRAY_PROPERTY][1].asFloat(), 6.0);
+        ASSERT_EQ(composition[STD_ARRAY_PROPERTY].size(), 3);
+        ASSERT_EQ(composition[STD_ARRAY_PROPERTY][2].asInt(), 9);
+        ASSERT_EQ(composition[VECTOR_PROPERTY].size(), 2);
+        ASSERT_EQ(composition[VECTOR_PROPERTY][0].asDouble(), 10.0);
+    }
+
+    TEST(PropertyTableTest, set)
+    {
+        Properties properties;
+        Json::Value request;
+        request[INT_PROPERTY] = 100;
+        request[ENUM_PROPERTY] = SECOND;
+        request[ARRAY_PROPERTY][0] = 50.0;
+        request[ARRAY_PROPERTY][1] = 60.0;
+        // surplus array elements are ignored
+        request[ARRAY_PROPERTY][2] = 70.0;
+        request[VECTOR_PROPERTY][0] = 1.0;
+        // unknown members are ignored
+        request["_type"] = "someType";
+
+        ASSERT_EQ(propertyTable().set(request, properties), 4);
+        ASSERT_EQ(properties.intProperty, 100);
+        ASSERT_EQ(properties.enumProperty, SECOND);
+        ASSERT_EQ(properties.arrayProperty[0], 50.0);
+        ASSERT_EQ(properties.arrayProperty[1], 60.0);
+        ASSERT_EQ(properties.vectorProperty.size(), 1);
+        // untouched
+        ASSERT_EQ(properties.stringProperty, "four");
+        ASSERT_EQ(properties.uint64Property, 2);
+
+        // vector is replaced
+        request = Json::Value();
+        request[VECTOR_PROPERTY][0] = 2.0;
+        request[VECTOR_PROPERTY][1] = 3.0;
+        ASSERT_EQ(propertyTable().set(request, properties), 1);
+        ASSERT_EQ(properties.vectorProperty.size(), 2);
+        ASSERT_EQ(properties.vectorProperty[0], 2.0);
+
+        ASSERT_EQ(propertyTable().set(Json::Value(), properties), 0);
+    }
+
+    TEST(PropertyTableTest, set_invalid)
+    {
+        Properties properties;
+        Json::Value request;
+        request[INT_PROPERTY] = 100;
+        request[STRING_PROPERTY] = 5;
+        ASSERT_THROW(propertyTable().set(request, properties), std::runtime_error);
+        // nothing is to be written
+        ASSERT_EQ(properties.intProperty, 1);
+
+        request = Json::Value();
+        request[INT_PROPERTY] = Json::Int64(1) << 40;
+        ASSERT_THROW(propertyTable().set(request, properties), std::runtime_error);
+
+        request = Json::Value();
+        request[UINT64_PROPERTY] = -1;
+        ASSERT_THROW(propertyTable().set(request, properties), std::runtime_error);
+
+        request = Json::Value();
+        request[ARRAY_PROPERTY][0] = "no number";
+        ASSERT_THROW(propertyTable().set(request, properties), std::runtime_error);
+
+        request = Json::Value();
+        request[BOOL_PROPERTY] = "no bool";
+        ASSERT_THROW(propertyTable().set(request, properties), std::runtime_error);
+    }
+
+    TEST(PropertyTableTest, set_stricter_than_as)
+    {
+        Properties properties;
+        Json::Value request;
+        // asInt() would truncate to 3
+        request[INT_PROPERTY] = 3.5;
+        ASSERT_THROW(propertyTable().set(request, properties), std::runtime_error);
+        ASSERT_EQ(properties.intProperty, 1);
+        request[INT_PROPERTY] = 3.0;
+        ASSERT_EQ(propertyTable().set(request, properties), 1);
+        ASSERT_EQ(properties.intProperty, 3);
+
+        // asBool() would accept numbers
+        request = Json::Value();
+        request[BOOL_PROPERTY] = 1;
+        ASSERT_THROW(propertyTable().set(request, properties), std::runtime_error);
+
+        // enums are settable by their number
+        request = Json::Value();
+        request[ENUM_PROPERTY] = 1;
+        ASSERT_EQ(propertyTable().set(request, properties), 1);
+        ASSERT_EQ(properties.enumProperty, SECOND);
+        request[ENUM_PROPERTY] = 2.5;
+        ASSERT_THROW(propertyTable().set(request, properties), std::runtime_error);
+        ASSERT_EQ(properties.enumProperty, SECOND);
+    }
+
+    TEST(PropertyTableTest, compose_types)
+    {
+        Json::Value types = propertyTable().composeTypes();
+        ASSERT_EQ(types.size(), 9);
+        ASSERT_EQ(types[BOOL_PROPERTY][JsonSchema::TYPE], JsonSchema::TYPE_BOOL);
+        ASSERT_EQ(types[BOOL_PROPERTY][JsonSchema::DESCRIPTION], "A bool value.");
+        ASSERT_EQ(types[INT_PROPERTY][JsonSchema::TYPE], JsonSchema::TYPE_INT32);
+        ASSERT_EQ(types[UINT64_PROPERTY][JsonSchema::TYPE], JsonSchema::TYPE_UINT64);
+        ASSERT_EQ(types[DOUBLE_PROPERTY][JsonSchema::TYPE], JsonSchema::TYPE_DOUBLE);
+        ASSERT_EQ(types[STRING_PROPERTY][JsonSchema::TYPE], JsonSchema::TYPE_STRING);
+        ASSERT_EQ(types[ENUM_PROPERTY][JsonSchema::TYPE], ENUM_TYPE);
+        ASSERT_EQ(types[ARRAY_PROPERTY][JsonSchema::TYPE], JsonSchema::TYPE_ARRAY);
+        ASSERT_EQ(types[ARRAY_PROPERTY][JsonSchema::MAX_ITEMS].asUInt(), 2);
+        ASSERT_EQ(types[ARRAY_PROPERTY][JsonSchema::ITEMS][JsonSchema::TYPE], JsonSchema::TYPE_FLOAT);
+        ASSERT_EQ(types[STD_ARRAY_PROPERTY][JsonSchema::MAX_ITEMS].asUInt(), 3);
+        ASSERT_EQ(types[VECTOR_PROPERTY][JsonSchema::TYPE], JsonSchema::TYPE_VECTOR);
+        ASSERT_EQ(types[VECTOR_PROPERTY][JsonSchema::ITEMS][JsonSchema::TYPE], JsonSchema::TYPE_DOUBLE);
+    }
+}
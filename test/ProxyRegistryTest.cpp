@@ -0,0 +1,1164 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "json/reader.h"
+#include "json/value.h"
+
+#include "hbk/sys/eventloop.h"
+#include "jet/defines.h"
+#include "jet/peerasync.hpp"
+
+#include "jetproxy/ChangeBus.hpp"
+#include "jetproxy/CommandQueue.hpp"
+#include "jetproxy/JetProxy.hpp"
+#include "jetproxy/ProxyJetStates.hpp"
+#include "jetproxy/ProxyRegistry.hpp"
+
+namespace hbk::jetproxy {
+
+    static const char TYPE[] = "TestProxy";
+    static const char PROPERTY_NUMBER[] = "number";
+    static const std::string PATH_PREFIX = "/ProxyRegistryTest";
+    static const std::string CONFIG_FILE = "ProxyRegistryTest.json";
+
+    class TestProxy : public JetProxy
+    {
+    public:
+        TestProxy(hbk::jet::PeerAsync& peer, const std::string& path)
+            : JetProxy(peer, TYPE, path, true)
+            , m_number(0)
+        {
+        }
+
+        TestProxy(ProxyRegistry& registry, hbk::jet::PeerAsync& peer, const std::string& path)
+            : JetProxy(registry, peer, TYPE, path, true)
+            , m_number(0)
+        {
+        }
+
+        void restoreDefaults() override
+        {
+            m_number = 0;
+        }
+
+        void composeProperties(Json::Value& composition) const override
+        {
+            composition[PROPERTY_NUMBER] = m_number;
+        }
+
+        hbk::jet::SetStateCbResult setFromJet(const Json::Value& request) override
+        {
+            m_number = request[PROPERTY_NUMBER].asUInt();
+            return Json::Value();
+        }
+
+        void setNumber(unsigned int number)
+        {
+            m_number = number;
+            notify();
+        }
+
+        unsigned int getNumber() const
+        {
+            return m_number;
+        }
+
+    private:
+        unsigned int m_number;
+    };
+
+    /// Accepts numbers up to the number of its limit only
+    class LimitedProxy : public TestProxy
+    {
+    public:
+        LimitedProxy(ProxyRegistry& registry, hbk::jet::PeerAsync& peer, const std::string& path, const TestProxy& limit)
+            : TestProxy(registry, peer, path)
+            , m_limit(limit)
+        {
+        }
+
+        std::vector < std::string > getRestoreDependencies() const override
+        {
+            return { m_limit.getPath() };
+        }
+
+        hbk::jet::SetStateCbResult setFromJet(const Json::Value& request) override
+        {
+            if (request[PROPERTY_NUMBER].asUInt() > m_limit.getNumber()) {
+                throw std::runtime_error("number exceeds limit");
+            }
+            return TestProxy::setFromJet(request);
+        }
+
+    private:
+        const TestProxy& m_limit;
+    };
+
+    /// Fails to compose
+    class ThrowingProxy : public TestProxy
+    {
+    public:
+        using TestProxy::TestProxy;
+
+        void composeProperties(Json::Value&) const override
+        {
+            throw std::runtime_error("compose failed");
+        }
+    };
+
+    class ProxyRegistryTest : public ::testing::Test {
+    protected:
+        hbk::sys::EventLoop eventloop;
+        hbk::jet::PeerAsync peer;
+
+        ProxyRegistryTest()
+            : peer(eventloop, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0)
+        {
+        }
+
+        static std::vector < std::string > collect(const ProxyRegistry& registry, const std::string& prefix)
+        {
+            std::vector < std::string > paths;
+            registry.forEach(prefix, [&paths](JetProxy& jetProxy) {
+                paths.emplace_back(jetProxy.getPath());
+            });
+            return paths;
+        }
+    };
+
+    TEST_F(ProxyRegistryTest, insert_find_erase)
+    {
+        const std::string path = PATH_PREFIX + "/a";
+        TestProxy testProxy(peer, path);
+        TestProxy otherProxy(peer, PATH_PREFIX + "/b");
+        ProxyRegistry registry;
+        registry.insert(path, testProxy);
+        ASSERT_EQ(registry.size(), 1);
+        ASSERT_EQ(registry.find(path), &testProxy);
+        ASSERT_EQ(registry.find(PATH_PREFIX), nullptr);
+        ASSERT_EQ(registry.find(path + "/x"), nullptr);
+        ASSERT_THROW(registry.insert(path, otherProxy), std::runtime_error);
+
+        // only the registered jet proxy unregisters
+        ASSERT_EQ(registry.erase(path, otherProxy), 0);
+        ASSERT_EQ(registry.erase(path, testProxy), 1);
+        ASSERT_EQ(registry.erase(path, testProxy), 0);
+        ASSERT_EQ(registry.size(), 0);
+        ASSERT_EQ(registry.find(path), nullptr);
+        ASSERT_TRUE(collect(registry, "").empty());
+    }
+
+    TEST_F(ProxyRegistryTest, prefix)
+    {
+        const std::vector < std::string > paths = {
+            PATH_PREFIX + "/a",
+            PATH_PREFIX + "/a/y",
+            PATH_PREFIX + "/a/x",
+            PATH_PREFIX + "/ax",
+            PATH_PREFIX + "/b/c",
+        };
+        ProxyRegistry registry;
+        std::vector < std::unique_ptr < TestProxy > > proxies;
+        for (const auto& path : paths) {
+            proxies.emplace_back(std::make_unique < TestProxy >(peer, path));
+            registry.insert(path, *proxies.back());
+        }
+
+        const std::vector < std::string > subtree = { PATH_PREFIX + "/a", PATH_PREFIX + "/a/x", PATH_PREFIX + "/a/y" };
+        ASSERT_EQ(collect(registry, PATH_PREFIX + "/a"), subtree);
+        ASSERT_EQ(collect(registry, PATH_PREFIX + "/a/"), subtree);
+        ASSERT_EQ(collect(registry, PATH_PREFIX + "/b").size(), 1);
+        ASSERT_TRUE(collect(registry, PATH_PREFIX + "/c").empty());
+        ASSERT_EQ(collect(registry, PATH_PREFIX).size(), paths.size());
+        ASSERT_EQ(collect(registry, "").size(), paths.size());
+
+        // the subtree is gone with its last jet proxy
+        ASSERT_EQ(registry.erase(PATH_PREFIX + "/b/c", *proxies.back()), 1);
+        ASSERT_TRUE(collect(registry, PATH_PREFIX + "/b").empty());
+    }
+
+    TEST_F(ProxyRegistryTest, handle)
+    {
+        const std::string path = PATH_PREFIX + "/a";
+        ProxyRegistry registry;
+        ASSERT_EQ(registry.resolve(registry.getHandle(path)), nullptr);
+
+        TestProxy testProxy(peer, path);
+        registry.insert(path, testProxy);
+        const ProxyRegistry::Handle handle = registry.getHandle(path);
+        ASSERT_EQ(registry.resolve(handle), &testProxy);
+
+        TestProxy movedProxy(std::move(testProxy));
+        registry.replace(path, testProxy, movedProxy);
+        ASSERT_EQ(registry.resolve(handle), &movedProxy);
+
+        // a jet proxy registered again under the same path is another one
+        registry.erase(path, movedProxy);
+        registry.insert(path, movedProxy);
+        ASSERT_EQ(registry.resolve(handle), nullptr);
+        ASSERT_EQ(registry.find(path), &movedProxy);
+    }
+
+    TEST_F(ProxyRegistryTest, default_registry)
+    {
+        const std::string path = PATH_PREFIX + "/a";
+        {
+            TestProxy testProxy(peer, path);
+            ASSERT_EQ(ProxyRegistry::getDefault().find(path), &testProxy);
+            ASSERT_EQ(&testProxy.getRegistry(), &ProxyRegistry::getDefault());
+        }
+        ASSERT_EQ(ProxyRegistry::getDefault().find(path), nullptr);
+    }
+
+    TEST_F(ProxyRegistryTest, independent_registries)
+    {
+        // the same path may exist in several registries
+        const std::string path = PATH_PREFIX + "/a";
+        ProxyRegistry registry1;
+        ProxyRegistry registry2;
+        TestProxy testProxy1(registry1, peer, path);
+        TestProxy testProxy2(registry2, peer, path);
+        ASSERT_EQ(&testProxy1.getRegistry(), &registry1);
+        ASSERT_EQ(registry1.find(path), &testProxy1);
+        ASSERT_EQ(registry2.find(path), &testProxy2);
+        ASSERT_EQ(ProxyRegistry::getDefault().find(path), nullptr);
+
+        testProxy1.setNumber(1);
+        testProxy2.setNumber(2);
+        ASSERT_EQ(registry1.saveToFile(CONFIG_FILE), 0);
+
+        ASSERT_EQ(registry2.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(testProxy2.getNumber(), 1);
+
+        registry1.restoreDefaults();
+        ASSERT_EQ(testProxy1.getNumber(), 0);
+        ASSERT_EQ(testProxy2.getNumber(), 1);
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, subtree)
+    {
+        ASSERT_TRUE(ProxyRegistry::isInSubtree(PATH_PREFIX + "/a", ""));
+        ASSERT_TRUE(ProxyRegistry::isInSubtree(PATH_PREFIX + "/a", PATH_PREFIX + "/a"));
+        ASSERT_TRUE(ProxyRegistry::isInSubtree(PATH_PREFIX + "/a/x", PATH_PREFIX + "/a/"));
+        ASSERT_FALSE(ProxyRegistry::isInSubtree(PATH_PREFIX + "/ax", PATH_PREFIX + "/a"));
+        ASSERT_FALSE(ProxyRegistry::isInSubtree(PATH_PREFIX, PATH_PREFIX + "/a"));
+
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        TestProxy proxyAX(registry, peer, PATH_PREFIX + "/a/x");
+        TestProxy proxyB(registry, peer, PATH_PREFIX + "/b");
+        proxyA.setNumber(1);
+        proxyAX.setNumber(2);
+        proxyB.setNumber(3);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+
+        // only the subtree is replaced within the file
+        proxyA.setNumber(11);
+        proxyAX.setNumber(12);
+        proxyB.setNumber(13);
+        ASSERT_EQ(registry.saveSubtreeToFile(CONFIG_FILE, PATH_PREFIX + "/a"), 0);
+
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 11);
+        ASSERT_EQ(proxyAX.getNumber(), 12);
+        ASSERT_EQ(proxyB.getNumber(), 3);
+
+        // only the subtree is restored
+        proxyA.setNumber(21);
+        proxyAX.setNumber(22);
+        proxyB.setNumber(23);
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE, PATH_PREFIX + "/a/x"), 0);
+        ASSERT_EQ(proxyA.getNumber(), 21);
+        ASSERT_EQ(proxyAX.getNumber(), 12);
+        ASSERT_EQ(proxyB.getNumber(), 23);
+
+        ASSERT_EQ(registry.restoreDefaults(PATH_PREFIX + "/a"), 0);
+        ASSERT_EQ(proxyA.getNumber(), 0);
+        ASSERT_EQ(proxyAX.getNumber(), 0);
+        ASSERT_EQ(proxyB.getNumber(), 23);
+        std::remove(CONFIG_FILE.c_str());
+
+        // without file, defaults are loaded for the subtree only
+        proxyA.setNumber(31);
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE, PATH_PREFIX + "/b"), -1);
+        ASSERT_EQ(proxyA.getNumber(), 31);
+        ASSERT_EQ(proxyB.getNumber(), 0);
+
+        // a subtree can be saved into a new file
+        ASSERT_EQ(registry.saveSubtreeToFile(CONFIG_FILE, PATH_PREFIX + "/a"), 0);
+        proxyA.setNumber(0);
+        proxyB.setNumber(43);
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 31);
+        ASSERT_EQ(proxyB.getNumber(), 43);
+
+        // a damaged file is not replaced by the subtree, the entries outside of it would get lost
+        {
+            std::ofstream file(CONFIG_FILE, std::ios::trunc);
+            file << "{ damaged";
+        }
+        ASSERT_EQ(registry.saveSubtreeToFile(CONFIG_FILE, PATH_PREFIX + "/a"), -1);
+        {
+            std::ifstream file(CONFIG_FILE);
+            std::string content;
+            ASSERT_TRUE(std::getline(file, content));
+            ASSERT_EQ(content, "{ damaged");
+        }
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, journal)
+    {
+        const std::string journalFile = ProxyRegistry::getJournalFileName(CONFIG_FILE);
+        std::remove(CONFIG_FILE.c_str());
+        std::remove(journalFile.c_str());
+
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        TestProxy proxyAX(registry, peer, PATH_PREFIX + "/a/x");
+        TestProxy proxyB(registry, peer, PATH_PREFIX + "/b");
+        proxyA.setNumber(1);
+        proxyAX.setNumber(2);
+        proxyB.setNumber(3);
+
+        // a journal without file is sufficient to restore
+        ASSERT_EQ(registry.appendToJournal(CONFIG_FILE, { PATH_PREFIX + "/a", PATH_PREFIX + "/b" }), 0);
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 1);
+        ASSERT_EQ(proxyAX.getNumber(), 0);
+        ASSERT_EQ(proxyB.getNumber(), 3);
+
+        // saving the complete file drops the journal
+        proxyAX.setNumber(2);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        ASSERT_EQ(ProxyRegistry::getJournalSize(CONFIG_FILE), 0);
+
+        // a state of a sub object belongs to the jet proxy above
+        proxyA.setNumber(11);
+        proxyAX.setNumber(12);
+        proxyB.setNumber(13);
+        ASSERT_EQ(registry.appendToJournal(CONFIG_FILE, { PATH_PREFIX + "/a/x/subObject" }), 0);
+        ASSERT_EQ(registry.appendToJournal(CONFIG_FILE, { PATH_PREFIX + "/a" }), 0);
+        {
+            // a torn record is ignored
+            std::ofstream journal(journalFile, std::ios::app);
+            journal << "{\"path\" : \"" << PATH_PREFIX << "/b\", \"con";
+        }
+        const std::uintmax_t journalSize = ProxyRegistry::getJournalSize(CONFIG_FILE);
+        ASSERT_GT(journalSize, 0);
+
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 11);
+        ASSERT_EQ(proxyAX.getNumber(), 12);
+        ASSERT_EQ(proxyB.getNumber(), 3);
+
+        // the last record wins
+        proxyA.setNumber(21);
+        ASSERT_EQ(registry.appendToJournal(CONFIG_FILE, { PATH_PREFIX + "/a" }), 0);
+        ASSERT_GT(ProxyRegistry::getJournalSize(CONFIG_FILE), journalSize);
+
+        ASSERT_EQ(registry.compactJournal(CONFIG_FILE), 0);
+        ASSERT_EQ(ProxyRegistry::getJournalSize(CONFIG_FILE), 0);
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 21);
+        ASSERT_EQ(proxyAX.getNumber(), 12);
+        ASSERT_EQ(proxyB.getNumber(), 3);
+
+        // jet proxies that are gone get removed from the file
+        {
+            TestProxy proxyC(registry, peer, PATH_PREFIX + "/c");
+            proxyC.setNumber(4);
+            ASSERT_EQ(registry.appendToJournal(CONFIG_FILE, { PATH_PREFIX + "/c" }), 0);
+        }
+        ASSERT_EQ(registry.appendToJournal(CONFIG_FILE, { PATH_PREFIX + "/c" }), 0);
+        ASSERT_EQ(registry.compactJournal(CONFIG_FILE), 0);
+        {
+            std::ifstream file(CONFIG_FILE);
+            Json::Value config;
+            file >> config;
+            ASSERT_FALSE(config.isMember(PATH_PREFIX + "/c"));
+            ASSERT_TRUE(config.isMember(PATH_PREFIX + "/b"));
+        }
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, incremental_save)
+    {
+        static const std::string FULL_CONFIG_FILE = "ProxyRegistryTestFull.json";
+        auto readAll = [](const std::string& fileName) {
+            std::ifstream file(fileName);
+            return std::string(std::istreambuf_iterator < char >(file), std::istreambuf_iterator < char >());
+        };
+
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        TestProxy proxyAX(registry, peer, PATH_PREFIX + "/a/x");
+        TestProxy proxyB(registry, peer, PATH_PREFIX + "/b");
+        proxyA.setNumber(1);
+        proxyAX.setNumber(2);
+        proxyB.setNumber(3);
+
+        registry.setIncrementalSave(true);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        ASSERT_EQ(registry.getComposedCount(), 3);
+        ASSERT_EQ(registry.getReusedCount(), 0);
+
+        // only the changed jet proxy is composed again
+        proxyA.setNumber(11);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        ASSERT_EQ(registry.getComposedCount(), 4);
+        ASSERT_EQ(registry.getReusedCount(), 2);
+
+        // the file looks the same as without incremental save
+        registry.setIncrementalSave(false);
+        ASSERT_EQ(registry.saveToFile(FULL_CONFIG_FILE), 0);
+        ASSERT_EQ(readAll(CONFIG_FILE), readAll(FULL_CONFIG_FILE));
+        std::remove(FULL_CONFIG_FILE.c_str());
+
+        registry.setIncrementalSave(true);
+        proxyB.setPersistent(false);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        ASSERT_EQ(registry.getComposedCount(), 4);
+        ASSERT_EQ(registry.getReusedCount(), 4);
+
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 11);
+        ASSERT_EQ(proxyAX.getNumber(), 2);
+        ASSERT_EQ(proxyB.getNumber(), 0);
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, durability)
+    {
+        ProxyRegistry registry;
+        ASSERT_EQ(registry.getDurability(), ProxyRegistry::Durability::FILE);
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+
+        for (auto durability : { ProxyRegistry::Durability::NONE, ProxyRegistry::Durability::FILE, ProxyRegistry::Durability::FULL }) {
+            registry.setDurability(durability);
+            proxyA.setNumber(static_cast < unsigned int >(durability) + 1);
+            ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+            ASSERT_EQ(registry.appendToJournal(CONFIG_FILE, { PATH_PREFIX + "/a" }), 0);
+            ASSERT_EQ(registry.compactJournal(CONFIG_FILE), 0);
+            registry.restoreDefaults();
+            ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+            ASSERT_EQ(proxyA.getNumber(), static_cast < unsigned int >(durability) + 1);
+        }
+
+        const ProxyRegistry::SaveDurations durations = registry.getLastSaveDurations();
+        ASSERT_GE(durations.compose.count(), 0);
+        ASSERT_GE(durations.write.count(), 0);
+        ASSERT_GE(durations.syncFile.count(), 0);
+        ASSERT_GE(durations.rename.count(), 0);
+
+        // a file in a directory that does not exist can not be written
+        ASSERT_EQ(registry.saveToFile("/nonexistent/" + CONFIG_FILE), -1);
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, async_save)
+    {
+        std::remove(CONFIG_FILE.c_str());
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        TestProxy proxyB(registry, peer, PATH_PREFIX + "/b");
+
+        std::atomic < unsigned int > completed(0);
+        auto completion = [&completed](int result, const ProxyRegistry::SaveDurations&) {
+            if (result == 0) {
+                ++completed;
+            }
+        };
+
+        static const unsigned int SAVE_COUNT = 10;
+        for (unsigned int count = 1; count <= SAVE_COUNT; ++count) {
+            proxyA.setNumber(count);
+            ASSERT_EQ(registry.saveToFileAsync(CONFIG_FILE, completion), 0);
+        }
+        // the configuration was taken already
+        proxyA.setNumber(0);
+        proxyB.setNumber(0);
+        registry.waitForAsyncSaves();
+        ASSERT_EQ(completed, SAVE_COUNT);
+
+        // the last one wins
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), SAVE_COUNT);
+
+        // synchronous and asynchronous saves may be mixed
+        proxyA.setNumber(1);
+        ASSERT_EQ(registry.saveToFileAsync(CONFIG_FILE), 0);
+        registry.waitForAsyncSaves();
+        proxyA.setNumber(2);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 2);
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, binary_format)
+    {
+        static const std::string BINARY_CONFIG_FILE = "ProxyRegistryTest.cbor";
+        static const std::string FULL_BINARY_CONFIG_FILE = "ProxyRegistryTestFull.cbor";
+        auto readAll = [](const std::string& fileName) {
+            std::ifstream file(fileName, std::ios::binary);
+            return std::string(std::istreambuf_iterator < char >(file), std::istreambuf_iterator < char >());
+        };
+
+        ProxyRegistry registry;
+        ASSERT_EQ(registry.getFormat(), ProxyRegistry::Format::JSON);
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        TestProxy proxyB(registry, peer, PATH_PREFIX + "/b");
+        proxyA.setNumber(1);
+        proxyB.setNumber(2);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+
+        registry.setFormat(ProxyRegistry::Format::CBOR);
+        ASSERT_EQ(registry.saveToFile(BINARY_CONFIG_FILE), 0);
+        ASSERT_LT(readAll(BINARY_CONFIG_FILE).size(), readAll(CONFIG_FILE).size());
+
+        // the format is detected when restoring
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(BINARY_CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 1);
+        ASSERT_EQ(proxyB.getNumber(), 2);
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 1);
+        ASSERT_EQ(proxyB.getNumber(), 2);
+
+        // incremental save writes the same bytes
+        registry.setIncrementalSave(true);
+        proxyA.setNumber(11);
+        ASSERT_EQ(registry.saveToFile(BINARY_CONFIG_FILE), 0);
+        registry.setIncrementalSave(false);
+        ASSERT_EQ(registry.saveToFile(FULL_BINARY_CONFIG_FILE), 0);
+        ASSERT_EQ(readAll(BINARY_CONFIG_FILE), readAll(FULL_BINARY_CONFIG_FILE));
+        std::remove(FULL_BINARY_CONFIG_FILE.c_str());
+
+        // the journal is replayed into the binary file
+        proxyB.setNumber(22);
+        ASSERT_EQ(registry.appendToJournal(BINARY_CONFIG_FILE, { PATH_PREFIX + "/b" }), 0);
+        ASSERT_EQ(registry.compactJournal(BINARY_CONFIG_FILE), 0);
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(BINARY_CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 11);
+        ASSERT_EQ(proxyB.getNumber(), 22);
+
+        // readable export
+        std::remove(CONFIG_FILE.c_str());
+        ASSERT_EQ(registry.exportToJson(BINARY_CONFIG_FILE, CONFIG_FILE), 0);
+        Json::Value exported;
+        {
+            std::ifstream file(CONFIG_FILE);
+            file >> exported;
+        }
+        ASSERT_EQ(exported[PATH_PREFIX + "/a"][PROPERTY_NUMBER].asUInt(), 11);
+        ASSERT_EQ(exported[PATH_PREFIX + "/b"][PROPERTY_NUMBER].asUInt(), 22);
+        ASSERT_EQ(registry.exportToJson("nonexistent.cbor", CONFIG_FILE), -1);
+
+        std::remove(CONFIG_FILE.c_str());
+        std::remove(BINARY_CONFIG_FILE.c_str());
+        std::remove(ProxyRegistry::getJournalFileName(BINARY_CONFIG_FILE).c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, invalid_entry)
+    {
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        TestProxy proxyB(registry, peer, PATH_PREFIX + "/b");
+        {
+            std::ofstream file(CONFIG_FILE, std::ios::trunc);
+            file << "{ \"" << PATH_PREFIX << "/a\" : { \"" << PROPERTY_NUMBER << "\" : 1 },"
+                 << " \"" << PATH_PREFIX << "/b\" : { \"" << PROPERTY_NUMBER << "\" : nonsense } }";
+        }
+        proxyB.setNumber(5);
+        // entries are parsed one by one, only the jet proxy with the broken one gets defaults
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 1);
+        ASSERT_EQ(proxyB.getNumber(), 0);
+
+        // the journal wins over the file
+        proxyB.setNumber(2);
+        ASSERT_EQ(registry.appendToJournal(CONFIG_FILE, { PATH_PREFIX + "/b" }), 0);
+        proxyB.setNumber(5);
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 1);
+        ASSERT_EQ(proxyB.getNumber(), 2);
+        std::remove(CONFIG_FILE.c_str());
+        std::remove(ProxyRegistry::getJournalFileName(CONFIG_FILE).c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, invalid_type)
+    {
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        TestProxy proxyB(registry, peer, PATH_PREFIX + "/b");
+        TestProxy proxyC(registry, peer, PATH_PREFIX + "/c");
+        {
+            // parses, but asUInt() throws Json::LogicError instead of std::runtime_error
+            std::ofstream file(CONFIG_FILE, std::ios::trunc);
+            file << "{ \"" << PATH_PREFIX << "/a\" : { \"" << PROPERTY_NUMBER << "\" : 1 },"
+                 << " \"" << PATH_PREFIX << "/b\" : { \"" << PROPERTY_NUMBER << "\" : \"text\" },"
+                 << " \"" << PATH_PREFIX << "/c\" : { \"" << PROPERTY_NUMBER << "\" : 3 } }";
+        }
+        proxyB.setNumber(5);
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 1);
+        ASSERT_EQ(proxyB.getNumber(), 0);
+        ASSERT_EQ(proxyC.getNumber(), 3);
+
+        // the slices after the failing jet proxy are restored and the completion is called
+        registry.restoreDefaults();
+        proxyB.setNumber(5);
+        {
+            CommandQueue commandQueue(eventloop, peer);
+            std::thread eventLoopThread(std::bind(&hbk::sys::EventLoop::execute, std::ref(eventloop)));
+            registry.setRestoreSlice(1, std::chrono::hours(1));
+            std::promise < int > completion;
+            ASSERT_EQ(registry.restoreFromFileSliced(CONFIG_FILE, "", ProxyRegistry::RestoreProgress(), [&completion](int completed) {
+                completion.set_value(completed);
+            }), 0);
+            auto done = completion.get_future();
+            ASSERT_EQ(done.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+            ASSERT_EQ(done.get(), 0);
+            ASSERT_EQ(proxyA.getNumber(), 1);
+            ASSERT_EQ(proxyB.getNumber(), 0);
+            ASSERT_EQ(proxyC.getNumber(), 3);
+
+            eventloop.stop();
+            eventLoopThread.join();
+        }
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, skip_unchanged)
+    {
+        static const std::string OTHER_FILE = "ProxyRegistryTestOther.json";
+        ProxyRegistry registry;
+        TestProxy proxyB(registry, peer, PATH_PREFIX + "/b");
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        proxyA.setNumber(1);
+        std::remove(CONFIG_FILE.c_str());
+
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        ASSERT_EQ(registry.getWriteCount(), 1u);
+        ASSERT_EQ(registry.getSkippedWriteCount(), 0u);
+        const auto fileTime = std::filesystem::last_write_time(CONFIG_FILE);
+
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        ASSERT_EQ(registry.getWriteCount(), 1u);
+        ASSERT_EQ(registry.getSkippedWriteCount(), 1u);
+        ASSERT_TRUE(registry.getLastSaveDurations().skipped);
+        ASSERT_EQ(std::filesystem::last_write_time(CONFIG_FILE), fileTime);
+
+        // the same content gives the same file, regardless of the order of registration
+        {
+            ProxyRegistry otherRegistry;
+            TestProxy otherA(otherRegistry, peer, PATH_PREFIX + "/a");
+            TestProxy otherB(otherRegistry, peer, PATH_PREFIX + "/b");
+            otherA.setNumber(1);
+            ASSERT_EQ(otherRegistry.saveToFile(OTHER_FILE), 0);
+        }
+        {
+            std::ifstream file(CONFIG_FILE);
+            std::ifstream otherFile(OTHER_FILE);
+            ASSERT_EQ(std::string(std::istreambuf_iterator < char >(file), std::istreambuf_iterator < char >()),
+                      std::string(std::istreambuf_iterator < char >(otherFile), std::istreambuf_iterator < char >()));
+        }
+
+        // journal records covered by the skipped write are dropped nevertheless
+        proxyA.setNumber(2);
+        ASSERT_EQ(registry.appendToJournal(CONFIG_FILE, { PATH_PREFIX + "/a" }), 0);
+        proxyA.setNumber(1);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        ASSERT_EQ(registry.getSkippedWriteCount(), 2u);
+        ASSERT_EQ(ProxyRegistry::getJournalSize(CONFIG_FILE), 0u);
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 1);
+
+        proxyA.setNumber(3);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        ASSERT_EQ(registry.getWriteCount(), 2u);
+
+        // a file changed by others is written again
+        {
+            std::ofstream file(CONFIG_FILE, std::ios::trunc);
+            file << "{}";
+        }
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        ASSERT_EQ(registry.getWriteCount(), 3u);
+        ASSERT_EQ(registry.getSkippedWriteCount(), 2u);
+        std::remove(CONFIG_FILE.c_str());
+        std::remove(OTHER_FILE.c_str());
+        std::remove(ProxyRegistry::getJournalFileName(CONFIG_FILE).c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, exception_in_event_loop)
+    {
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        {
+            ThrowingProxy throwing(registry, peer, PATH_PREFIX + "/throwing");
+            CommandQueue commandQueue(eventloop, peer);
+            std::thread eventLoopThread(std::bind(&hbk::sys::EventLoop::execute, std::ref(eventloop)));
+
+            // the exception reaches the caller instead of the event loop
+            ASSERT_THROW(registry.saveToFile(CONFIG_FILE), std::runtime_error);
+            std::promise < void > executed;
+            commandQueue.post([&executed]() {
+                executed.set_value();
+            });
+            ASSERT_EQ(executed.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+
+            eventloop.stop();
+            eventLoopThread.join();
+        }
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, save_restore_directory)
+    {
+        static const std::string CONFIG_DIRECTORY = "ProxyRegistryTestShards";
+        ASSERT_EQ(ProxyRegistry::getShardFileName("dir", "/fb/scaler 1"), "dir/%2Ffb%2Fscaler%201.config");
+        std::filesystem::remove_all(CONFIG_DIRECTORY);
+
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        const std::string shardA = ProxyRegistry::getShardFileName(CONFIG_DIRECTORY, PATH_PREFIX + "/a");
+        const std::string shardB = ProxyRegistry::getShardFileName(CONFIG_DIRECTORY, PATH_PREFIX + "/b");
+        {
+            TestProxy proxyB(registry, peer, PATH_PREFIX + "/b");
+            proxyA.setNumber(1);
+            proxyB.setNumber(2);
+            ASSERT_EQ(registry.saveToDirectory(CONFIG_DIRECTORY), 0);
+            ASSERT_EQ(registry.getWriteCount(), 2u);
+            ASSERT_TRUE(std::filesystem::exists(shardA));
+            ASSERT_TRUE(std::filesystem::exists(shardB));
+
+            // a shard is a configuration file with one entry
+            ProxyRegistry fileRegistry;
+            TestProxy fileProxyB(fileRegistry, peer, PATH_PREFIX + "/b");
+            ASSERT_EQ(fileRegistry.restoreFromFile(shardB), 0);
+            ASSERT_EQ(fileProxyB.getNumber(), 2);
+
+            // only the shard of the changed jet proxy is written
+            const auto shardTimeB = std::filesystem::last_write_time(shardB);
+            proxyA.setNumber(3);
+            ASSERT_EQ(registry.saveToDirectory(CONFIG_DIRECTORY), 0);
+            ASSERT_EQ(registry.getWriteCount(), 3u);
+            ASSERT_EQ(registry.getSkippedWriteCount(), 1u);
+            ASSERT_EQ(std::filesystem::last_write_time(shardB), shardTimeB);
+            ASSERT_EQ(registry.saveToDirectory(CONFIG_DIRECTORY), 0);
+            ASSERT_EQ(registry.getWriteCount(), 3u);
+            ASSERT_TRUE(registry.getLastSaveDurations().skipped);
+
+            proxyA.setNumber(0);
+            proxyB.setNumber(0);
+            ASSERT_EQ(registry.restoreFromDirectory(CONFIG_DIRECTORY), 0);
+            ASSERT_EQ(proxyA.getNumber(), 3);
+            ASSERT_EQ(proxyB.getNumber(), 2);
+
+            // a damaged shard loses its jet proxy only
+            {
+                std::ofstream file(shardB, std::ios::trunc);
+                file << "{ damaged";
+            }
+            proxyB.setNumber(7);
+            registry.setRestoreThreads(2);
+            ASSERT_EQ(registry.restoreFromDirectory(CONFIG_DIRECTORY), 0);
+            ASSERT_EQ(proxyA.getNumber(), 3);
+            ASSERT_EQ(proxyB.getNumber(), 0);
+
+            // shards outside the subtree are not touched
+            proxyA.setNumber(5);
+            proxyB.setNumber(7);
+            ASSERT_EQ(registry.restoreFromDirectory(CONFIG_DIRECTORY, PATH_PREFIX + "/a"), 0);
+            ASSERT_EQ(proxyA.getNumber(), 3);
+            ASSERT_EQ(proxyB.getNumber(), 7);
+            ASSERT_EQ(registry.saveToDirectory(CONFIG_DIRECTORY), 0);
+        }
+
+        // the shard of a jet proxy that is gone is removed
+        ASSERT_EQ(registry.saveToDirectory(CONFIG_DIRECTORY), 0);
+        ASSERT_TRUE(std::filesystem::exists(shardA));
+        ASSERT_FALSE(std::filesystem::exists(shardB));
+
+        // shards holding the content already are not written after a restart
+        {
+            ProxyRegistry otherRegistry;
+            TestProxy otherA(otherRegistry, peer, PATH_PREFIX + "/a");
+            otherRegistry.setIncrementalSave(true);
+            ASSERT_EQ(otherRegistry.restoreFromDirectory(CONFIG_DIRECTORY), 0);
+            ASSERT_EQ(otherA.getNumber(), 3);
+            ASSERT_EQ(otherRegistry.saveToDirectory(CONFIG_DIRECTORY), 0);
+            ASSERT_EQ(otherRegistry.getWriteCount(), 0u);
+            ASSERT_EQ(otherRegistry.getSkippedWriteCount(), 1u);
+        }
+
+        std::filesystem::remove_all(CONFIG_DIRECTORY);
+        proxyA.setNumber(5);
+        ASSERT_EQ(registry.restoreFromDirectory(CONFIG_DIRECTORY), -1);
+        ASSERT_EQ(proxyA.getNumber(), 0);
+    }
+
+    TEST_F(ProxyRegistryTest, long_shard_names)
+    {
+        static const std::string CONFIG_DIRECTORY = "ProxyRegistryTestLongShards";
+        std::filesystem::remove_all(CONFIG_DIRECTORY);
+        const std::string longPrefix = PATH_PREFIX + "/" + std::string(300, 'x');
+
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, longPrefix + "/a");
+        const std::string shardA = ProxyRegistry::getShardFileName(CONFIG_DIRECTORY, longPrefix + "/a");
+        const std::string shardB = ProxyRegistry::getShardFileName(CONFIG_DIRECTORY, longPrefix + "/b");
+        // shortened names fit NAME_MAX including the suffix of the temporary file, the hash tells them apart
+        ASSERT_LE(std::filesystem::path(shardA).filename().string().size() + 4, 255u);
+        ASSERT_NE(shardA, shardB);
+        {
+            TestProxy proxyB(registry, peer, longPrefix + "/b");
+            proxyA.setNumber(1);
+            proxyB.setNumber(2);
+            ASSERT_EQ(registry.saveToDirectory(CONFIG_DIRECTORY), 0);
+            ASSERT_TRUE(std::filesystem::exists(shardA));
+            ASSERT_TRUE(std::filesystem::exists(shardB));
+
+            // the jet path is taken from the shard
+            proxyA.setNumber(0);
+            proxyB.setNumber(0);
+            ASSERT_EQ(registry.restoreFromDirectory(CONFIG_DIRECTORY), 0);
+            ASSERT_EQ(proxyA.getNumber(), 1);
+            ASSERT_EQ(proxyB.getNumber(), 2);
+
+            proxyA.setNumber(5);
+            proxyB.setNumber(7);
+            ASSERT_EQ(registry.restoreFromDirectory(CONFIG_DIRECTORY, longPrefix + "/a"), 0);
+            ASSERT_EQ(proxyA.getNumber(), 1);
+            ASSERT_EQ(proxyB.getNumber(), 7);
+
+            // a shard under the name of another jet proxy is not taken
+            std::filesystem::copy_file(shardB, shardA, std::filesystem::copy_options::overwrite_existing);
+            ASSERT_EQ(registry.restoreFromDirectory(CONFIG_DIRECTORY), 0);
+            ASSERT_EQ(proxyA.getNumber(), 0);
+            ASSERT_EQ(proxyB.getNumber(), 2);
+        }
+
+        // the shard of a jet proxy that is gone is removed
+        ASSERT_EQ(registry.saveToDirectory(CONFIG_DIRECTORY), 0);
+        ASSERT_TRUE(std::filesystem::exists(shardA));
+        ASSERT_FALSE(std::filesystem::exists(shardB));
+        std::filesystem::remove_all(CONFIG_DIRECTORY);
+    }
+
+    TEST_F(ProxyRegistryTest, restore_announcements)
+    {
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        TestProxy limit(registry, peer, PATH_PREFIX + "/limit");
+        LimitedProxy limited(registry, peer, PATH_PREFIX + "/limited", limit);
+        proxyA.setNumber(1);
+        limit.setNumber(10);
+        limited.setNumber(5);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        // the entry of limited is rejected when restoring
+        limit.setPersistent(false);
+        limit.setNumber(1);
+
+        std::vector < std::string > duringRestore;
+        std::vector < std::string > afterRestore;
+        const ChangeBus::SubscriptionId id = ChangeBus::getDefault().subscribe(PATH_PREFIX, [&](const std::string& path) {
+            if (registry.isRestoring(path)) {
+                duringRestore.push_back(path);
+            } else {
+                afterRestore.push_back(path);
+            }
+        });
+
+        proxyA.setNumber(7);
+        const std::vector < std::string > beforeRestore = afterRestore;
+        afterRestore.clear();
+        registry.restoreFromFile(CONFIG_FILE);
+        const std::vector < std::string > duringFileRestore = duringRestore;
+        const std::vector < std::string > afterFileRestore = afterRestore;
+
+        proxyA.setNumber(7);
+        duringRestore.clear();
+        afterRestore.clear();
+        registry.restoreFromFileSliced(CONFIG_FILE, "");
+        const std::vector < std::string > duringSlicedRestore = duringRestore;
+        const std::vector < std::string > afterSlicedRestore = afterRestore;
+
+        // a change of a jet proxy outside the subtree of the restore is no change caused by the restore
+        duringRestore.clear();
+        afterRestore.clear();
+        registry.restoreFromFileSliced(CONFIG_FILE, PATH_PREFIX + "/a", [&limit](std::size_t, std::size_t) {
+            limit.setNumber(2);
+        });
+        ChangeBus::getDefault().unsubscribe(id);
+
+        ASSERT_EQ(beforeRestore, std::vector < std::string >({ PATH_PREFIX + "/a" }));
+        ASSERT_EQ(proxyA.getNumber(), 1);
+        ASSERT_EQ(limited.getNumber(), 0);
+        ASSERT_FALSE(registry.isRestoring(PATH_PREFIX + "/a"));
+        // restoring the defaults of limited does not notify.
+        // Only the jet proxy that differs from its entry is announced once the restore is done.
+        ASSERT_EQ(duringFileRestore, std::vector < std::string >({ PATH_PREFIX + "/a" }));
+        ASSERT_EQ(afterFileRestore, std::vector < std::string >({ PATH_PREFIX + "/limited" }));
+        ASSERT_EQ(duringSlicedRestore, std::vector < std::string >({ PATH_PREFIX + "/a" }));
+        ASSERT_EQ(afterSlicedRestore, std::vector < std::string >({ PATH_PREFIX + "/limited" }));
+        ASSERT_EQ(duringRestore, std::vector < std::string >({ PATH_PREFIX + "/a" }));
+        ASSERT_EQ(afterRestore, std::vector < std::string >({ PATH_PREFIX + "/limit" }));
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, sliced_restore)
+    {
+        ProxyRegistry registry;
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        TestProxy proxyB(registry, peer, PATH_PREFIX + "/b");
+        TestProxy proxyC(registry, peer, PATH_PREFIX + "/c");
+        proxyA.setNumber(1);
+        proxyB.setNumber(2);
+        proxyC.setNumber(3);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        registry.restoreDefaults();
+
+        // without CommandQueue everything is done before returning
+        std::vector < std::size_t > progress;
+        int result = 1;
+        registry.setRestoreSlice(2, std::chrono::hours(1));
+        ASSERT_EQ(registry.restoreFromFileSliced(CONFIG_FILE, "", [&progress](std::size_t restored, std::size_t total) {
+            ASSERT_EQ(total, 3u);
+            progress.push_back(restored);
+        }, [&result](int completed) {
+            result = completed;
+        }), 0);
+        ASSERT_EQ(progress, std::vector < std::size_t >({ 2, 3 }));
+        ASSERT_EQ(result, 0);
+        ASSERT_EQ(proxyC.getNumber(), 3);
+
+        registry.restoreDefaults();
+        {
+            CommandQueue commandQueue(eventloop, peer);
+            std::thread eventLoopThread(std::bind(&hbk::sys::EventLoop::execute, std::ref(eventloop)));
+
+            // a command posted by the first slice is executed before the last one
+            registry.setRestoreSlice(1, std::chrono::hours(1));
+            progress.clear();
+            std::atomic < std::size_t > restoredBeforeCommand(0);
+            std::promise < int > completion;
+            ASSERT_EQ(registry.restoreFromFileSliced(CONFIG_FILE, "", [&](std::size_t restored, std::size_t) {
+                progress.push_back(restored);
+                if (restored == 1) {
+                    commandQueue.post([&restoredBeforeCommand, &progress]() {
+                        restoredBeforeCommand = progress.back();
+                    });
+                }
+            }, [&completion](int completed) {
+                completion.set_value(completed);
+            }), 0);
+            auto done = completion.get_future();
+            ASSERT_EQ(done.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+            ASSERT_EQ(done.get(), 0);
+            ASSERT_EQ(progress, std::vector < std::size_t >({ 1, 2, 3 }));
+            for (unsigned int wait = 0; restoredBeforeCommand == 0; ++wait) {
+                ASSERT_LT(wait, 1000u);
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            ASSERT_LT(restoredBeforeCommand, 3u);
+            ASSERT_EQ(proxyA.getNumber(), 1);
+            ASSERT_EQ(proxyB.getNumber(), 2);
+            ASSERT_EQ(proxyC.getNumber(), 3);
+
+            eventloop.stop();
+            eventLoopThread.join();
+        }
+
+        result = 1;
+        ASSERT_EQ(registry.restoreFromFileSliced("nonexistent.json", "", ProxyRegistry::RestoreProgress(), [&result](int completed) {
+            result = completed;
+        }), -1);
+        ASSERT_EQ(result, -1);
+        ASSERT_EQ(proxyA.getNumber(), 0);
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, dependency_order)
+    {
+        ProxyRegistry registry;
+        // restored after the limit although it comes first in the file
+        TestProxy limit(registry, peer, PATH_PREFIX + "/z");
+        LimitedProxy limited(registry, peer, PATH_PREFIX + "/a", limit);
+        limit.setNumber(10);
+        limited.setNumber(5);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(limit.getNumber(), 10);
+        ASSERT_EQ(limited.getNumber(), 5);
+
+        // references are dependencies as well, cycles do not prevent restoring
+        TestProxy cycleA(registry, peer, PATH_PREFIX + "/cycle/a");
+        TestProxy cycleB(registry, peer, PATH_PREFIX + "/cycle/b");
+        cycleA.addReferenceByTarget("ref", cycleB.getPath());
+        cycleB.addReferenceByTarget("ref", cycleA.getPath());
+        ASSERT_EQ(cycleA.getRestoreDependencies(), std::vector < std::string >({ cycleB.getPath() }));
+        cycleA.setNumber(1);
+        cycleB.setNumber(2);
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(limited.getNumber(), 5);
+        ASSERT_EQ(cycleA.getNumber(), 1);
+        ASSERT_EQ(cycleB.getNumber(), 2);
+        std::remove(CONFIG_FILE.c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, parallel_restore)
+    {
+        static const unsigned int PROXY_COUNT = 1000;
+        ProxyRegistry registry;
+        std::vector < std::unique_ptr < TestProxy > > proxies;
+        for (unsigned int index = 0; index < PROXY_COUNT; ++index) {
+            proxies.emplace_back(std::make_unique < TestProxy >(registry, peer, PATH_PREFIX + "/" + std::to_string(index)));
+            proxies.back()->setNumber(index + 1);
+        }
+        ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        // the journal wins over the file
+        proxies.front()->setNumber(PROXY_COUNT + 1);
+        ASSERT_EQ(registry.appendToJournal(CONFIG_FILE, { proxies.front()->getPath() }), 0);
+
+        registry.restoreDefaults();
+        registry.setRestoreThreads(4);
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxies.front()->getNumber(), PROXY_COUNT + 1);
+        for (unsigned int index = 1; index < PROXY_COUNT; ++index) {
+            ASSERT_EQ(proxies[index]->getNumber(), index + 1);
+        }
+        std::remove(CONFIG_FILE.c_str());
+        std::remove(ProxyRegistry::getJournalFileName(CONFIG_FILE).c_str());
+    }
+
+    TEST_F(ProxyRegistryTest, generations)
+    {
+        auto removeAll = []() {
+            for (unsigned int generation = 0; generation < 3; ++generation) {
+                std::remove(ProxyRegistry::getGenerationFileName(CONFIG_FILE, generation).c_str());
+            }
+        };
+        removeAll();
+        ProxyRegistry registry;
+        registry.setGenerations(2);
+        TestProxy proxyA(registry, peer, PATH_PREFIX + "/a");
+        for (unsigned int number = 1; number <= 3; ++number) {
+            proxyA.setNumber(number);
+            ASSERT_EQ(registry.saveToFile(CONFIG_FILE), 0);
+        }
+        ASSERT_EQ(ProxyRegistry::getGenerationFileName(CONFIG_FILE, 1), CONFIG_FILE + ".1");
+        // only two are kept
+        ASSERT_FALSE(std::ifstream(ProxyRegistry::getGenerationFileName(CONFIG_FILE, 2)));
+
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 3);
+
+        // the header is a comment for json readers
+        {
+            std::ifstream file(CONFIG_FILE);
+            Json::Value config;
+            file >> config;
+            ASSERT_EQ(config[PATH_PREFIX + "/a"][PROPERTY_NUMBER].asUInt(), 3);
+        }
+
+        // a damaged write falls back to the previous generation
+        {
+            std::fstream file(CONFIG_FILE, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(-3, std::ios::end);
+            file.put('9');
+        }
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 2);
+
+        // the sequence continues after a restart, the latest is found by sequence
+        {
+            ProxyRegistry restarted;
+            restarted.setGenerations(2);
+            TestProxy restartedA(restarted, peer, PATH_PREFIX + "/a");
+            restartedA.setNumber(4);
+            ASSERT_EQ(restarted.saveToFile(CONFIG_FILE), 0);
+            std::filesystem::rename(CONFIG_FILE, CONFIG_FILE + ".tmp");
+            std::filesystem::rename(CONFIG_FILE + ".1", CONFIG_FILE);
+            std::filesystem::rename(CONFIG_FILE + ".tmp", CONFIG_FILE + ".1");
+            ASSERT_EQ(restarted.restoreFromFile(CONFIG_FILE), 0);
+            ASSERT_EQ(restartedA.getNumber(), 4);
+        }
+
+        // truncated
+        std::filesystem::resize_file(CONFIG_FILE + ".1", 40);
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), -1);
+        ASSERT_EQ(proxyA.getNumber(), 0);
+        removeAll();
+
+        // first rotation of a file written before generations were kept, interrupted before the new file was renamed in
+        {
+            ProxyRegistry legacy;
+            TestProxy legacyA(legacy, peer, PATH_PREFIX + "/a");
+            legacyA.setNumber(5);
+            ASSERT_EQ(legacy.saveToFile(CONFIG_FILE), 0);
+        }
+        std::filesystem::rename(CONFIG_FILE, CONFIG_FILE + ".1");
+        registry.restoreDefaults();
+        ASSERT_EQ(registry.restoreFromFile(CONFIG_FILE), 0);
+        ASSERT_EQ(proxyA.getNumber(), 5);
+        removeAll();
+    }
+}
@@ -0,0 +1,212 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "json/value.h"
+
+#include "jet/defines.h"
+#include "jet/peerasync.hpp"
+
+#include "jetproxy/CommandQueue.hpp"
+#include "jetproxy/JetProxy.hpp"
+#include "jetproxy/ProxyJetStates.hpp"
+#include "jetproxy/ProxyShards.hpp"
+
+namespace hbk::jetproxy {
+
+    static const char TYPE[] = "TestProxy";
+    static const char PROPERTY_NUMBER[] = "number";
+    static const std::string PATH_PREFIX = "/ProxyShardsTest/";
+    static const std::string CONFIG_FILE = "ProxyShardsTest.json";
+    static const std::size_t SHARD_COUNT = 4;
+    static const unsigned int PROXY_COUNT = 32;
+
+    class TestProxy : public JetProxy
+    {
+    public:
+        TestProxy(hbk::jet::PeerAsync& peer, const std::string& path)
+            : JetProxy(peer, TYPE, path, true)
+            , m_number(0)
+            , m_inEventLoop(true)
+        {
+            m_state = std::make_unique<hbk::jetproxy::ProxyJetStates>(m_jetPeer, m_path, TestProxy::compose(), std::bind(&TestProxy::setFromJet, this, std::placeholders::_1));
+        }
+
+        void restoreDefaults() override
+        {
+            checkEventLoop();
+            setNumber(0);
+        }
+
+        void composeProperties(Json::Value &composition) const override
+        {
+            composition[PROPERTY_NUMBER] = m_number;
+        }
+
+        hbk::jet::SetStateCbResult setFromJet(const Json::Value& request) override
+        {
+            checkEventLoop();
+            m_number = request[PROPERTY_NUMBER].asUInt();
+            return Json::Value();
+        }
+
+        void setNumber(unsigned int number)
+        {
+            m_number = number;
+            notify();
+        }
+
+        unsigned int getNumber() const
+        {
+            return m_number;
+        }
+
+        /// \return false if the jet proxy was accessed by a thread other than the event loop thread of its shard
+        bool inEventLoop() const
+        {
+            return m_inEventLoop;
+        }
+
+    private:
+        void checkEventLoop()
+        {
+            if (!CommandQueue::get(m_jetPeer)->isEventLoopThread()) {
+                m_inEventLoop = false;
+            }
+        }
+
+        unsigned int m_number;
+        bool m_inEventLoop;
+    };
+
+    class ProxyShardsTest : public ::testing::Test {
+    protected:
+        ProxyShards shards;
+
+        ProxyShardsTest()
+            : shards(SHARD_COUNT, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0)
+        {
+        }
+
+        virtual void TearDown() override
+        {
+            std::remove(CONFIG_FILE.c_str());
+        }
+    };
+
+    TEST_F(ProxyShardsTest, no_shard)
+    {
+        ASSERT_THROW(ProxyShards noShards(0, hbk::jet::JET_UNIX_DOMAIN_SOCKET_NAME, 0), std::runtime_error);
+    }
+
+    TEST_F(ProxyShardsTest, assignment)
+    {
+        ASSERT_EQ(shards.getCount(), SHARD_COUNT);
+        ASSERT_THROW(shards.getPeer(SHARD_COUNT), std::out_of_range);
+
+        std::vector < unsigned int > proxiesPerShard(SHARD_COUNT, 0);
+        for (unsigned int i = 0; i < PROXY_COUNT; ++i) {
+            const std::string path = PATH_PREFIX + std::to_string(i);
+            const std::size_t index = shards.getIndex(path);
+            ASSERT_LT(index, SHARD_COUNT);
+            // always the same shard for the same path
+            ASSERT_EQ(index, shards.getIndex(path));
+            ASSERT_EQ(&shards.getPeer(path), &shards.getPeer(index));
+            ++proxiesPerShard[index];
+        }
+        for (auto count : proxiesPerShard) {
+            ASSERT_GT(count, 0);
+        }
+    }
+
+    TEST_F(ProxyShardsTest, save_restore)
+    {
+        std::vector < std::unique_ptr < TestProxy > > proxies;
+        for (unsigned int i = 0; i < PROXY_COUNT; ++i) {
+            proxies.emplace_back(shards.createObject < TestProxy >(PATH_PREFIX + std::to_string(i)));
+        }
+        for (unsigned int i = 0; i < PROXY_COUNT; ++i) {
+            TestProxy* proxy = proxies[i].get();
+            proxy->post([proxy, i]() { proxy->setNumber(i + 1); });
+        }
+
+        // posted commands are executed before the jet proxies get composed
+        ASSERT_EQ(JetProxy::saveAllToFile(CONFIG_FILE), 0);
+        JetProxy::restoreAllDefaults();
+        for (const auto& proxy : proxies) {
+            ASSERT_EQ(proxy->getNumber(), 0);
+        }
+
+        ASSERT_EQ(JetProxy::restoreAllFromFile(CONFIG_FILE), 0);
+        for (unsigned int i = 0; i < PROXY_COUNT; ++i) {
+            ASSERT_EQ(proxies[i]->getNumber(), i + 1);
+            ASSERT_TRUE(proxies[i]->inEventLoop());
+        }
+        // the jet proxies are destroyed by this thread
+        shards.stop();
+    }
+
+    /// Each event loop waits for the others to compose their jet proxies
+    TEST_F(ProxyShardsTest, concurrent_save)
+    {
+        std::vector < std::unique_ptr < TestProxy > > proxies;
+        for (unsigned int i = 0; i < PROXY_COUNT; ++i) {
+            proxies.emplace_back(shards.createObject < TestProxy >(PATH_PREFIX + std::to_string(i)));
+        }
+
+        std::atomic < std::size_t > started(0);
+        std::vector < std::future < int > > results;
+        for (std::size_t index = 0; index < SHARD_COUNT; ++index) {
+            auto promise = std::make_shared < std::promise < int > >();
+            results.emplace_back(promise->get_future());
+            const std::string fileName = CONFIG_FILE + "." + std::to_string(index);
+            shards.getCommandQueue(index).post([promise, fileName, &started]() {
+                // all save at the same time
+                ++started;
+                while (started < SHARD_COUNT) {
+                    std::this_thread::yield();
+                }
+                promise->set_value(JetProxy::saveAllToFile(fileName));
+            });
+        }
+        for (auto& result : results) {
+            ASSERT_EQ(result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+            ASSERT_EQ(result.get(), 0);
+        }
+        for (std::size_t index = 0; index < SHARD_COUNT; ++index) {
+            std::remove((CONFIG_FILE + "." + std::to_string(index)).c_str());
+        }
+        shards.stop();
+    }
+}
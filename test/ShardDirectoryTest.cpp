@@ -0,0 +1,146 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "json/value.h"
+
+#include "jetproxy/ShardDirectory.hpp"
+#include "jetproxy/SnapshotFiles.hpp"
+
+namespace hbk::jetproxy
+{
+    static const std::string DIRECTORY = "ShardDirectoryTest";
+
+    static void writeShard(const std::string& fileName, const std::string& path, int number)
+    {
+        std::ofstream file(fileName);
+        file << "{ \"" << path << "\" : { \"number\" : " << number << " } }";
+    }
+
+    TEST(ShardDirectoryTest, file_name)
+    {
+        ASSERT_EQ(ShardDirectory::getFileName("dir", "/fb/scaler 1"), "dir/%2Ffb%2Fscaler%201.config");
+        ASSERT_EQ(ShardDirectory::getFileName("dir", "/a-b_c.d~e"), "dir/%2Fa-b_c.d%7Ee.config");
+
+        std::string path;
+        bool shortened = true;
+        ASSERT_TRUE(ShardDirectory::decodeName("%2Ffb%2Fscaler%201.config", path, shortened));
+        ASSERT_EQ(path, "/fb/scaler 1");
+        ASSERT_FALSE(shortened);
+        ASSERT_TRUE(ShardDirectory::decodeName("%2Fa-b_c.d%7Ee.config", path, shortened));
+        ASSERT_EQ(path, "/a-b_c.d~e");
+
+        // no shards
+        ASSERT_FALSE(ShardDirectory::decodeName(".config", path, shortened));
+        ASSERT_FALSE(ShardDirectory::decodeName("%2Fa.json", path, shortened));
+        ASSERT_FALSE(ShardDirectory::decodeName("%2Fa.config.tmp", path, shortened));
+        ASSERT_FALSE(ShardDirectory::decodeName("%2.config", path, shortened));
+        ASSERT_FALSE(ShardDirectory::decodeName("%zz.config", path, shortened));
+    }
+
+    TEST(ShardDirectoryTest, long_file_name)
+    {
+        const std::string prefix = "/" + std::string(300, 'x');
+        const std::string nameA = std::filesystem::path(ShardDirectory::getFileName("dir", prefix + "/a")).filename().string();
+        const std::string nameB = std::filesystem::path(ShardDirectory::getFileName("dir", prefix + "/b")).filename().string();
+        // fits NAME_MAX including the suffix of the temporary file, the hash tells them apart
+        ASSERT_LE(nameA.size() + sizeof(SnapshotFiles::TMP_SUFFIX) - 1, 255u);
+        ASSERT_EQ(nameA.size(), nameB.size());
+        ASSERT_NE(nameA, nameB);
+
+        std::string path;
+        bool shortened = false;
+        ASSERT_TRUE(ShardDirectory::decodeName(nameA, path, shortened));
+        ASSERT_TRUE(shortened);
+        ASSERT_EQ(prefix.compare(0, path.size(), path), 0);
+
+        // an encoded character is not cut
+        const std::string encoded = std::filesystem::path(ShardDirectory::getFileName("dir", std::string(300, ' '))).filename().string();
+        ASSERT_TRUE(ShardDirectory::decodeName(encoded, path, shortened));
+        ASSERT_TRUE(shortened);
+        ASSERT_EQ(path, std::string(path.size(), ' '));
+    }
+
+    TEST(ShardDirectoryTest, list)
+    {
+        std::filesystem::remove_all(DIRECTORY);
+        std::error_code ec;
+        ASSERT_TRUE(ShardDirectory::list(DIRECTORY, ec).empty());
+        ASSERT_TRUE(ec);
+
+        std::filesystem::create_directories(DIRECTORY);
+        writeShard(ShardDirectory::getFileName(DIRECTORY, "/a"), "/a", 1);
+        writeShard(ShardDirectory::getFileName(DIRECTORY, "/b") + SnapshotFiles::TMP_SUFFIX, "/b", 2);
+        std::ofstream(DIRECTORY + "/other.json") << "{}";
+
+        std::vector < ShardDirectory::Entry > entries = ShardDirectory::list(DIRECTORY, ec);
+        ASSERT_FALSE(ec);
+        ASSERT_EQ(entries.size(), 2u);
+        std::sort(entries.begin(), entries.end(), [](const ShardDirectory::Entry& left, const ShardDirectory::Entry& right) {
+            return left.path < right.path;
+        });
+        ASSERT_EQ(entries[0].path, "/a");
+        ASSERT_EQ(entries[0].fileName, ShardDirectory::getFileName(DIRECTORY, "/a"));
+        ASSERT_FALSE(entries[0].tmp);
+        ASSERT_EQ(entries[1].path, "/b");
+        ASSERT_EQ(entries[1].fileName, ShardDirectory::getFileName(DIRECTORY, "/b") + SnapshotFiles::TMP_SUFFIX);
+        ASSERT_TRUE(entries[1].tmp);
+        std::filesystem::remove_all(DIRECTORY);
+    }
+
+    TEST(ShardDirectoryTest, read)
+    {
+        std::filesystem::remove_all(DIRECTORY);
+        std::filesystem::create_directories(DIRECTORY);
+        const std::string fileName = ShardDirectory::getFileName(DIRECTORY, "/a");
+        writeShard(fileName, "/a", 1);
+        std::string path = "/a";
+        ASSERT_EQ(ShardDirectory::read(DIRECTORY, fileName, path)["number"].asInt(), 1);
+        path = "/b";
+        ASSERT_THROW(ShardDirectory::read(DIRECTORY, fileName, path), std::runtime_error);
+
+        // the jet path of a shortened name is taken from the shard
+        const std::string longPath = "/" + std::string(300, 'x');
+        const std::string longFileName = ShardDirectory::getFileName(DIRECTORY, longPath);
+        writeShard(longFileName, longPath, 2);
+        path.clear();
+        ASSERT_EQ(ShardDirectory::read(DIRECTORY, longFileName, path)["number"].asInt(), 2);
+        ASSERT_EQ(path, longPath);
+
+        // the entry has to match the name
+        writeShard(longFileName, longPath + "/other", 3);
+        path.clear();
+        ASSERT_THROW(ShardDirectory::read(DIRECTORY, longFileName, path), std::runtime_error);
+        std::filesystem::remove_all(DIRECTORY);
+    }
+}
@@ -0,0 +1,194 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "json/value.h"
+
+#include "jetproxy/CborSerializer.hpp"
+#include "jetproxy/SnapshotFiles.hpp"
+#include "jetproxy/SnapshotHeader.hpp"
+
+namespace hbk::jetproxy
+{
+    static const std::string FILE_NAME = "SnapshotFilesTest.json";
+    static const unsigned int GENERATIONS = 3;
+
+    /// Writes content with a header as the generation
+    static void writeGeneration(unsigned int generation, std::uint64_t sequence, const std::string& content)
+    {
+        std::ofstream file(SnapshotFiles::getGenerationFileName(FILE_NAME, generation), std::ios::binary | std::ios::trunc);
+        file << SnapshotHeader::create(sequence, content) << content;
+    }
+
+    static std::string readContent(const std::string& fileName)
+    {
+        std::ifstream file(fileName, std::ios::binary);
+        std::ostringstream content;
+        content << file.rdbuf();
+        return content.str();
+    }
+
+    static void removeGenerations()
+    {
+        for (unsigned int generation = 0; generation < GENERATIONS; ++generation) {
+            std::remove(SnapshotFiles::getGenerationFileName(FILE_NAME, generation).c_str());
+        }
+        std::remove((FILE_NAME + SnapshotFiles::TMP_SUFFIX).c_str());
+    }
+
+    TEST(SnapshotFilesTest, file_names)
+    {
+        ASSERT_EQ(SnapshotFiles::getGenerationFileName("config.json", 0), "config.json");
+        ASSERT_EQ(SnapshotFiles::getGenerationFileName("config.json", 2), "config.json.2");
+        ASSERT_EQ(SnapshotFiles::getDirectory("config.json"), ".");
+        ASSERT_EQ(SnapshotFiles::getDirectory("dir/config.json"), "dir");
+    }
+
+    TEST(SnapshotFilesTest, write_verify)
+    {
+        removeGenerations();
+        const std::string content = "{ \"a\" : 1 }";
+        std::uint64_t length;
+        std::uint32_t checksum;
+        {
+            std::ofstream file(FILE_NAME, std::ios::binary);
+            file << SnapshotHeader::create(0, 0, 0);
+            SnapshotFiles::write(file, [&content](std::ostream& stream) {
+                stream << content;
+            }, length, checksum);
+            ASSERT_TRUE(file);
+            ASSERT_EQ(length, content.size());
+            ASSERT_EQ(checksum, SnapshotHeader::crc32c(content));
+            file.seekp(0);
+            file << SnapshotHeader::create(7, length, checksum);
+        }
+
+        SnapshotHeader header;
+        const std::size_t headerSize = SnapshotFiles::readHeader(FILE_NAME, header);
+        ASSERT_EQ(headerSize, SnapshotHeader::SIZE);
+        ASSERT_EQ(header.sequence, 7u);
+        ASSERT_TRUE(SnapshotFiles::verify(FILE_NAME, header, headerSize));
+        ASSERT_EQ(SnapshotFiles::readLatestSequence(FILE_NAME, GENERATIONS), 7u);
+
+        // a single damaged byte is detected
+        {
+            std::fstream file(FILE_NAME, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(static_cast < std::streamoff >(headerSize + 2));
+            file << 'b';
+        }
+        ASSERT_FALSE(SnapshotFiles::verify(FILE_NAME, header, headerSize));
+        ASSERT_EQ(SnapshotFiles::readHeader("SnapshotFilesTestMissing.json", header), 0u);
+        removeGenerations();
+    }
+
+    TEST(SnapshotFilesTest, select_generation)
+    {
+        removeGenerations();
+        // one generation is taken as is
+        ASSERT_EQ(SnapshotFiles::selectGeneration(FILE_NAME, 1), FILE_NAME);
+
+        writeGeneration(2, 1, "{ \"a\" : 1 }");
+        writeGeneration(1, 2, "{ \"a\" : 2 }");
+        writeGeneration(0, 3, "{ \"a\" : 3 }");
+        ASSERT_EQ(SnapshotFiles::selectGeneration(FILE_NAME, GENERATIONS), FILE_NAME);
+
+        // the latest intact one
+        {
+            std::ofstream file(FILE_NAME, std::ios::binary | std::ios::app);
+            file << "garbage";
+        }
+        ASSERT_EQ(SnapshotFiles::selectGeneration(FILE_NAME, GENERATIONS), SnapshotFiles::getGenerationFileName(FILE_NAME, 1));
+
+        // an interrupted rotation leaves the latest one behind with the highest sequence
+        writeGeneration(2, 4, "{ \"a\" : 4 }");
+        ASSERT_EQ(SnapshotFiles::selectGeneration(FILE_NAME, GENERATIONS), SnapshotFiles::getGenerationFileName(FILE_NAME, 2));
+        ASSERT_EQ(SnapshotFiles::readLatestSequence(FILE_NAME, GENERATIONS), 4u);
+
+        // without headers, the file itself or the newest existing generation
+        removeGenerations();
+        {
+            std::ofstream file(SnapshotFiles::getGenerationFileName(FILE_NAME, 1));
+            file << "{}";
+        }
+        ASSERT_EQ(SnapshotFiles::selectGeneration(FILE_NAME, GENERATIONS), SnapshotFiles::getGenerationFileName(FILE_NAME, 1));
+        removeGenerations();
+    }
+
+    TEST(SnapshotFilesTest, replace)
+    {
+        removeGenerations();
+        for (const std::string content : { "1", "2", "3", "4" }) {
+            {
+                std::ofstream file(FILE_NAME + SnapshotFiles::TMP_SUFFIX);
+                file << content;
+            }
+            ASSERT_EQ(SnapshotFiles::syncFile(FILE_NAME + SnapshotFiles::TMP_SUFFIX, SnapshotFiles::Durability::FILE), 0);
+            ASSERT_EQ(SnapshotFiles::replace(FILE_NAME, GENERATIONS, SnapshotFiles::Durability::FILE), 0);
+        }
+        ASSERT_FALSE(std::filesystem::exists(FILE_NAME + SnapshotFiles::TMP_SUFFIX));
+        // the oldest got dropped
+        ASSERT_EQ(readContent(SnapshotFiles::getGenerationFileName(FILE_NAME, 0)), "4");
+        ASSERT_EQ(readContent(SnapshotFiles::getGenerationFileName(FILE_NAME, 1)), "3");
+        ASSERT_EQ(readContent(SnapshotFiles::getGenerationFileName(FILE_NAME, 2)), "2");
+        ASSERT_FALSE(std::filesystem::exists(SnapshotFiles::getGenerationFileName(FILE_NAME, 3)));
+
+        // nothing to rename
+        ASSERT_EQ(SnapshotFiles::replace(FILE_NAME, 1, SnapshotFiles::Durability::NONE), -1);
+        ASSERT_EQ(SnapshotFiles::syncFile("SnapshotFilesTestMissing.json", SnapshotFiles::Durability::FILE), -1);
+        ASSERT_EQ(SnapshotFiles::syncFile("SnapshotFilesTestMissing.json", SnapshotFiles::Durability::NONE), 0);
+        removeGenerations();
+    }
+
+    TEST(SnapshotFilesTest, read)
+    {
+        removeGenerations();
+        ASSERT_THROW(SnapshotFiles::read(FILE_NAME), std::runtime_error);
+
+        // the header is skipped
+        writeGeneration(0, 1, "{ \"a\" : 1 }");
+        ASSERT_EQ(SnapshotFiles::read(FILE_NAME)["a"].asInt(), 1);
+
+        Json::Value config;
+        config["a"] = 2;
+        std::string encoded;
+        CborSerializer::encode(config, encoded);
+        writeGeneration(0, 2, encoded);
+        ASSERT_EQ(SnapshotFiles::read(FILE_NAME)["a"].asInt(), 2);
+
+        for (const std::string content : { "", "[ 1 ]", "{ \"a\" : ", "null" }) {
+            std::ofstream(FILE_NAME, std::ios::trunc) << content;
+            ASSERT_THROW(SnapshotFiles::read(FILE_NAME), std::runtime_error);
+        }
+        removeGenerations();
+    }
+}
@@ -0,0 +1,79 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* vim: set ts=4 et sw=4 tw=80: */
+// This code is licenced under the MIT license:
+//
+// Copyright (c) 2024 Hottinger Brüel & Kjær
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "jetproxy/SnapshotHeader.hpp"
+
+namespace hbk::jetproxy
+{
+    TEST(SnapshotHeaderTest, crc32c)
+    {
+        // check value of the CRC catalogue
+        ASSERT_EQ(SnapshotHeader::crc32c("123456789"), 0xe3069283u);
+        ASSERT_EQ(SnapshotHeader::crc32c(""), 0u);
+
+        // in pieces of any size
+        const std::string data = "The quick brown fox jumps over the lazy dog, again and again and again";
+        const std::uint32_t whole = SnapshotHeader::crc32c(data);
+        for (std::size_t split = 0; split <= data.size(); ++split) {
+            ASSERT_EQ(SnapshotHeader::crc32c(data.substr(split), SnapshotHeader::crc32c(data.substr(0, split))), whole);
+        }
+    }
+
+    TEST(SnapshotHeaderTest, create_parse)
+    {
+        const std::string content = "{ \"a\" : 1 }";
+        const std::string header = SnapshotHeader::create(42, content);
+        ASSERT_EQ(header.back(), '\n');
+
+        SnapshotHeader parsed;
+        ASSERT_EQ(SnapshotHeader::parse(header + content, parsed), header.size());
+        ASSERT_EQ(parsed.sequence, 42u);
+        ASSERT_EQ(parsed.length, content.size());
+        ASSERT_EQ(parsed.checksum, SnapshotHeader::crc32c(content));
+
+        // always the same size, a placeholder can be replaced
+        ASSERT_EQ(header.size(), SnapshotHeader::SIZE);
+        ASSERT_EQ(SnapshotHeader::create(0, 0, 0).size(), SnapshotHeader::SIZE);
+        ASSERT_EQ(SnapshotHeader::create(UINT64_MAX, UINT64_MAX, UINT32_MAX).size(), SnapshotHeader::SIZE);
+        ASSERT_EQ(SnapshotHeader::parse(SnapshotHeader::create(UINT64_MAX, 1, 2), parsed), SnapshotHeader::SIZE);
+        ASSERT_EQ(parsed.sequence, UINT64_MAX);
+    }
+
+    TEST(SnapshotHeaderTest, no_header)
+    {
+        SnapshotHeader parsed;
+        ASSERT_EQ(SnapshotHeader::parse("{ \"a\" : 1 }", parsed), 0u);
+        ASSERT_EQ(SnapshotHeader::parse("// a comment\n{}", parsed), 0u);
+        ASSERT_EQ(SnapshotHeader::parse("// snapshot sequence=1 length=2\n{}", parsed), 0u);
+        ASSERT_EQ(SnapshotHeader::parse("// snapshot sequence=1 length=2 crc32c=0000000a trailing\n{}", parsed), 0u);
+        // truncated
+        ASSERT_EQ(SnapshotHeader::parse("// snapshot sequence=1 length=2 crc32c=0000000a", parsed), 0u);
+        ASSERT_EQ(parsed.sequence, 0u);
+    }
+}